@@ -0,0 +1,225 @@
+#include <benchmark/benchmark.h>
+
+#include "collision_detector.h"
+#include "state_writer.h"
+#include "synthetic_game.h"
+
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+using namespace std::literals;
+
+namespace {
+
+using bench::SyntheticGameParams;
+
+/* Собаки и предметы сессии в виде, в котором их видит детектор коллизий */
+class SessionGatherProvider : public collision_detector::ItemGathererProvider{
+public:
+    SessionGatherProvider(const model::GameSession& session, double delta){
+        for(const model::Loot& loot : session.GetLootObjects()){
+            items_.push_back({loot.pos, 0});
+        }
+        for(const model::Dog& dog : session.GetDogs()){
+            const auto [x, y] = *dog.GetPosition();
+            const auto [vx, vy] = *dog.GetSpeed();
+            gatherers_.push_back({{x, y}, {x + vx * delta, y + vy * delta}, 0.6});
+        }
+    }
+
+    size_t ItemsCount() const override{
+        return items_.size();
+    }
+
+    collision_detector::Item GetItem(size_t idx) const override{
+        return items_[idx];
+    }
+
+    size_t GatherersCount() const override{
+        return gatherers_.size();
+    }
+
+    collision_detector::Gatherer GetGatherer(size_t idx) const override{
+        return gatherers_[idx];
+    }
+
+private:
+    std::vector<collision_detector::Item> items_;
+    std::vector<collision_detector::Gatherer> gatherers_;
+};
+
+SyntheticGameParams MakeParams(unsigned dogs, unsigned loot){
+    SyntheticGameParams params;
+    params.dogs_per_session = dogs;
+    params.loot_per_session = loot;
+    /* Плотность собак на дорогах не зависит от их числа */
+    params.grid_size = std::max(4u, static_cast<unsigned>(std::sqrt(dogs)));
+    return params;
+}
+
+/* Аргументы: число собак и число предметов в сессии */
+void BM_FindGatherEvents(benchmark::State& state){
+    const SyntheticGameParams params = MakeParams(state.range(0), state.range(1));
+    model::Game game = bench::MakeSyntheticGame(params);
+    bench::PopulateSessions(game, params);
+    const SessionGatherProvider provider(game.GetAllSessions().begin()->second.front(), 1.0);
+
+    for(auto _ : state){
+        benchmark::DoNotOptimize(collision_detector::FindGatherEvents(provider));
+    }
+    state.SetItemsProcessed(state.iterations() * provider.GatherersCount());
+}
+BENCHMARK(BM_FindGatherEvents)->Args({100, 100})->Args({1000, 1000})->Args({10000, 10000});
+
+/*
+    Перемещение по дорогам (в модели нет поиска дорог по координатам,
+    его роль играет индекс проходимой области). Аргумент - число дорог в каждом направлении
+*/
+void BM_WalkableIndexMove(benchmark::State& state){
+    SyntheticGameParams params;
+    params.grid_size = state.range(0);
+    const model::Map map = bench::MakeSyntheticMap(0, params);
+    model::Game game;
+    game.AddMap(model::Map(map));
+    const model::WalkableIndex& index = game.GetMaps().front().GetWalkableIndex();
+
+    std::mt19937 random(params.seed);
+    std::uniform_real_distribution<double> step_dist(-params.road_spacing, params.road_spacing);
+    std::vector<std::pair<model::PairDouble, model::PairDouble>> moves(4096);
+    for(auto& [from, to] : moves){
+        from = bench::GetRandomRoadPos(map, random);
+        to = random() % 2 == 0 ? model::PairDouble{from.x + step_dist(random), from.y}
+                               : model::PairDouble{from.x, from.y + step_dist(random)};
+    }
+
+    size_t i = 0;
+    for(auto _ : state){
+        const auto& [from, to] = moves[i++ % moves.size()];
+        benchmark::DoNotOptimize(index.Move(from, to));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WalkableIndexMove)->Arg(10)->Arg(100)->Arg(1000);
+
+/* Один тик игры. Аргументы: число сессий и число собак в каждой сессии */
+void BM_UpdateGameState(benchmark::State& state){
+    SyntheticGameParams params = MakeParams(state.range(1), state.range(1));
+    params.maps = state.range(0);
+    model::Game game = bench::MakeSyntheticGame(params);
+    bench::PopulateSessions(game, params);
+
+    std::vector<model::GameSession*> sessions;
+    std::vector<std::list<model::Loot>> initial_loot;
+    for(unsigned i = 0; i < params.maps; ++i){
+        model::GameSession* session = game.SessionIsExists(model::Map::Id{bench::GetSyntheticMapId(i)});
+        sessions.push_back(session);
+        initial_loot.emplace_back(session->GetLootObjects().begin(), session->GetLootObjects().end());
+    }
+
+    for(auto _ : state){
+        /* Каждый тик начинается с одного и того же состояния, иначе собаки упрутся в края дорог */
+        state.PauseTiming();
+        std::mt19937 random(params.seed);
+        for(size_t i = 0; i < sessions.size(); ++i){
+            bench::ScatterDogs(*sessions[i], params.dog_speed, random);
+            sessions[i]->SetLootObjects(initial_loot[i]);
+        }
+        state.ResumeTiming();
+
+        game.UpdateGameState(100);
+    }
+    state.SetItemsProcessed(state.iterations() * params.maps * params.dogs_per_session);
+}
+BENCHMARK(BM_UpdateGameState)
+    ->Args({1, 100})->Args({1, 1000})->Args({1, 10000})->Args({8, 1000})
+    ->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+/* Сериализация состояния сессии в JSON. Аргумент - число игроков */
+void BM_GetGameState(benchmark::State& state){
+    bench::SyntheticServer server(MakeParams(state.range(0), state.range(0)));
+    const model::Token& token = server.GetPlayerTokens().front();
+    model::GameSession* session = server.GetTokens().FindPlayerByToken(token)->GetSession();
+
+    size_t bytes = 0;
+    for(auto _ : state){
+        /* Без изменения сессии ответ брался бы из кэша */
+        session->MarkChanged();
+        bytes += server.GetUseCase().GetGameState(token)->size();
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_GetGameState)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+/* Поиск игрока по токену. Аргумент - число игроков */
+void BM_FindPlayerByToken(benchmark::State& state){
+    bench::SyntheticServer server(MakeParams(state.range(0), 0));
+    const std::vector<model::Token>& tokens = server.GetPlayerTokens();
+    const model::PlayerTokens& player_tokens = server.GetTokens();
+
+    size_t i = 0;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(player_tokens.FindPlayerByToken(tokens[i++ % tokens.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FindPlayerByToken)->Arg(100)->Arg(10000);
+
+std::filesystem::path GetSnapshotPath(){
+    return std::filesystem::temp_directory_path() / "game_server_bench_state"s;
+}
+
+/* Снимок состояния и его запись на диск. Аргумент - число игроков */
+void BM_SaveState(benchmark::State& state){
+    bench::SyntheticServer server(MakeParams(state.range(0), state.range(0)));
+    const std::filesystem::path path = GetSnapshotPath();
+
+    uintmax_t size = 0;
+    for(auto _ : state){
+        serialization::GameStateRepr repr(server.GetGame().GetAllSessions(), server.GetPlayers());
+        size = serialization::WriteStateFile(path, repr);
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    state.counters["file_bytes"] = static_cast<double>(size);
+}
+BENCHMARK(BM_SaveState)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+/* Чтение снимка с диска. Аргумент - число игроков */
+void BM_LoadState(benchmark::State& state){
+    bench::SyntheticServer server(MakeParams(state.range(0), state.range(0)));
+    const std::filesystem::path path = GetSnapshotPath();
+    const uintmax_t size = serialization::WriteStateFile(
+        path, serialization::GameStateRepr(server.GetGame().GetAllSessions(), server.GetPlayers()));
+
+    for(auto _ : state){
+        benchmark::DoNotOptimize(serialization::ReadStateFile(path));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_LoadState)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+/* Если файл результатов не задан, они записываются в game_server_bench.json */
+int main(int argc, char** argv){
+    std::vector<char*> args(argv, argv + argc);
+    bool has_out = false;
+    for(int i = 1; i < argc; ++i){
+        has_out = has_out || std::string_view(argv[i]).starts_with("--benchmark_out="sv);
+    }
+    std::string out_arg = "--benchmark_out=game_server_bench.json"s;
+    std::string format_arg = "--benchmark_out_format=json"s;
+    if(!has_out){
+        args.push_back(out_arg.data());
+        args.push_back(format_arg.data());
+    }
+    int args_count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&args_count, args.data());
+    if(benchmark::ReportUnrecognizedArguments(args_count, args.data())){
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include "app.h"
+#include <boost/json.hpp>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+using namespace std::literals;
+
+/*
+    Размеры синтетической игры. Генератор детерминирован:
+    одинаковые параметры всегда дают одинаковые карты, собак и предметы
+*/
+struct SyntheticGameParams{
+    /* Число карт. На каждой карте играет одна сессия */
+    unsigned maps = 1;
+    /* Карта - сетка из grid_size горизонтальных и grid_size вертикальных дорог */
+    unsigned grid_size = 10;
+    /* Расстояние между соседними параллельными дорогами */
+    int road_spacing = 10;
+    unsigned dogs_per_session = 100;
+    unsigned loot_per_session = 100;
+    double dog_speed = 3;
+    unsigned bag_capacity = 3;
+    uint32_t seed = 42;
+};
+
+inline std::string GetSyntheticMapId(unsigned index){
+    return "synthetic"s + std::to_string(index);
+}
+
+/* Сетка дорог с офисами на левом краю каждой второй горизонтальной дороги */
+inline model::Map MakeSyntheticMap(unsigned index, const SyntheticGameParams& params){
+    using namespace model;
+    Map map{Map::Id{GetSyntheticMapId(index)}, "Synthetic map "s + std::to_string(index)};
+    map.AddDogSpeed(params.dog_speed);
+    map.AddBagCapacity(params.bag_capacity);
+
+    const int length = static_cast<int>(params.grid_size - 1) * params.road_spacing;
+    for(unsigned i = 0; i < params.grid_size; ++i){
+        const int offset = static_cast<int>(i) * params.road_spacing;
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, offset}, length});
+        map.AddRoad(Road{Road::VERTICAL, Point{offset, 0}, length});
+    }
+    for(unsigned i = 0; i < params.grid_size; i += 2){
+        map.AddOffice(Office{Office::Id{"o"s + std::to_string(i)},
+                             Point{0, static_cast<int>(i) * params.road_spacing}, Offset{5, 0}});
+    }
+    for(unsigned value : {10u, 20u, 30u}){
+        LootType loot_type;
+        loot_type.name = "loot"s + std::to_string(value);
+        loot_type.file = "assets/loot.obj"s;
+        loot_type.type = "obj"s;
+        loot_type.scale = 0.05;
+        loot_type.value = value;
+        map.AddLootType(std::move(loot_type));
+    }
+    return map;
+}
+
+inline model::Game MakeSyntheticGame(const SyntheticGameParams& params){
+    model::Game game;
+    game.SetDefaultDogSpeed(params.dog_speed);
+    game.SetDefaultBagCapacity(params.bag_capacity);
+    game.SetDogRetirementTime(60);
+    game.SetLootGenerator(5000, 0.5);
+    for(unsigned i = 0; i < params.maps; ++i){
+        game.AddMap(MakeSyntheticMap(i, params));
+    }
+    return game;
+}
+
+/* Случайная точка на случайной дороге карты */
+inline model::PairDouble GetRandomRoadPos(const model::Map& map, std::mt19937& random){
+    const model::Map::Roads& roads = map.GetRoads();
+    const model::Road& road = roads[std::uniform_int_distribution<size_t>(0, roads.size() - 1)(random)];
+    const model::Point start = road.GetStart();
+    const model::Point end = road.GetEnd();
+    std::uniform_real_distribution<double> ratio_dist(0, 1);
+    const double ratio = ratio_dist(random);
+    return {start.x + (end.x - start.x) * ratio, start.y + (end.y - start.y) * ratio};
+}
+
+inline model::PairDouble GetRandomSpeed(double speed, std::mt19937& random){
+    switch(std::uniform_int_distribution<int>(0, 3)(random)){
+        case 0:
+            return {0, -speed};
+        case 1:
+            return {0, speed};
+        case 2:
+            return {-speed, 0};
+        default:
+            return {speed, 0};
+    }
+}
+
+inline std::list<model::Loot> MakeSyntheticLoot(const model::Map& map, unsigned count, std::mt19937& random){
+    std::uniform_int_distribution<unsigned> type_dist(0, map.GetLootTypes().size() - 1);
+    std::list<model::Loot> loot;
+    for(unsigned id = 1; id <= count; ++id){
+        const unsigned type = type_dist(random);
+        loot.push_back(model::Loot{id, type, *map.GetLootTypes()[type].value, GetRandomRoadPos(map, random)});
+    }
+    return loot;
+}
+
+/* Раскладывает собак сессии по дорогам, задаёт им случайное направление и опустошает рюкзаки */
+inline void ScatterDogs(model::GameSession& session, double speed, std::mt19937& random){
+    for(model::Dog& dog : session.GetDogs()){
+        dog.SetPosition(model::Dog::Position(GetRandomRoadPos(*session.GetMap(), random)));
+        dog.SetSpeed(model::Dog::Speed(GetRandomSpeed(speed, random)));
+        dog.ClearBag();
+    }
+    session.MarkChanged();
+}
+
+/* Синтетическая игра без игроков: сессии с собаками и предметами для бенчмарков модели */
+inline void PopulateSessions(model::Game& game, const SyntheticGameParams& params){
+    std::mt19937 random(params.seed);
+    for(unsigned i = 0; i < params.maps; ++i){
+        model::GameSession* session = game.AddSession(model::Map::Id{GetSyntheticMapId(i)});
+        for(unsigned dog = 0; dog < params.dogs_per_session; ++dog){
+            const int id = static_cast<int>(i * params.dogs_per_session + dog);
+            session->AddDog(id, model::Dog::Name("dog"s + std::to_string(id)), model::Dog::Position({0, 0}),
+                            model::Dog::Speed({0, 0}), model::Direction::NORTH);
+        }
+        ScatterDogs(*session, params.dog_speed, random);
+        session->SetLootObjects(MakeSyntheticLoot(*session->GetMap(), params.loot_per_session, random));
+    }
+}
+
+/*
+    Синтетический сервер: игроки заходят в игру через GameUseCase, как по HTTP,
+    но без базы данных. Токены игроков сохраняются в порядке входа
+*/
+class SyntheticServer{
+public:
+    explicit SyntheticServer(const SyntheticGameParams& params)
+        : game_(MakeSyntheticGame(params))
+        , use_case_(players_, tokens_, nullptr){
+        std::mt19937 random(params.seed);
+        for(unsigned i = 0; i < params.maps; ++i){
+            const std::string map_id = GetSyntheticMapId(i);
+            for(unsigned dog = 0; dog < params.dogs_per_session; ++dog){
+                const std::string join_result = use_case_.JoinGame("player"s + std::to_string(dog), map_id, game_, false);
+                const boost::json::object join_json = boost::json::parse(join_result).as_object();
+                player_tokens_.push_back(model::Token::Parse(join_json.at("authToken").as_string()));
+            }
+            model::GameSession* session = game_.SessionIsExists(model::Map::Id{map_id});
+            ScatterDogs(*session, params.dog_speed, random);
+            session->SetLootObjects(MakeSyntheticLoot(*session->GetMap(), params.loot_per_session, random));
+        }
+    }
+
+    model::Game& GetGame() noexcept{
+        return game_;
+    }
+
+    model::Players& GetPlayers() noexcept{
+        return players_;
+    }
+
+    model::PlayerTokens& GetTokens() noexcept{
+        return tokens_;
+    }
+
+    app::GameUseCase& GetUseCase() noexcept{
+        return use_case_;
+    }
+
+    const std::vector<model::Token>& GetPlayerTokens() const noexcept{
+        return player_tokens_;
+    }
+
+private:
+    model::Game game_;
+    model::Players players_;
+    model::PlayerTokens tokens_;
+    app::GameUseCase use_case_;
+    std::vector<model::Token> player_tokens_;
+};
+
+}  // namespace bench
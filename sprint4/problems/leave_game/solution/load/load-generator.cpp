@@ -0,0 +1,423 @@
+/*
+    Генератор нагрузки на игровой сервер.
+
+    Каждый бот входит в игру, а затем по двум отдельным соединениям с заданной частотой
+    отправляет команды движения и запрашивает состояние игры.
+    В замкнутом режиме (closed) следующий запрос уходит через паузу после получения ответа,
+    поэтому медленный сервер получает меньше запросов.
+    В открытом режиме (open) запросы планируются с постоянной частотой независимо от ответов,
+    а задержка отсчитывается от запланированного момента отправки: время ожидания
+    в очереди за медленными ответами тоже попадает в статистику.
+*/
+#include <utility>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/json.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace load {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace json = boost::json;
+namespace sys = boost::system;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+using Request = http::request<http::string_body>;
+using Response = http::response<http::string_body>;
+using namespace std::literals;
+
+enum class Mode{
+    CLOSED,
+    OPEN
+};
+
+struct Args{
+    std::string host = "127.0.0.1"s;
+    std::string port = "8080"s;
+    std::string map_id;
+    unsigned bots = 100;
+    unsigned threads = 1;
+    std::chrono::seconds duration{10};
+    /* Запросов в секунду на одного бота */
+    double action_rate = 10;
+    double state_rate = 10;
+    Mode mode = Mode::CLOSED;
+    std::chrono::milliseconds timeout{5000};
+};
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]){
+    namespace po = boost::program_options;
+
+    po::options_description desc{"Allowed options"s};
+
+    Args args;
+    unsigned duration;
+    unsigned timeout;
+    std::string mode;
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("host", po::value(&args.host)->value_name("host"s), "set server address (127.0.0.1 by default)")
+        ("port,p", po::value(&args.port)->value_name("port"s), "set server port (8080 by default)")
+        ("map", po::value(&args.map_id)->value_name("map-id"s), "set map to join (the first map of /api/v1/maps by default)")
+        ("bots,n", po::value(&args.bots)->value_name("count"s), "set number of bots (100 by default)")
+        ("threads", po::value(&args.threads)->value_name("threads"s), "set number of client threads (1 by default)")
+        ("duration,d", po::value(&duration)->value_name("seconds"s), "set test duration (10 by default)")
+        ("action-rate", po::value(&args.action_rate)->value_name("rps"s), "set move actions per second of one bot (10 by default)")
+        ("state-rate", po::value(&args.state_rate)->value_name("rps"s), "set state requests per second of one bot (10 by default)")
+        ("mode", po::value(&mode)->value_name("closed|open"s), "set load model (closed by default)")
+        ("timeout", po::value(&timeout)->value_name("milliseconds"s), "set request timeout (5000 by default)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if(vm.contains("help"s)){
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if(vm.contains("duration"s)){
+        args.duration = std::chrono::seconds(duration);
+    }
+    if(vm.contains("timeout"s)){
+        args.timeout = std::chrono::milliseconds(timeout);
+    }
+    if(vm.contains("mode"s)){
+        if(mode == "open"sv){
+            args.mode = Mode::OPEN;
+        } else if(mode != "closed"sv){
+            throw std::runtime_error("Unknown mode "s + mode + ", expected closed or open"s);
+        }
+    }
+    if(args.bots == 0 || args.threads == 0 || args.action_rate <= 0 || args.state_rate <= 0){
+        throw std::runtime_error("Bots, threads and request rates must be positive"s);
+    }
+    return args;
+}
+
+/* ------------------------ Statistics ----------------------------------- */
+
+enum class Endpoint{
+    JOIN,
+    ACTION,
+    STATE
+};
+
+constexpr std::array<std::string_view, 3> ENDPOINT_NAMES{"join"sv, "action"sv, "state"sv};
+
+/* Задержки запросов к одной точке входа */
+class LatencyStats{
+public:
+    void AddSuccess(Clock::duration latency){
+        latencies_.push_back(latency);
+    }
+
+    void AddError(){
+        ++errors_;
+    }
+
+    void Merge(const LatencyStats& other){
+        latencies_.insert(latencies_.end(), other.latencies_.begin(), other.latencies_.end());
+        errors_ += other.errors_;
+    }
+
+    size_t GetCount() const noexcept{
+        return latencies_.size();
+    }
+
+    size_t GetErrors() const noexcept{
+        return errors_;
+    }
+
+    /* Перцентиль q из [0, 1]. Упорядочивает задержки при первом вызове после добавления */
+    Clock::duration GetPercentile(double q){
+        if(latencies_.empty()){
+            return {};
+        }
+        if(!is_sorted_){
+            std::sort(latencies_.begin(), latencies_.end());
+            is_sorted_ = true;
+        }
+        const size_t index = std::min(latencies_.size() - 1, static_cast<size_t>(q * latencies_.size()));
+        return latencies_[index];
+    }
+
+private:
+    std::vector<Clock::duration> latencies_;
+    size_t errors_ = 0;
+    bool is_sorted_ = false;
+};
+
+/* Статистика одного потока клиента. Потоки не делят статистику, она сливается в конце */
+using Stats = std::array<LatencyStats, ENDPOINT_NAMES.size()>;
+
+LatencyStats& GetStats(Stats& stats, Endpoint endpoint){
+    return stats[static_cast<size_t>(endpoint)];
+}
+
+double ToMilliseconds(Clock::duration duration){
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void PrintReport(Stats& stats, Clock::duration elapsed){
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::left << std::setw(8) << "endpoint"sv << std::right
+              << std::setw(10) << "requests"sv << std::setw(8) << "errors"sv << std::setw(10) << "rps"sv
+              << std::setw(10) << "p50 ms"sv << std::setw(10) << "p99 ms"sv << std::setw(10) << "p999 ms"sv
+              << std::setw(10) << "max ms"sv << '\n';
+    std::cout << std::fixed << std::setprecision(2);
+    for(size_t i = 0; i < stats.size(); ++i){
+        LatencyStats& endpoint = stats[i];
+        std::cout << std::left << std::setw(8) << ENDPOINT_NAMES[i] << std::right
+                  << std::setw(10) << endpoint.GetCount() << std::setw(8) << endpoint.GetErrors()
+                  << std::setw(10) << endpoint.GetCount() / seconds
+                  << std::setw(10) << ToMilliseconds(endpoint.GetPercentile(0.5))
+                  << std::setw(10) << ToMilliseconds(endpoint.GetPercentile(0.99))
+                  << std::setw(10) << ToMilliseconds(endpoint.GetPercentile(0.999))
+                  << std::setw(10) << ToMilliseconds(endpoint.GetPercentile(1)) << '\n';
+    }
+}
+
+/* ------------------------ HttpClient ----------------------------------- */
+
+/* Соединение keep-alive с сервером. После ошибки соединение устанавливается заново */
+class HttpClient{
+public:
+    HttpClient(net::any_io_executor executor, const tcp::resolver::results_type& endpoints,
+               std::chrono::milliseconds timeout)
+        : stream_(std::move(executor))
+        , endpoints_(endpoints)
+        , timeout_(timeout){
+    }
+
+    /* Возвращает nullopt при сетевой ошибке или тайм-ауте */
+    net::awaitable<std::optional<Response>> Send(Request& request){
+        sys::error_code ec;
+        if(!is_connected_){
+            stream_.expires_after(timeout_);
+            co_await stream_.async_connect(endpoints_, net::redirect_error(net::use_awaitable, ec));
+            if(ec){
+                co_return std::nullopt;
+            }
+            stream_.socket().set_option(tcp::no_delay(true));
+            is_connected_ = true;
+        }
+
+        stream_.expires_after(timeout_);
+        co_await http::async_write(stream_, request, net::redirect_error(net::use_awaitable, ec));
+        Response response;
+        if(!ec){
+            co_await http::async_read(stream_, buffer_, response, net::redirect_error(net::use_awaitable, ec));
+        }
+        if(ec || response.need_eof()){
+            Close();
+        }
+        if(ec){
+            co_return std::nullopt;
+        }
+        co_return response;
+    }
+
+    void Close(){
+        sys::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream_.close();
+        buffer_.clear();
+        is_connected_ = false;
+    }
+
+private:
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+    const tcp::resolver::results_type& endpoints_;
+    std::chrono::milliseconds timeout_;
+    bool is_connected_ = false;
+};
+
+Request MakeRequest(http::verb method, beast::string_view target, const Args& args){
+    Request request{method, target, 11};
+    request.set(http::field::host, args.host);
+    request.keep_alive(true);
+    return request;
+}
+
+Request MakeJsonRequest(beast::string_view target, std::string body, const Args& args){
+    Request request = MakeRequest(http::verb::post, target, args);
+    request.set(http::field::content_type, "application/json");
+    request.body() = std::move(body);
+    request.prepare_payload();
+    return request;
+}
+
+/* ------------------------ Bots ----------------------------------- */
+
+/* Общие для всех ботов потока данные */
+struct BotContext{
+    const Args& args;
+    const tcp::resolver::results_type& endpoints;
+    Stats& stats;
+    Clock::time_point deadline;
+};
+
+/*
+    Отправляет запросы с частотой rate до наступления срока.
+    make_request получает номер запроса и возвращает очередной запрос
+*/
+template <typename RequestFactory>
+net::awaitable<void> RunRequestLoop(BotContext& context, Endpoint endpoint, double rate,
+                                    Clock::duration phase, RequestFactory make_request){
+    const auto executor = co_await net::this_coro::executor;
+    HttpClient client(executor, context.endpoints, context.args.timeout);
+    net::steady_timer timer(executor);
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate));
+    LatencyStats& stats = GetStats(context.stats, endpoint);
+
+    Clock::time_point next_send = Clock::now() + phase;
+    for(uint64_t i = 0; next_send < context.deadline; ++i){
+        timer.expires_at(next_send);
+        sys::error_code ec;
+        co_await timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+
+        Request request = make_request(i);
+        /* В открытом режиме задержка включает опоздание отправки относительно плана */
+        const Clock::time_point start = context.args.mode == Mode::OPEN ? next_send : Clock::now();
+        const std::optional<Response> response = co_await client.Send(request);
+        const Clock::time_point end = Clock::now();
+        if(response && response->result_int() < 400){
+            stats.AddSuccess(end - start);
+        } else {
+            stats.AddError();
+        }
+        next_send = context.args.mode == Mode::OPEN ? next_send + interval : end + interval;
+    }
+}
+
+net::awaitable<void> RunBot(BotContext& context, unsigned bot_id){
+    const auto executor = co_await net::this_coro::executor;
+    std::mt19937 random(bot_id);
+
+    /* Боты входят в игру не одновременно, а в течение первой секунды */
+    net::steady_timer timer(executor, std::chrono::microseconds(random() % 1'000'000));
+    co_await timer.async_wait(net::use_awaitable);
+
+    HttpClient client(executor, context.endpoints, context.args.timeout);
+    json::object join_body{{"userName", "bot"s + std::to_string(bot_id)}, {"mapId", context.args.map_id}};
+    Request join = MakeJsonRequest("/api/v1/game/join", json::serialize(join_body), context.args);
+    const Clock::time_point start = Clock::now();
+    const std::optional<Response> response = co_await client.Send(join);
+    if(!response || response->result() != http::status::ok){
+        GetStats(context.stats, Endpoint::JOIN).AddError();
+        co_return;
+    }
+    GetStats(context.stats, Endpoint::JOIN).AddSuccess(Clock::now() - start);
+    client.Close();
+
+    const std::string authorization = "Bearer "s + std::string(json::parse(response->body()).as_object().at("authToken").as_string());
+    std::uniform_real_distribution<double> phase_dist(0, 1);
+
+    const double action_phase = phase_dist(random) / context.args.action_rate;
+    net::co_spawn(executor, RunRequestLoop(context, Endpoint::ACTION, context.args.action_rate,
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(action_phase)),
+        [&args = context.args, authorization, random](uint64_t) mutable {
+            constexpr std::array<std::string_view, 4> MOVES{"L"sv, "R"sv, "U"sv, "D"sv};
+            json::object body{{"move", MOVES[random() % MOVES.size()]}};
+            Request request = MakeJsonRequest("/api/v1/game/player/action", json::serialize(body), args);
+            request.set(http::field::authorization, authorization);
+            return request;
+        }), net::detached);
+
+    const double state_phase = phase_dist(random) / context.args.state_rate;
+    net::co_spawn(executor, RunRequestLoop(context, Endpoint::STATE, context.args.state_rate,
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(state_phase)),
+        [&args = context.args, authorization](uint64_t){
+            Request request = MakeRequest(http::verb::get, "/api/v1/game/state", args);
+            request.set(http::field::authorization, authorization);
+            return request;
+        }), net::detached);
+}
+
+/* Идентификатор первой карты из списка карт сервера */
+std::string GetFirstMapId(const Args& args, const tcp::resolver::results_type& endpoints){
+    net::io_context ioc;
+    beast::tcp_stream stream(ioc);
+    stream.connect(endpoints);
+    Request request = MakeRequest(http::verb::get, "/api/v1/maps", args);
+    http::write(stream, request);
+    beast::flat_buffer buffer;
+    Response response;
+    http::read(stream, buffer, response);
+    const json::array maps = json::parse(response.body()).as_array();
+    if(maps.empty()){
+        throw std::runtime_error("Server has no maps"s);
+    }
+    return std::string(maps.front().as_object().at("id").as_string());
+}
+
+}  // namespace load
+
+int main(int argc, const char* argv[]){
+    using namespace load;
+    try{
+        std::optional<Args> parsed_args = ParseCommandLine(argc, argv);
+        if(!parsed_args){
+            return EXIT_SUCCESS;
+        }
+        Args args = std::move(*parsed_args);
+
+        net::io_context resolver_ioc;
+        const tcp::resolver::results_type endpoints = tcp::resolver(resolver_ioc).resolve(args.host, args.port);
+        if(args.map_id.empty()){
+            args.map_id = GetFirstMapId(args, endpoints);
+        }
+        std::cout << "Running "sv << args.bots << " bots on map "sv << args.map_id << " for "sv
+                  << args.duration.count() << " s in "sv << (args.mode == Mode::OPEN ? "open"sv : "closed"sv)
+                  << "-loop mode"sv << std::endl;
+
+        /* У каждого потока свой io_context и своя статистика, поэтому потоки ничего не делят */
+        const Clock::time_point start = Clock::now();
+        std::vector<net::io_context> contexts(args.threads);
+        std::vector<Stats> stats(args.threads);
+        std::vector<BotContext> bot_contexts;
+        bot_contexts.reserve(args.threads);
+        for(unsigned i = 0; i < args.threads; ++i){
+            bot_contexts.push_back(BotContext{args, endpoints, stats[i], start + args.duration});
+        }
+        for(unsigned bot = 0; bot < args.bots; ++bot){
+            const unsigned thread = bot % args.threads;
+            net::co_spawn(contexts[thread], RunBot(bot_contexts[thread], bot), net::detached);
+        }
+
+        std::vector<std::jthread> threads;
+        for(net::io_context& ioc : contexts){
+            threads.emplace_back([&ioc]{
+                ioc.run();
+            });
+        }
+        threads.clear();
+        const Clock::duration elapsed = Clock::now() - start;
+
+        for(size_t i = 1; i < stats.size(); ++i){
+            for(size_t endpoint = 0; endpoint < ENDPOINT_NAMES.size(); ++endpoint){
+                stats.front()[endpoint].Merge(stats[i][endpoint]);
+            }
+        }
+        PrintReport(stats.front(), elapsed);
+    } catch(const std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
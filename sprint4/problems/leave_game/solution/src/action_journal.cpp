@@ -0,0 +1,387 @@
+#include "action_journal.h"
+#include "binary_codec.h"
+#include "file_descriptor.h"
+#include "logger.h"
+#include "metrics.h"
+#include <boost/crc.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+
+namespace serialization {
+
+using namespace std::literals;
+
+namespace {
+
+/*
+    Формат записи: [размер данных: u32][CRC32 данных: u32][данные],
+    данные начинаются с номера типа записи - индекса в JournalRecord.
+    Числа записываются в порядке байтов машины: журнал читает тот же сервер
+*/
+constexpr size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+using Encoder = util::BinaryWriter;
+using Decoder = util::BinaryReader;
+
+void Put(Encoder& encoder, const model::PairDouble& point){
+    encoder.Put(point.x);
+    encoder.Put(point.y);
+}
+
+bool Get(Decoder& decoder, model::PairDouble& point){
+    return decoder.Get(point.x) && decoder.Get(point.y);
+}
+
+void EncodePayload(const JoinRecord& record, Encoder& encoder){
+    encoder.Put(static_cast<int32_t>(record.player_id));
+    encoder.Put(record.name);
+    encoder.Put(record.map_id);
+    encoder.Put(record.token);
+    Put(encoder, record.pos);
+}
+
+void EncodePayload(const LootRecord& record, Encoder& encoder){
+    encoder.Put(record.map_id);
+    encoder.Put(static_cast<uint32_t>(record.loot.size()));
+    for(const model::Loot& loot : record.loot){
+        encoder.Put(loot.id);
+        encoder.Put(loot.type);
+        encoder.Put(loot.value);
+        Put(encoder, loot.pos);
+    }
+}
+
+void EncodePayload(const ActionRecord& record, Encoder& encoder){
+    encoder.Put(record.token);
+    encoder.Put(record.move);
+}
+
+void EncodePayload(const TickRecord& record, Encoder& encoder){
+    encoder.Put(record.delta);
+}
+
+void EncodePayload(const RetireRecord& record, Encoder& encoder){
+    encoder.Put(record.token);
+    encoder.Put(record.name);
+    encoder.Put(record.score);
+    encoder.Put(record.time);
+}
+
+bool DecodePayload(Decoder& decoder, JoinRecord& record){
+    int32_t player_id;
+    if(!decoder.Get(player_id)){
+        return false;
+    }
+    record.player_id = player_id;
+    return decoder.Get(record.name) && decoder.Get(record.map_id)
+        && decoder.Get(record.token) && Get(decoder, record.pos);
+}
+
+bool DecodePayload(Decoder& decoder, LootRecord& record){
+    uint32_t count;
+    if(!decoder.Get(record.map_id) || !decoder.Get(count)){
+        return false;
+    }
+    for(uint32_t i = 0; i < count; ++i){
+        model::Loot loot;
+        if(!decoder.Get(loot.id) || !decoder.Get(loot.type)
+            || !decoder.Get(loot.value) || !Get(decoder, loot.pos)){
+            return false;
+        }
+        record.loot.push_back(loot);
+    }
+    return true;
+}
+
+bool DecodePayload(Decoder& decoder, ActionRecord& record){
+    return decoder.Get(record.token) && decoder.Get(record.move);
+}
+
+bool DecodePayload(Decoder& decoder, TickRecord& record){
+    return decoder.Get(record.delta);
+}
+
+bool DecodePayload(Decoder& decoder, RetireRecord& record){
+    return decoder.Get(record.token) && decoder.Get(record.name) 
+        && decoder.Get(record.score) && decoder.Get(record.time);
+}
+
+uint32_t Checksum(std::string_view data){
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+void EncodeRecord(const JournalRecord& record, std::string& out){
+    const size_t header_pos = out.size();
+    out.append(RECORD_HEADER_SIZE, '\0');
+
+    Encoder encoder(out);
+    encoder.Put(static_cast<uint8_t>(record.index()));
+    std::visit([&encoder](const auto& typed_record){
+        EncodePayload(typed_record, encoder);
+    }, record);
+
+    const std::string_view payload = std::string_view(out).substr(header_pos + RECORD_HEADER_SIZE);
+    const uint32_t header[] = {static_cast<uint32_t>(payload.size()), Checksum(payload)};
+    std::memcpy(out.data() + header_pos, header, RECORD_HEADER_SIZE);
+}
+
+template <size_t Index = 0>
+std::optional<JournalRecord> DecodeTyped(size_t type, Decoder& decoder){
+    if constexpr (Index < std::variant_size_v<JournalRecord>){
+        if(type != Index){
+            return DecodeTyped<Index + 1>(type, decoder);
+        }
+        std::variant_alternative_t<Index, JournalRecord> record;
+        if(!DecodePayload(decoder, record) || !decoder.IsEmpty()){
+            return std::nullopt;
+        }
+        return JournalRecord{std::move(record)};
+    } else {
+        return std::nullopt;
+    }
+}
+
+/* Отделяет от data очередную запись. Возвращает nullopt, если запись неполная или повреждена */
+std::optional<JournalRecord> DecodeRecord(std::string_view& data){
+    if(data.size() < RECORD_HEADER_SIZE){
+        return std::nullopt;
+    }
+    uint32_t header[2];
+    std::memcpy(header, data.data(), RECORD_HEADER_SIZE);
+    const auto [size, checksum] = header;
+    if(data.size() - RECORD_HEADER_SIZE < size){
+        return std::nullopt;
+    }
+    const std::string_view payload = data.substr(RECORD_HEADER_SIZE, size);
+    if(Checksum(payload) != checksum){
+        return std::nullopt;
+    }
+    data.remove_prefix(RECORD_HEADER_SIZE + size);
+
+    Decoder decoder(payload);
+    uint8_t type;
+    if(!decoder.Get(type)){
+        return std::nullopt;
+    }
+    return DecodeTyped(type, decoder);
+}
+
+std::filesystem::path SegmentPath(const std::filesystem::path& base_path, ActionJournal::Segment segment){
+    std::filesystem::path path = base_path;
+    path += "."s + std::to_string(segment);
+    return path;
+}
+
+/* Номера существующих сегментов журнала по возрастанию */
+std::vector<ActionJournal::Segment> ListSegments(const std::filesystem::path& base_path){
+    std::vector<ActionJournal::Segment> segments;
+    std::filesystem::path directory = base_path.parent_path();
+    if(directory.empty()){
+        directory = ".";
+    }
+    const std::string prefix = base_path.filename().string() + "."s;
+
+    std::error_code ec;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, ec)){
+        const std::string name = entry.path().filename().string();
+        if(!name.starts_with(prefix)){
+            continue;
+        }
+        const std::string_view number = std::string_view(name).substr(prefix.size());
+        ActionJournal::Segment segment;
+        auto [ptr, parse_ec] = std::from_chars(number.data(), number.data() + number.size(), segment);
+        if(parse_ec == std::errc{} && ptr == number.data() + number.size()){
+            segments.push_back(segment);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void ObserveWriteError(){
+    static metrics::Counter& errors = metrics::GetRegistry().AddCounter("action_journal_write_errors_total"s, 
+        "Action journal writes that failed and were queued for another attempt"s).WithLabels({});
+    errors.Increment();
+}
+
+}  // namespace
+
+/* ------------------------ ActionJournal ----------------------------------- */
+
+ActionJournal::ActionJournal(std::filesystem::path base_path, const JournalOptions& options)
+    : base_path_(std::move(base_path))
+    , options_(options){
+    const std::vector<Segment> segments = ListSegments(base_path_);
+    segment_ = segments.empty() ? 1 : segments.back() + 1;
+    worker_ = std::thread([this]{ Run(); });
+}
+
+ActionJournal::~ActionJournal(){
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    has_work_.notify_one();
+    worker_.join();
+}
+
+void ActionJournal::Append(const JournalRecord& record){
+    std::lock_guard lock{mutex_};
+    if(pending_.empty() || pending_.back().segment != segment_){
+        pending_.push_back(Chunk{segment_, {}});
+    }
+    EncodeRecord(record, pending_.back().data);
+    ++pending_.back().records;
+    ++appended_count_;
+}
+
+ActionJournal::Segment ActionJournal::Rotate(){
+    std::lock_guard lock{mutex_};
+    return ++segment_;
+}
+
+void ActionJournal::Truncate(Segment first_kept){
+    for(Segment segment : ListSegments(base_path_)){
+        if(segment >= first_kept){
+            break;
+        }
+        std::error_code ec;
+        std::filesystem::remove(SegmentPath(base_path_, segment), ec);
+    }
+}
+
+bool ActionJournal::Commit(){
+    std::unique_lock lock{mutex_};
+    const uint64_t target = appended_count_;
+    if(committed_count_ >= target){
+        return true;
+    }
+    const uint64_t failed_writes = failed_writes_;
+    commit_requested_ = true;
+    has_work_.notify_one();
+    committed_.wait(lock, [this, target, failed_writes]{
+        return committed_count_ >= target || failed_writes_ != failed_writes;
+    });
+    return committed_count_ >= target;
+}
+
+size_t ActionJournal::Replay(const std::filesystem::path& base_path, Segment first_segment,
+                                const std::function<void(const JournalRecord&)>& action){
+    size_t count = 0;
+    for(Segment segment : ListSegments(base_path)){
+        if(segment < first_segment){
+            continue;
+        }
+        std::ifstream in(SegmentPath(base_path, segment), std::ios::in | std::ios::binary);
+        const std::string content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+        std::string_view data = content;
+        while(auto record = DecodeRecord(data)){
+            action(*record);
+            ++count;
+        }
+    }
+    return count;
+}
+
+void ActionJournal::Run(){
+    std::unique_lock lock{mutex_};
+    while(true){
+        has_work_.wait_for(lock, options_.commit_interval, [this]{
+            return stop_ || commit_requested_;
+        });
+        commit_requested_ = false;
+        if(pending_.empty()){
+            if(stop_){
+                return;
+            }
+            continue;
+        }
+
+        std::vector<Chunk> chunks = std::move(pending_);
+        pending_.clear();
+        lock.unlock();
+
+        size_t durable_count = 0;
+        bool failed = false;
+        try{
+            WriteChunks(chunks, durable_count);
+        } catch(const std::exception& ex){
+            /* Сегмент будет открыт заново и обрезан при следующей попытке */
+            file_.reset();
+            failed = true;
+            ObserveWriteError();
+            LOG_ERROR(0, ex.what(), "action journal"s);
+        }
+
+        lock.lock();
+        for(size_t i = 0; i < durable_count; ++i){
+            committed_count_ += chunks[i].records;
+        }
+        if(failed){
+            ++failed_writes_;
+            chunks.erase(chunks.begin(), chunks.begin() + durable_count);
+            if(stop_){
+                LOG_ERROR(0, std::to_string(appended_count_ - committed_count_) + " journal records are lost"s, 
+                        "action journal"s);
+                committed_.notify_all();
+                return;
+            }
+            /* Незаписанные чанки возвращаются в начало очереди, записи одного сегмента склеиваются */
+            if(!pending_.empty() && pending_.front().segment == chunks.back().segment){
+                chunks.back().data += pending_.front().data;
+                chunks.back().records += pending_.front().records;
+                pending_.erase(pending_.begin());
+            }
+            pending_.insert(pending_.begin(), std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+        }
+        committed_.notify_all();
+    }
+}
+
+void ActionJournal::WriteChunks(const std::vector<Chunk>& chunks, size_t& durable_count){
+    durable_count = 0;
+    /* Размер открытого сегмента вместе с ещё не сброшенными на диск данными */
+    uint64_t size = file_size_;
+    for(size_t i = 0; i < chunks.size(); ++i){
+        const Chunk& chunk = chunks[i];
+        if(!file_ || file_segment_ != chunk.segment){
+            /* Чанки идут по возрастанию сегментов, поэтому в открытом сегменте только предыдущий чанк */
+            if(file_){
+                file_->DataSync();
+                file_size_ = size;
+                durable_count = i;
+            }
+            file_.reset();
+            OpenSegment(chunk.segment);
+            size = file_size_;
+        }
+        file_->Write(chunk.data);
+        size += chunk.data.size();
+    }
+    file_->DataSync();
+    file_size_ = size;
+    durable_count = chunks.size();
+}
+
+void ActionJournal::OpenSegment(Segment segment){
+    const std::filesystem::path path = SegmentPath(base_path_, segment);
+    auto file = std::make_unique<util::FileDescriptor>(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(segment == file_segment_){
+        /* Предыдущая запись в этот сегмент прервалась: отрезаем то, что могло не попасть на диск целиком */
+        file->Truncate(static_cast<off_t>(file_size_));
+    } else {
+        file_size_ = static_cast<uint64_t>(file->GetSize());
+    }
+    util::SyncParentDirectory(path);
+    file_ = std::move(file);
+    file_segment_ = segment;
+}
+
+}  // namespace serialization
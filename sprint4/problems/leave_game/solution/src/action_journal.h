@@ -0,0 +1,168 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+#include "model.h"
+
+namespace util {
+class FileDescriptor;
+}  // namespace util
+
+namespace serialization {
+
+/*
+    Записи журнала хранят результат действия, а не его входные данные:
+    всё, что при повторном выполнении выбиралось бы случайно
+    (позиция собаки, токен, новые предметы), записывается готовым
+*/
+
+/* Игрок вошёл в игру */
+struct JoinRecord{
+    int player_id = 0;
+    std::string name;
+    std::string map_id;
+    std::string token;
+    model::PairDouble pos;
+};
+
+/* В сессии на карте map_id появились новые предметы */
+struct LootRecord{
+    std::string map_id;
+    std::vector<model::Loot> loot;
+};
+
+/* Игрок сменил направление движения. move - значение из запроса */
+struct ActionRecord{
+    std::string token;
+    std::string move;
+};
+
+/* Игровые часы продвинулись на delta миллисекунд */
+struct TickRecord{
+    unsigned delta = 0;
+};
+
+/* 
+    Игрок ушёл на покой и покинул игру. Результат хранится в записи:
+    после сбоя он мог не успеть попасть в базу данных
+*/
+struct RetireRecord{
+    std::string token;
+    std::string name;
+    uint32_t score = 0;
+    double time = 0;
+};
+
+using JournalRecord = std::variant<JoinRecord, LootRecord, ActionRecord, TickRecord, RetireRecord>;
+
+struct JournalOptions{
+    /* Как часто накопленные записи сбрасываются на диск одним вызовом fdatasync */
+    std::chrono::milliseconds commit_interval{10};
+};
+
+/*
+    Журнал действий, который только дописывается (write-ahead log).
+    Append лишь кодирует запись в буфер, а фоновый поток раз в commit_interval
+    записывает все накопленные записи и сбрасывает их на диск одним fdatasync (group commit).
+
+    Журнал состоит из сегментов <base_path>.<номер>. Перед снимком состояния
+    начинается новый сегмент, а когда снимок записан, более старые сегменты удаляются:
+    всё, что в них было, уже есть в снимке.
+
+    Если запись на диск завершилась ошибкой, незаписанные записи остаются в очереди,
+    а сегмент перед повторной попыткой обрезается до последнего сброшенного на диск размера,
+    чтобы в нём не осталось оборванной записи, на которой остановится Replay
+*/
+class ActionJournal{
+public:
+    using Segment = uint64_t;
+
+    /* Новые записи попадают в сегмент, следующий за последним существующим */
+    explicit ActionJournal(std::filesystem::path base_path, const JournalOptions& options = {});
+
+    ActionJournal(const ActionJournal&) = delete;
+    ActionJournal& operator=(const ActionJournal&) = delete;
+
+    /* Дописывает и сбрасывает на диск все добавленные записи */
+    ~ActionJournal();
+
+    void Append(const JournalRecord& record);
+
+    /*
+        Начинает новый сегмент и возвращает его номер.
+        Записи, добавленные до вызова, остаются в предыдущих сегментах
+    */
+    Segment Rotate();
+
+    /* Удаляет сегменты с номерами меньше first_kept. Можно вызывать из любого потока */
+    void Truncate(Segment first_kept);
+
+    /* 
+        Дожидается, пока все добавленные до вызова записи окажутся на диске.
+        Возвращает false, если очередная попытка записи завершилась ошибкой:
+        записи остаются в очереди и будут записаны повторно
+    */
+    bool Commit();
+
+    /*
+        Вызывает action для каждой записи сегментов с номерами не меньше first_segment по порядку.
+        Чтение сегмента прекращается на первой неполной или повреждённой записи:
+        такая запись не успела попасть на диск целиком.
+        Возвращает число прочитанных записей
+    */
+    static size_t Replay(const std::filesystem::path& base_path, Segment first_segment,
+                            const std::function<void(const JournalRecord&)>& action);
+
+private:
+    struct Chunk{
+        Segment segment;
+        std::string data;
+        /* Число записей в data */
+        uint64_t records = 0;
+    };
+
+    void Run();
+
+    /* 
+        Записывает чанки по порядку и сбрасывает их на диск.
+        В durable_count сообщается, сколько первых чанков уже на диске, даже если запись прервалась исключением
+    */
+    void WriteChunks(const std::vector<Chunk>& chunks, size_t& durable_count);
+
+    /* Открывает сегмент для дописывания. Сегмент, запись в который прервалась, обрезается до file_size_ */
+    void OpenSegment(Segment segment);
+
+    std::filesystem::path base_path_;
+    JournalOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable committed_;
+    std::vector<Chunk> pending_;
+    Segment segment_;
+    /* Число добавленных и записанных на диск записей за всё время */
+    uint64_t appended_count_ = 0;
+    uint64_t committed_count_ = 0;
+    /* Число попыток записи, завершившихся ошибкой */
+    uint64_t failed_writes_ = 0;
+    bool commit_requested_ = false;
+    bool stop_ = false;
+
+    /* Открытый сегмент, с ним работает только фоновый поток */
+    std::unique_ptr<util::FileDescriptor> file_;
+    Segment file_segment_ = 0;
+    /* Размер сегмента file_segment_, который точно сброшен на диск */
+    uint64_t file_size_ = 0;
+
+    std::thread worker_;
+};
+
+}  // namespace serialization
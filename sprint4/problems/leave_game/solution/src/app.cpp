@@ -4,6 +4,8 @@
 
 namespace app{
 
+using namespace std::literals;
+
 namespace detail{
 
 /* ------------------------ Ticker ----------------------------------- */
@@ -36,6 +38,62 @@ void Ticker::OnTick(sys::error_code ec) {
     }
 }
 
+/* ------------------------ GameMetrics ----------------------------------- */
+
+GameMetrics::GameMetrics()
+    : tick_duration_(metrics::GetRegistry().AddHistogram("game_tick_duration_seconds", 
+        "Time spent in one game tick").WithLabels({}))
+    , players_(metrics::GetRegistry().AddGauge("game_players", "Players in game sessions", {"map"}))
+    , sessions_(metrics::GetRegistry().AddGauge("game_sessions", "Game sessions", {"map"}))
+    , loot_objects_(metrics::GetRegistry().AddGauge("game_loot_objects", "Loot lying on the map", {"map"}))
+    , loot_in_bags_(metrics::GetRegistry().AddGauge("game_loot_in_bags", "Loot carried by dogs", {"map"})){
+    auto& phases = metrics::GetRegistry().AddHistogram("game_tick_phase_duration_seconds", 
+        "Time spent in one phase of a game tick", {"phase"});
+    for(Phase phase : {Phase::UPDATE, Phase::SAVE, Phase::SNAPSHOT, Phase::BROADCAST, Phase::LOOT}){
+        phase_durations_[static_cast<size_t>(phase)] = &phases.WithLabels({GetPhaseName(phase)});
+    }
+}
+
+std::string_view GameMetrics::GetPhaseName(Phase phase){
+    switch(phase){
+        case Phase::UPDATE:
+            return "update";
+        case Phase::SAVE:
+            return "save";
+        case Phase::SNAPSHOT:
+            return "snapshot";
+        case Phase::BROADCAST:
+            return "broadcast";
+        case Phase::LOOT:
+            return "loot";
+    }
+    return "unknown";
+}
+
+void GameMetrics::UpdateGameSize(const Game& game){
+    for(const Map& map : game.GetMaps()){
+        size_t session_count = 0;
+        size_t player_count = 0;
+        size_t loot_count = 0;
+        size_t bag_count = 0;
+        if(auto it = game.GetAllSessions().find(map.GetId()); it != game.GetAllSessions().end()){
+            session_count = it->second.size();
+            for(const GameSession& session : it->second){
+                player_count += session.GetDogs().size();
+                loot_count += session.GetLootObjects().size();
+                for(const Dog& dog : session.GetDogs()){
+                    bag_count += (*dog.GetBag()).size();
+                }
+            }
+        }
+        const std::string_view map_id = *map.GetId();
+        sessions_.WithLabels({map_id}).Set(session_count);
+        players_.WithLabels({map_id}).Set(player_count);
+        loot_objects_.WithLabels({map_id}).Set(loot_count);
+        loot_in_bags_.WithLabels({map_id}).Set(bag_count);
+    }
+}
+
 /* ------------------------ PlayerTimeClock ----------------------------------- */
 
 void PlayerTimeClock::IncreaseTime(size_t delta){
@@ -208,58 +266,144 @@ std::string GameUseCase::JoinGame(const std::string& user_name, const std::strin
     using namespace std::literals;
     Map::Id map_id(str_map_id);
 
-    GameSession* session = game.SessionIsExists(map_id);
-    if(session == nullptr){
-        session = game.AddSession(map_id);
-    }
+    GameSession* session = FindOrAddSession(map_id, game);
 
-    Dog::Name dog_name(user_name);
     Dog::Position dog_pos = (is_random_spawn_enabled) 
         ? Dog::Position(Map::GetRandomPos(game.FindMap(map_id)->GetRoads())) 
         : Dog::Position(Map::GetFirstPos(game.FindMap(map_id)->GetRoads()));
-    Dog::Speed dog_speed({0, 0});
-    Direction dog_dir = Direction::NORTH;
 
-    Dog* dog = session->AddDog(auto_counter_, dog_name, dog_pos, 
-                                        dog_speed, dog_dir);
+    Player& player = AddPlayer(auto_counter_, user_name, session, dog_pos);
     /*
         С появлением нового игрока в сессии,
         нужно обновить количество потерянных объектов
     */
+    const unsigned last_loot_id = session->GetLastLootId();
     session->UpdateLoot(session->GetDogs().size() - session->GetLootObjects().size());
-    Player& player = players_.Add(auto_counter_, Player::Name(user_name), 
-                                        dog, session);
-    ++auto_counter_;
 
     Token token = tokens_.AddPlayer(player);
     /* 
         Добавляем часы для игрока
     */
     AddPlayerTimeClock(&player);
+
+    if(journal_ != nullptr){
+        journal_->Append(serialization::JoinRecord{player.GetId(), user_name, str_map_id, token.ToHex(), *dog_pos});
+        JournalNewLoot(*session, last_loot_id);
+    }
     
     json::object json_body;
-    json_body["authToken"] = *token;
+    json_body["authToken"] = token.ToHex();
     json_body["playerId"] = player.GetId();
 
     return json::serialize(json_body);   
 }
 
-std::string GameUseCase::GetGameState(const Token& token) const{
-    json::object result;
-    const GameSession* session = tokens_.FindPlayerByToken(token)->GetSession();
+SharedBuffer GameUseCase::GetGameState(const Token& token) const{
+    return GetSessionState(tokens_.FindPlayerByToken(token)->GetSession());
+}
+
+SharedBuffer GameUseCase::GetSessionState(const GameSession* session) const{
+    StateSnapshot& snapshot = state_snapshots_[session];
+    if(!snapshot.body || snapshot.revision != session->GetRevision()){
+        std::string& buffer = util::GetScratchBuffer();
+        util::JsonWriter writer(buffer);
+        writer.StartObject();
+        writer.Key("players"sv);
+        WritePlayers(writer, tokens_.GetPlayersBySession(session));
+        writer.Key("lostObjects"sv);
+        WriteLostObjects(writer, session->GetLootObjects());
+        writer.EndObject();
+
+        snapshot.body = std::make_shared<const std::string>(buffer);
+        snapshot.revision = session->GetRevision();
+    }
+
+    return snapshot.body;
+}
+
+SharedBuffer GameUseCase::GetGameStateDelta(const Player* player, uint64_t since) const{
+    const GameSession* session = player->GetSession();
+    const ChangeJournal& journal = session->GetChangeJournal();
+
+    std::string& buffer = util::GetScratchBuffer();
+    util::JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("tick"sv).Number(session->GetTick());
+
+    if(since > session->GetTick() || !journal.Covers(since)){
+        writer.Key("players"sv);
+        WritePlayers(writer, tokens_.GetPlayersBySession(session));
+        writer.Key("lostObjects"sv);
+        WriteLostObjects(writer, session->GetLootObjects());
+        writer.EndObject();
+        return std::make_shared<const std::string>(buffer);
+    }
+
+    /* Для каждого объекта важно только последнее изменение */
+    std::unordered_map<uint64_t, ChangeJournal::Change> dogs_changes;
+    std::unordered_map<uint64_t, ChangeJournal::Change> loot_changes;
+    journal.ForEachSince(since, [&dogs_changes, &loot_changes](const ChangeJournal::Entry& entry){
+        auto& changes = (entry.object == ChangeJournal::Object::DOG) ? dogs_changes : loot_changes;
+        changes[entry.id] = entry.change;
+    });
+
+    writer.Key("since"sv).Number(since);
+
+    writer.Key("players"sv).StartObject();
+    if(!dogs_changes.empty()){
+        for(const Player* player : tokens_.GetPlayersBySession(session)){
+            auto it = dogs_changes.find(player->GetId());
+            if(it != dogs_changes.end() && it->second == ChangeJournal::Change::UPSERT){
+                writer.Key(player->GetId());
+                WritePlayerAttributes(writer, player);
+            }
+        }
+    }
+    writer.EndObject();
+
+    writer.Key("lostObjects"sv).StartObject();
+    if(!loot_changes.empty()){
+        for(const Loot& loot : session->GetLootObjects()){
+            auto it = loot_changes.find(loot.id);
+            if(it != loot_changes.end() && it->second == ChangeJournal::Change::UPSERT){
+                writer.Key(loot.id);
+                WriteLootDescription(writer, loot);
+            }
+        }
+    }
+    writer.EndObject();
 
-    result["players"] = GetPlayers(tokens_.GetPlayersBySession(session));
-    result["lostObjects"] = GetLostObjects(session->GetLootObjects());
+    auto write_removed = [&writer](const std::unordered_map<uint64_t, ChangeJournal::Change>& changes){
+        writer.StartArray();
+        for(const auto& [id, change] : changes){
+            if(change == ChangeJournal::Change::REMOVE){
+                writer.Number(id);
+            }
+        }
+        writer.EndArray();
+    };
+    writer.Key("removedPlayers"sv);
+    write_removed(dogs_changes);
+    writer.Key("removedLostObjects"sv);
+    write_removed(loot_changes);
+
+    writer.EndObject();
+    return std::make_shared<const std::string>(buffer);
+}
 
-    return json::serialize(result);
+std::string GameUseCase::SetAction(Player* player, std::string_view move){
+    SetMove(player, move);
+    if(journal_ != nullptr){
+        journal_->Append(serialization::ActionRecord{player->GetToken().ToHex(), std::string(move)});
+    }
+    return "{}";
 }
 
-std::string GameUseCase::SetAction(const json::object& action, const Token& token){
-    Player* player = tokens_.FindPlayerByToken(token);
+void GameUseCase::SetMove(Player* player, std::string_view dir){
     double dog_speed = player->GetSession()->GetMap()->GetDogSpeed();
-    Direction new_dir;
+    /* Остановившаяся собака смотрит туда же, куда и раньше */
+    Direction new_dir = player->GetDog()->GetDirection();
     Dog::Speed new_speed({0, 0});    
-    std::string dir = std::string(action.at("move").as_string());
     if(dir == "U"){
         new_speed = Dog::Speed({0, -dog_speed});
         new_dir = Direction::NORTH;
@@ -275,126 +419,250 @@ std::string GameUseCase::SetAction(const json::object& action, const Token& toke
     }
     player->GetDog()->SetSpeed(new_speed);
     player->GetDog()->SetDirection(new_dir);
-    return "{}";
+    player->GetSession()->MarkDogChanged(*player->GetDog());
 }
 
 std::string GameUseCase::IncreaseTime(unsigned delta, Game& game){
     std::deque<const Player*> retired_players;
-    for(auto& [player, clock] : clocks_){
-        clock.IncreaseTime(delta);
-        auto inactivity_time = clock.GetInactivityTime();
-        if(inactivity_time.has_value()){
-            unsigned converted_time_ms = static_cast<double>(inactivity_time->count());
-            if(converted_time_ms >= (game.GetDogRetirementTime() * 1000)){
-                retired_players.push_back(player);
+    {
+        /* Игроки, бездействовавшие дольше dogRetirementTime, уходят на покой */
+        tracing::Span span("retire", "tick");
+        for(auto& [player, clock] : clocks_){
+            clock.IncreaseTime(delta);
+            auto inactivity_time = clock.GetInactivityTime();
+            if(inactivity_time.has_value()){
+                unsigned converted_time_ms = static_cast<double>(inactivity_time->count());
+                if(converted_time_ms >= (game.GetDogRetirementTime() * 1000)){
+                    retired_players.push_back(player);
+                }
             }
         }
-    }
 
-    for(const Player* player : retired_players){
-        SaveScore(player, game);
-        DisconnectPlayer(player, game);
+        for(const Player* player : retired_players){
+            serialization::RetireRecord record = MakeRetireRecord(player, game);
+            if(journal_ != nullptr){
+                journal_->Append(record);
+            }
+            SaveScore(record);
+            DisconnectPlayer(player, game);
+        }
     }
 
     game.UpdateGameState(delta);
+    if(journal_ != nullptr){
+        journal_->Append(serialization::TickRecord{delta});
+    }
 
     return "{}";
 }
 
 void GameUseCase::GenerateLoot(Milliseconds delta, Game& game){
+    if(journal_ == nullptr){
+        game.GenerateLootInSessions(delta);
+        return;
+    }
+
+    std::vector<std::pair<const GameSession*, unsigned>> last_loot_ids;
+    for(const auto& [map_id, sessions] : game.GetAllSessions()){
+        for(const GameSession& session : sessions){
+            last_loot_ids.emplace_back(&session, session.GetLastLootId());
+        }
+    }
     game.GenerateLootInSessions(delta);
+    for(const auto& [session, last_loot_id] : last_loot_ids){
+        JournalNewLoot(*session, last_loot_id);
+    }
+}
+
+void GameUseCase::Replay(const serialization::JournalRecord& record, Game& game){
+    std::visit([this, &game](const auto& typed_record){
+        ReplayRecord(typed_record, game);
+    }, record);
+}
+
+void GameUseCase::ReservePlayerId(int id){
+    auto_counter_ = std::max(auto_counter_, id + 1);
 }
 
-std::string GameUseCase::GetRecords(unsigned start, unsigned max_items){
-    json::array records;
+void GameUseCase::SetJournal(serialization::ActionJournal* journal){
+    journal_ = journal;
+}
+
+void GameUseCase::ReplayRecord(const serialization::JoinRecord& record, Game& game){
+    GameSession* session = FindOrAddSession(Map::Id(record.map_id), game);
+    Player& player = AddPlayer(record.player_id, record.name, session, Dog::Position(record.pos));
+    tokens_.AddPlayerWithToken(player, Token::Parse(record.token));
+    tokens_.AddPlayerInSession(player, session);
+    AddPlayerTimeClock(&player);
+}
 
-    auto res = db_manager_->SelectData(start, max_items);
-    for(const auto& [name, score, time] : res.iter<std::string, unsigned, double>()){
-        json::object entry;
-        entry["name"] = name;
-        entry["score"] = score;
-        entry["playTime"] = time;
-        records.push_back(entry);
+void GameUseCase::ReplayRecord(const serialization::LootRecord& record, Game& game){
+    GameSession* session = FindOrAddSession(Map::Id(record.map_id), game);
+    for(const Loot& loot : record.loot){
+        session->AddLoot(loot);
     }
+}
 
-    return json::serialize(records);
+void GameUseCase::ReplayRecord(const serialization::ActionRecord& record, [[maybe_unused]] Game& game){
+    if(Player* player = tokens_.FindPlayerByToken(Token::Parse(record.token)); player != nullptr){
+        SetMove(player, record.move);
+    }
 }
 
-json::array GameUseCase::GetBagItems(const Dog::Bag& bag_items){
-    json::array items;
-    for(const Loot& loot : *bag_items){
-        json::object loot_desc;
-        loot_desc["id"] = loot.id;
-        loot_desc["type"] = loot.type;
+void GameUseCase::ReplayRecord(const serialization::TickRecord& record, Game& game){
+    /* Уход на покой записан в журнал отдельно, поэтому здесь только идут часы */
+    for(auto& [player, clock] : clocks_){
+        clock.IncreaseTime(record.delta);
+    }
+    game.UpdateGameState(record.delta);
+}
 
-        items.push_back(loot_desc);
-    }   
+void GameUseCase::ReplayRecord(const serialization::RetireRecord& record, Game& game){
+    /* 
+        Отложенная запись могла не успеть сохранить результат до сбоя,
+        поэтому он записывается снова, если его ещё нет в базе данных
+    */
+    if(!saved_retirements_.contains(Token::Parse(record.token))){
+        SaveScore(record);
+    }
+    if(const Player* player = tokens_.FindPlayerByToken(Token::Parse(record.token)); player != nullptr){
+        DisconnectPlayer(player, game);
+    }
+}
 
-    return items;
-};
+GameSession* GameUseCase::FindOrAddSession(const Map::Id& map_id, Game& game){
+    GameSession* session = game.SessionIsExists(map_id);
+    if(session == nullptr){
+        session = game.AddSession(map_id);
+    }
+    return session;
+}
 
-json::object GameUseCase::GetPlayers(const PlayerTokens::PlayersInSession& players_in_session) const{
-    json::object players;
+Player& GameUseCase::AddPlayer(int id, const std::string& user_name, GameSession* session, const Dog::Position& pos){
+    GameSession::DogHandle dog = session->AddDog(id, Dog::Name(user_name), pos, 
+                                        Dog::Speed({0, 0}), Direction::NORTH);
+    Player& player = players_.Add(id, Player::Name(user_name), dog, session);
+    ReservePlayerId(id);
+    return player;
+}
 
-    for(const Player* player : players_in_session){
-        json::object player_attributes;
-
-        const PairDouble& pos = *(player->GetDog()->GetPosition());
-        player_attributes["pos"] = {pos.x, pos.y};
-        
-        const PairDouble& speed = *(player->GetDog()->GetSpeed());
-        player_attributes["speed"] = {speed.x, speed.y};
-
-        Direction dir = player->GetDog()->GetDirection();
-        switch (dir)
-        {
-            case Direction::NORTH:
-                player_attributes["dir"] = "U";
-                break;
-            case Direction::SOUTH:
-                player_attributes["dir"] = "D";
-                break;
-            case Direction::WEST:
-                player_attributes["dir"] = "L";
-                break;
-            case Direction::EAST:
-                player_attributes["dir"] = "R";
-                break;
-            default:
-                player_attributes["dir"] = "Unknown";
+void GameUseCase::JournalNewLoot(const GameSession& session, unsigned last_loot_id){
+    serialization::LootRecord record;
+    for(const Loot& loot : session.GetLootObjects()){
+        if(loot.id > last_loot_id){
+            record.loot.push_back(loot);
         }
+    }
+    if(!record.loot.empty()){
+        record.map_id = *session.GetMap()->GetId();
+        journal_->Append(record);
+    }
+}
+
+std::string GameUseCase::GetRecords(unsigned start, unsigned max_items) const{
+    std::string& buffer = util::GetScratchBuffer();
+    util::JsonWriter writer(buffer);
+
+    writer.StartArray();
+    leaderboard_.ForEachOnPage(start, max_items, [&writer](const Leaderboard::Record& record){
+        writer.StartObject();
+        writer.Key("name"sv).String(record.name);
+        writer.Key("score"sv).Number(record.score);
+        writer.Key("playTime"sv).Number(record.time);
+        writer.EndObject();
+    });
+    writer.EndArray();
+
+    return buffer;
+}
 
-        player_attributes["bag"] = GetBagItems(player->GetDog()->GetBag());
-        player_attributes["score"] = player->GetDog()->GetScore();
-        // auto time = clocks_.at(player).GetInactivityTime();
-        // if(time.has_value()){
-        //     player_attributes["retirement_time"] = time->count();
-        // } else {
-        //     json::value empty;
-        //     empty.emplace_null();
-        //     player_attributes["retirement_time"] = empty;
-        // }
+std::string GameUseCase::GetRecordsETag(unsigned start, unsigned max_items) const{
+    std::ostringstream etag;
+    etag << '"' << std::hex << leaderboard_.GetPageTag(start, max_items) << '"';
+    return etag.str();
+}
 
-        players[std::to_string(player->GetId())] = player_attributes;
+void GameUseCase::LoadLeaderboard(){
+    if(!db_manager_){
+        return;
+    }
+    auto res = db_manager_->SelectAll();
+    for(const auto& [name, score, time, retirement_id] : res.iter<std::string, unsigned, double, std::string>()){
+        leaderboard_.Add(name, score, time);
+        saved_retirements_.insert(Token::Parse(retirement_id));
     }
+}
 
-    return players;
+void GameUseCase::WriteBagItems(util::JsonWriter& writer, const Dog::Bag& bag_items){
+    writer.StartArray();
+    for(const Loot& loot : *bag_items){
+        writer.StartObject();
+        writer.Key("id"sv).Number(loot.id);
+        writer.Key("type"sv).Number(loot.type);
+        writer.EndObject();
+    }
+    writer.EndArray();
 }
 
-json::object GameUseCase::GetLostObjects(const std::list<Loot>& loots){
-    json::object lost_objects;
+void GameUseCase::WritePlayers(util::JsonWriter& writer, const PlayerTokens::PlayersInSession& players_in_session){
+    writer.StartObject();
+    for(const Player* player : players_in_session){
+        writer.Key(player->GetId());
+        WritePlayerAttributes(writer, player);
+    }
+    writer.EndObject();
+}
+
+void GameUseCase::WritePlayerAttributes(util::JsonWriter& writer, const Player* player){
+    writer.StartObject();
+
+    const PairDouble& pos = *(player->GetDog()->GetPosition());
+    writer.Key("pos"sv).Pair(pos.x, pos.y);
     
-    for(const Loot& loot : loots){
-        json::object loot_decs;
+    const PairDouble& speed = *(player->GetDog()->GetSpeed());
+    writer.Key("speed"sv).Pair(speed.x, speed.y);
+
+    writer.Key("dir"sv);
+    Direction dir = player->GetDog()->GetDirection();
+    switch (dir)
+    {
+        case Direction::NORTH:
+            writer.String("U"sv);
+            break;
+        case Direction::SOUTH:
+            writer.String("D"sv);
+            break;
+        case Direction::WEST:
+            writer.String("L"sv);
+            break;
+        case Direction::EAST:
+            writer.String("R"sv);
+            break;
+        default:
+            writer.String("Unknown"sv);
+    }
 
-        loot_decs["type"] = loot.type;
-        json::array pos = { loot.pos.x, loot.pos.y };
-        loot_decs["pos"] = pos;
+    writer.Key("bag"sv);
+    WriteBagItems(writer, player->GetDog()->GetBag());
+    writer.Key("score"sv).Number(player->GetDog()->GetScore());
 
-        lost_objects[std::to_string(loot.id)] = loot_decs;
+    writer.EndObject();
+}
+
+void GameUseCase::WriteLostObjects(util::JsonWriter& writer, const GameSession::LootObjects& loots){
+    writer.StartObject();
+    for(const Loot& loot : loots){
+        writer.Key(loot.id);
+        WriteLootDescription(writer, loot);
     }
+    writer.EndObject();
+}
 
-    return lost_objects;
+void GameUseCase::WriteLootDescription(util::JsonWriter& writer, const Loot& loot){
+    writer.StartObject();
+    writer.Key("type"sv).Number(loot.type);
+    writer.Key("pos"sv).Pair(loot.pos.x, loot.pos.y);
+    writer.EndObject();
 }
 
 void GameUseCase::AddPlayerTimeClock(Player* player){
@@ -409,18 +677,22 @@ void GameUseCase::AddPlayerTimeClock(Player* player){
     } 
 }
 
-void GameUseCase::SaveScore(const Player* player, Game& game){
-    std::string name = *(player->GetName());
-    unsigned score = player->GetDog()->GetScore();
+serialization::RetireRecord GameUseCase::MakeRetireRecord(const Player* player, const Game& game) const{
     double given_time = static_cast<double>(clocks_.at(player).GetPlaytime().count()) / 1000;
     double time = std::min(given_time, static_cast<double>(game.GetDogRetirementTime()));
-    
-    db_manager_->InsertData(name, score, time);
+    return {player->GetToken().ToHex(), *(player->GetName()), player->GetDog()->GetScore(), time};
+}
+
+void GameUseCase::SaveScore(const serialization::RetireRecord& record){
+    leaderboard_.Add(record.name, record.score, record.time);
+    if(db_manager_){
+        db_manager_->EnqueueInsert(record.name, record.score, record.time, record.token);
+    }
 }
 
 void GameUseCase::DisconnectPlayer(const Player* player, Game& game){
     const GameSession* player_game_session = player->GetSession();
-    const Dog* player_dog =  player->GetDog();
+    GameSession::DogHandle player_dog = player->GetDogHandle();
 
     tokens_.DeletePlayer(player);
     auto it = clocks_.find(player);
@@ -433,13 +705,16 @@ void GameUseCase::DisconnectPlayer(const Player* player, Game& game){
 /* ------------------------ ListPlayersUseCase ----------------------------------- */
 
 std::string ListPlayersUseCase::GetPlayersInJSON(const PlayerTokens::PlayersInSession& players){
-    json::object player_list;
+    std::string& buffer = util::GetScratchBuffer();
+    util::JsonWriter writer(buffer);
+    writer.StartObject();
     for(const Player* player : players){
-        json::object player_description;
-        player_description["name"] = *(player->GetName());
-        player_list[std::to_string(player->GetId())] = player_description;
+        writer.Key(player->GetId()).StartObject();
+        writer.Key("name"sv).String(*(player->GetName()));
+        writer.EndObject();
     }
-    return json::serialize(player_list);
+    writer.EndObject();
+    return buffer;
 }
 
 /* ------------------------ GameStateSaveCase ----------------------------------- */
@@ -460,24 +735,86 @@ void GameStateSaveCase::SaveOnTick(bool is_periodic){
 }
 
 void GameStateSaveCase::SaveState(){
-    using namespace std::literals;
-    std::fstream fstrm(state_file_ /*+ "_temp"s*/, std::ios::out);
-    boost::archive::text_oarchive output_archive{fstrm};
+    const auto start = Clock::now();
+    /* Всё, что было записано в журнал до этого момента, попадает в снимок */
+    const serialization::ActionJournal::Segment segment = journal_.Rotate();
     serialization::GameStateRepr writed_game_state(sessions_, players_);
-    output_archive << writed_game_state;
+    writed_game_state.SetJournalSegment(segment);
+    writer_.Save(std::move(writed_game_state), Clock::now() - start, [this, segment]{
+        journal_.Truncate(segment);
+    });
+}
+
+void GameStateSaveCase::WaitSaved(){
+    writer_.Flush();
+}
+
+serialization::StateSaveStats GameStateSaveCase::GetSaveStats() const{
+    return writer_.GetStats();
 }
 
 serialization::GameStateRepr GameStateSaveCase::LoadState(){
-    using namespace std::literals;
-    std::fstream fstrm(state_file_, std::ios::in);
-    serialization::GameStateRepr game_state;
-    try{
-        boost::archive::text_iarchive input_archive{fstrm};
-        input_archive >> game_state;
-        return game_state;
-    } catch(...){
-        return game_state;
+    return serialization::ReadStateFile(state_file_);
+}
+
+void GameStateSaveCase::ReplayJournal(const serialization::GameStateRepr& state, 
+                                        const std::function<void(const serialization::JournalRecord&)>& action){
+    serialization::ActionJournal::Replay(state_file_ + ".journal", state.GetJournalSegment(), action);
+    journal_.Truncate(state.GetJournalSegment());
+}
+
+serialization::ActionJournal& GameStateSaveCase::GetJournal(){
+    return journal_;
+}
+
+/* ------------------------ GameSnapshot ----------------------------------- */
+
+const GameSnapshot::SessionView* GameSnapshot::FindSession(const Token& token) const{
+    const GameSession* const* session = tokens_->Find(token);
+    if(!session){
+        return nullptr;
+    }
+    auto session_it = sessions_.find(*session);
+    return session_it != sessions_.end() ? &session_it->second : nullptr;
+}
+
+/* ------------------------ Application ----------------------------------- */
+
+void Application::PublishSnapshot(){
+    std::shared_ptr<const GameSnapshot> previous = std::atomic_load_explicit(&snapshot_, std::memory_order_relaxed);
+    const bool players_changed = !previous || previous->GetTokensRevision() != tokens_.GetRevision();
+
+    std::shared_ptr<const GameSnapshot::TokenToSession> token_to_session;
+    if(players_changed){
+        auto new_tokens = std::make_shared<GameSnapshot::TokenToSession>();
+        new_tokens->Reserve(tokens_.GetAllTokens().size());
+        tokens_.GetAllTokens().ForEach([&new_tokens](const Token& token, const Player* player){
+            new_tokens->Emplace(token, player->GetSession());
+        });
+        token_to_session = std::move(new_tokens);
+    } else {
+        token_to_session = previous->GetTokens();
+    }
+
+    GameSnapshot::SessionViews sessions;
+    sessions.reserve(tokens_.GetAllSessions().size());
+    for(const auto& [session, players] : tokens_.GetAllSessions()){
+        GameSnapshot::SessionView view;
+        view.state = game_handler_.GetSessionState(session);
+        if(!players_changed){
+            view.players = previous->GetSessions().at(session).players;
+        } else {
+            view.players = std::make_shared<const std::string>(ListPlayersUseCase::GetPlayersInJSON(players));
+        }
+        sessions.emplace(session, std::move(view));
     }
+
+    std::atomic_store_explicit(&snapshot_, 
+        std::shared_ptr<const GameSnapshot>(std::make_shared<const GameSnapshot>(std::move(token_to_session), 
+                                                                                tokens_.GetRevision(), std::move(sessions))), 
+        std::memory_order_release);
+    /* Читатель, увидевший сброшенный флаг, увидит и новый снимок */
+    snapshot_stale_.store(false, std::memory_order_release);
 }
 
-}; //namespace app
\ No newline at end of file
+}; //namespace app
@@ -9,9 +9,21 @@
 #include <optional>
 #include <functional>
 #include <fstream>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <vector>
 #include "player.h"
 #include "model_serialization.h"
+#include "state_writer.h"
+#include "action_journal.h"
 #include "connection_pool.h"
+#include "leaderboard.h"
+#include "compression.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "tracing.h"
 
 namespace app{
 
@@ -23,6 +35,8 @@ using Clock = std::chrono::steady_clock;
 using namespace model::detail;
 using namespace model;
 using DatabaseManagerPtr = std::unique_ptr<db_connection::DatabaseManager>;
+/* Неизменяемый сериализованный ответ, который можно отдавать многим клиентам */
+using SharedBuffer = std::shared_ptr<const std::string>;
 
 namespace detail{
 
@@ -54,6 +68,56 @@ private:
     Clock::time_point last_tick_;
 };
 
+/* ------------------------ GameMetrics ----------------------------------- */
+
+/* Метрики игрового цикла: длительность фаз тика и число игроков, сессий и предметов на картах */
+class GameMetrics{
+public:
+    enum class Phase{
+        UPDATE,
+        SAVE,
+        SNAPSHOT,
+        BROADCAST,
+        LOOT
+    };
+
+    GameMetrics();
+
+    static std::string_view GetPhaseName(Phase phase);
+
+    metrics::Histogram& GetTickDuration(){
+        return tick_duration_;
+    }
+
+    metrics::Histogram& GetPhaseDuration(Phase phase){
+        return *phase_durations_[static_cast<size_t>(phase)];
+    }
+
+    /* Пересчитывает показатели по картам. Вызывается в strand после изменения состава игры */
+    void UpdateGameSize(const Game& game);
+
+private:
+    metrics::Histogram& tick_duration_;
+    std::array<metrics::Histogram*, 5> phase_durations_;
+    metrics::Family<metrics::Gauge>& players_;
+    metrics::Family<metrics::Gauge>& sessions_;
+    metrics::Family<metrics::Gauge>& loot_objects_;
+    metrics::Family<metrics::Gauge>& loot_in_bags_;
+};
+
+/* Фаза тика: её длительность попадает в метрики и, если трасса включена, в трассу */
+class TickPhase{
+public:
+    TickPhase(GameMetrics& metrics, GameMetrics::Phase phase)
+        : timer_(metrics.GetPhaseDuration(phase))
+        , span_(GameMetrics::GetPhaseName(phase), "tick"){
+    }
+
+private:
+    metrics::ScopedTimer timer_;
+    tracing::Span span_;
+};
+
 /* ------------------------ PlayerTimeClock ----------------------------------- */
 
 /* Класс для отслеживания за бездействием игрока и его игровым временем*/
@@ -105,34 +169,95 @@ class GameUseCase{
 public:
     using PlayerTimeClocks = std::unordered_map<const Player*, detail::PlayerTimeClock>;
     
+    /* Без db_manager рекорды хранятся только в памяти (так работают бенчмарки) */
     GameUseCase(Players& players, PlayerTokens& tokens, DatabaseManagerPtr&& db_manager)
-        : players_(players), tokens_(tokens), db_manager_(std::move(db_manager)){}
+        : players_(players), tokens_(tokens), db_manager_(std::move(db_manager)){
+            LoadLeaderboard();
+        }
 
     std::string JoinGame(const std::string& user_name, const std::string& str_map_id, 
                             Game& game, bool is_random_spawn_enabled);
 
-    std::string GetGameState(const Token& token) const;
+    /* 
+        Состояние сессии сериализуется один раз на каждую версию сессии
+        и дальше отдаётся всем игрокам сессии из кэша
+    */
+    SharedBuffer GetGameState(const Token& token) const;
 
-    std::string SetAction(const json::object& action, const Token& token);
+    SharedBuffer GetSessionState(const GameSession* session) const;
+
+    /*
+        Изменения состояния сессии, сделанные начиная с тика since:
+        добавленные и изменённые собаки и предметы целиком,
+        а удалённые - списками идентификаторов.
+        Если журнал сессии уже не хранит тик since, возвращается полное состояние.
+        Ответ всегда содержит номер текущего тика сессии
+    */
+    SharedBuffer GetGameStateDelta(const Player* player, uint64_t since) const;
+
+    /* move - направление "U", "D", "L", "R" или пустая строка для остановки */
+    std::string SetAction(Player* player, std::string_view move);
 
     std::string IncreaseTime(unsigned delta, Game& game);
 
-    static void GenerateLoot(Milliseconds delta, Game& game);
+    void GenerateLoot(Milliseconds delta, Game& game);
+
+    /* 
+        Повторяет действие из журнала. В отличие от обычных методов,
+        ничего не выбирает случайно и не пишет в журнал
+    */
+    void Replay(const serialization::JournalRecord& record, Game& game);
+
+    /* Новые игроки получат идентификаторы больше id */
+    void ReservePlayerId(int id);
+
+    /* Журнал, в который записываются действия. nullptr - не записывать */
+    void SetJournal(serialization::ActionJournal* journal);
 
-    std::string GetRecords(unsigned start, unsigned max_items);
+    /* Рекорды отдаются из таблицы в памяти, база данных только пополняется */
+    std::string GetRecords(unsigned start, unsigned max_items) const;
+
+    /* ETag страницы рекордов: совпадает, пока не изменилось содержимое страницы */
+    std::string GetRecordsETag(unsigned start, unsigned max_items) const;
 private:
-    static json::array GetBagItems(const Dog::Bag& bag_items);
-    json::object GetPlayers(const PlayerTokens::PlayersInSession& players_in_session) const;
-    static json::object GetLostObjects(const std::list<Loot>& loots);
+    void LoadLeaderboard();
+    /* Ответы пишутся сразу в текст, без промежуточного json::value */
+    static void WriteBagItems(util::JsonWriter& writer, const Dog::Bag& bag_items);
+    static void WritePlayers(util::JsonWriter& writer, const PlayerTokens::PlayersInSession& players_in_session);
+    static void WritePlayerAttributes(util::JsonWriter& writer, const Player* player);
+    static void WriteLostObjects(util::JsonWriter& writer, const GameSession::LootObjects& loots);
+    static void WriteLootDescription(util::JsonWriter& writer, const Loot& loot);
     void AddPlayerTimeClock(Player* player);
-    void SaveScore(const Player* player, Game& game);
+    serialization::RetireRecord MakeRetireRecord(const Player* player, const Game& game) const;
+    void SaveScore(const serialization::RetireRecord& record);
     void DisconnectPlayer(const Player* player, Game& game);
+    void SetMove(Player* player, std::string_view dir);
+    static GameSession* FindOrAddSession(const Map::Id& map_id, Game& game);
+    Player& AddPlayer(int id, const std::string& user_name, GameSession* session, const Dog::Position& pos);
+    /* Записывает в журнал предметы сессии, созданные после предмета last_loot_id */
+    void JournalNewLoot(const GameSession& session, unsigned last_loot_id);
+    void ReplayRecord(const serialization::JoinRecord& record, Game& game);
+    void ReplayRecord(const serialization::LootRecord& record, Game& game);
+    void ReplayRecord(const serialization::ActionRecord& record, Game& game);
+    void ReplayRecord(const serialization::TickRecord& record, Game& game);
+    void ReplayRecord(const serialization::RetireRecord& record, Game& game);
+
+    struct StateSnapshot{
+        uint64_t revision = 0;
+        SharedBuffer body;
+    };
+    using StateSnapshots = std::unordered_map<const GameSession*, StateSnapshot>;
 
     int auto_counter_ = 0;
+    mutable StateSnapshots state_snapshots_;
     Players& players_;
     PlayerTokens& tokens_;
     PlayerTimeClocks clocks_;
     DatabaseManagerPtr db_manager_;
+    Leaderboard leaderboard_;
+    /* Уходы игроков, уже записанные в базу данных к запуску сервера */
+    std::unordered_set<Token, TokenHasher> saved_retirements_;
+    serialization::ActionJournal* journal_ = nullptr;
 };
 
 /* ------------------------ ListPlayersUseCase ----------------------------------- */
@@ -154,20 +279,106 @@ public:
     save_state_period_(period),
     sessions_(sessions),
     players_(players),
-    last_tick_(Clock::now()){}
+    last_tick_(Clock::now()),
+    writer_(state_file),
+    journal_(state_file + ".journal"){}
 
     void SaveOnTick(bool is_periodic);
 
+    /* 
+        Копирует состояние и передаёт его фоновому потоку записи.
+        Тик игры ждёт только копирования, но не записи на диск.
+        Журнал действий переходит на новый сегмент, а прежние сегменты
+        удаляются, когда снимок окажется на диске
+    */
     void SaveState();
 
+    /* Дожидается записи всех снимков на диск */
+    void WaitSaved();
+
+    serialization::StateSaveStats GetSaveStats() const;
+
     serialization::GameStateRepr LoadState();
 
+    /* 
+        Повторяет действия, записанные в журнал после снимка state,
+        и удаляет сегменты журнала, которые уже вошли в снимок
+    */
+    void ReplayJournal(const serialization::GameStateRepr& state, 
+                        const std::function<void(const serialization::JournalRecord&)>& action);
+
+    serialization::ActionJournal& GetJournal();
+
 private:
     Clock::time_point last_tick_;
     std::string state_file_;
     std::optional<unsigned> save_state_period_; 
     const Game::SessionsByMapId& sessions_;
     const Players& players_;
+    serialization::StateWriter writer_;
+    serialization::ActionJournal journal_;
+};
+
+/* ------------------------ StateSubscriber ----------------------------------- */
+
+/* Подписчик, которому после каждого тика отправляется состояние сессии его игрока */
+struct StateSubscriber{
+    Token token;
+    /* Отправляет состояние. Возвращает false, если подписчик больше не принимает состояние */
+    std::function<bool(SharedBuffer state)> push;
+    /* Вызывается, когда игрок подписчика покинул игру */
+    std::function<void()> close;
+};
+
+/* ------------------------ PlayerAction ----------------------------------- */
+
+/* Действие игрока из пакетного запроса. move ссылается на тело запроса */
+struct PlayerAction{
+    Player* player;
+    std::string_view move;
+};
+
+/* ------------------------ GameSnapshot ----------------------------------- */
+
+/*
+    Неизменяемый снимок данных, нужных эндпоинтам чтения.
+    Публикуется после каждого изменения игры и читается из любых потоков
+    без участия strand: читатель, получивший снимок, держит его, 
+    пока не закончит работу с ним
+*/
+class GameSnapshot{
+public:
+    struct SessionView{
+        /* Тело ответа /api/v1/game/state */
+        SharedBuffer state;
+        /* Тело ответа /api/v1/game/players */
+        SharedBuffer players;
+    };
+    using TokenToSession = util::FlatHashMap<Token, const GameSession*, TokenHasher>;
+    using SessionViews = std::unordered_map<const GameSession*, SessionView>;
+
+    GameSnapshot(std::shared_ptr<const TokenToSession> tokens, uint64_t tokens_revision, SessionViews sessions)
+        : tokens_(std::move(tokens)), tokens_revision_(tokens_revision), sessions_(std::move(sessions)){
+    }
+
+    /* Сессия игрока с токеном token или nullptr, если игрок не найден */
+    const SessionView* FindSession(const Token& token) const;
+
+    const std::shared_ptr<const TokenToSession>& GetTokens() const{
+        return tokens_;
+    }
+
+    uint64_t GetTokensRevision() const{
+        return tokens_revision_;
+    }
+
+    const SessionViews& GetSessions() const{
+        return sessions_;
+    }
+private:
+    std::shared_ptr<const TokenToSession> tokens_;
+    uint64_t tokens_revision_;
+    SessionViews sessions_;
 };
 
 /* --------------------------- Application -------------------------------- */
@@ -187,7 +398,12 @@ public:
         api_strand_(api_strand),
         tick_period_(tick_period), 
         rand_spawn_(randomize_spawn_points), players_(), tokens_(), 
-        game_handler_(players_, tokens_, std::move(db_manager)), time_ticker_(), loot_ticker_(){
+        game_handler_(players_, tokens_, std::move(db_manager)), time_ticker_(), loot_ticker_(),
+        maps_list_(ListMapsUseCase::MakeMapsList(game_.GetMaps())){
+            for(const Map& map : game_.GetMaps()){
+                map_descriptions_.emplace(map.GetId(), compression::EncodedBody(GetMapUseCase::MakeMapDescription(&map)));
+            }
+
             /* Перед началом работы приложения всегда генерируется начальный лут*/
             GenerateLoot(Milliseconds{0});
 
@@ -213,49 +429,96 @@ public:
 
             if(state_file.has_value()){
                 state_save_.emplace(state_file.value(), save_state_period, game_.GetAllSessions(), players_);
+                game_handler_.SetJournal(&state_save_->GetJournal());
             }
         }
     Strand& GetStrand(){
         return api_strand_;
     }
 
-    std::string GetMapsList() const{
-        return ListMapsUseCase::MakeMapsList(game_.GetMaps());
+    /* Список карт сериализуется и сжимается один раз при запуске: карты не меняются во время работы */
+    const compression::EncodedBody& GetMapsList() const{
+        return maps_list_;
     }
 
     const Map* FindMap(const Map::Id& map_id) const{
         return game_.FindMap(map_id);
     }
 
+    /* Игрок с токеном token или nullptr. Указатель действителен только в strand */
+    Player* FindPlayerByToken(const Token& token){
+        return tokens_.FindPlayerByToken(token);
+    }
+
     const Player* FindPlayerByToken(const Token& token) const{
         return tokens_.FindPlayerByToken(token);
     }
 
+    /* 
+        Последний опубликованный снимок игры. 
+        В отличие от остальных методов, можно вызывать из любого потока
+    */
+    std::shared_ptr<const GameSnapshot> GetSnapshot() const{
+        return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+    }
+
+    /* 
+        Снимок отстаёт от игры: после действий и входа игроков он не публикуется сразу.
+        Можно вызывать из любого потока
+    */
+    bool IsSnapshotStale() const{
+        return snapshot_stale_.load(std::memory_order_acquire);
+    }
+
+    /* Публикует снимок, если он отстаёт от игры. Вызывается в strand перед чтением снимка */
+    void RefreshSnapshot(){
+        if(snapshot_stale_.load(std::memory_order_relaxed)){
+            PublishSnapshot();
+        }
+    }
+
     bool IsPeriodicMode() const{
         return tick_period_.has_value();
     }
 
-    std::string GetMapDescription(const Map* map) const{
-        return GetMapUseCase::MakeMapDescription(map);
+    /* Описание карты, подготовленное при запуске. nullptr, если карты нет */
+    const compression::EncodedBody* GetMapDescription(const Map::Id& map_id) const{
+        auto it = map_descriptions_.find(map_id);
+        return it != map_descriptions_.end() ? &it->second : nullptr;
     }
 
     std::string GetJoinGameResult(const std::string& user_name, const std::string& map_id){
-        return game_handler_.JoinGame(user_name, map_id, game_, rand_spawn_);
+        std::string res = game_handler_.JoinGame(user_name, map_id, game_, rand_spawn_);
+        MarkSnapshotStale();
+        game_metrics_.UpdateGameSize(game_);
+        return res;
     }
 
-    std::string GetPlayerList(const Token& token) const{
-        const GameSession* session = tokens_.FindPlayerByToken(token)->GetSession();
-        PlayerTokens::PlayersInSession players = tokens_.GetPlayersBySession(session);
-        return ListPlayersUseCase::GetPlayersInJSON(players);
+    SharedBuffer GetGameStateDelta(const Player* player, uint64_t since) const{
+        return game_handler_.GetGameStateDelta(player, since);
     }
 
-    std::string GetGameState(const Token& token) const{
-        return game_handler_.GetGameState(token);
+    /* 
+        Подписывает на состояние сессии игрока с токеном subscriber.token
+        и сразу отправляет ему текущее состояние.
+        Возвращает false, если игрок не найден
+    */
+    bool SubscribeToState(StateSubscriber subscriber){
+        const Player* player = tokens_.FindPlayerByToken(subscriber.token);
+        if(!player){
+            return false;
+        }
+        if(subscriber.push(game_handler_.GetSessionState(player->GetSession()))){
+            subscribers_.push_back(std::move(subscriber));
+        }
+        return true;
     }
 
+    /* Сохраняет состояние и дожидается записи на диск, например при остановке сервера */
     void SaveState(){
         if(state_save_.has_value()){
             state_save_.value().SaveState();
+            state_save_.value().WaitSaved();
         }
     }
 
@@ -269,46 +532,124 @@ public:
                     session->SetLootObjects(session_repr.GetLoot());
                     for(const auto& dog_repr : session_repr.GetDogsRepr()){
                         /* Добавление собаки */
-                        Dog* created_dog = session->AddCreatedDog(dog_repr.Restore());
+                        GameSession::DogHandle created_dog = session->AddCreatedDog(dog_repr.Restore());
                         const auto& player_repr = dog_repr.GetPlayerRepr();
                         /* Добавление игрока */
                         Player& added_player = players_.Add(player_repr.GetId(), 
                                     Player::Name(player_repr.GetName()),
                                     created_dog,
                                     session);
-                        tokens_.AddPlayerWithToken(added_player, Token(player_repr.GetToken()));
+                        tokens_.AddPlayerWithToken(added_player, Token::Parse(player_repr.GetToken()));
                         tokens_.AddPlayerInSession(added_player, session);
+                        game_handler_.ReservePlayerId(player_repr.GetId());
                     }
                 }
             }
+            /* Действия, сделанные после снимка, восстанавливаются из журнала */
+            state_save_.value().ReplayJournal(game_state, [this](const serialization::JournalRecord& record){
+                game_handler_.Replay(record, game_);
+            });
+            PublishSnapshot();
+            game_metrics_.UpdateGameSize(game_);
         }
     }
 
     std::string IncreaseTime(unsigned delta){
-        std::string res =  game_handler_.IncreaseTime(delta, game_);
+        using Phase = detail::GameMetrics::Phase;
+        metrics::ScopedTimer tick_timer(game_metrics_.GetTickDuration());
+        tracing::Span tick_span("tick", "tick");
+        std::string res;
+        {
+            detail::TickPhase phase(game_metrics_, Phase::UPDATE);
+            res = game_handler_.IncreaseTime(delta, game_);
+        }
         /* 
             Сохраняем игровое состояние 
             синхроннно с ходом игровых часов только в том случае, 
             когда указан файл сохранения и период
         */
         if(state_save_.has_value()){
+            detail::TickPhase phase(game_metrics_, Phase::SAVE);
             state_save_.value().SaveOnTick(tick_period_.has_value());
         }
+        {
+            detail::TickPhase phase(game_metrics_, Phase::SNAPSHOT);
+            PublishSnapshot();
+        }
+        {
+            detail::TickPhase phase(game_metrics_, Phase::BROADCAST);
+            PublishState();
+        }
+        game_metrics_.UpdateGameSize(game_);
         return res;
     }
 
     void GenerateLoot(Milliseconds delta){
-        return game_handler_.GenerateLoot(delta, game_);
+        using Phase = detail::GameMetrics::Phase;
+        {
+            detail::TickPhase phase(game_metrics_, Phase::LOOT);
+            game_handler_.GenerateLoot(delta, game_);
+        }
+        {
+            detail::TickPhase phase(game_metrics_, Phase::SNAPSHOT);
+            PublishSnapshot();
+        }
+        game_metrics_.UpdateGameSize(game_);
+    }
+
+    std::string ApplyPlayerAction(Player* player, std::string_view move){
+        std::string res = game_handler_.SetAction(player, move);
+        MarkSnapshotStale();
+        return res;
     }
 
-    std::string ApplyPlayerAction(const json::object& action, const Token& token){
-        return game_handler_.SetAction(action, token);
+    void ApplyPlayerActions(const std::vector<PlayerAction>& actions){
+        for(const PlayerAction& action : actions){
+            game_handler_.SetAction(action.player, action.move);
+        }
+        MarkSnapshotStale();
     }
 
-    std::string GetRecords(unsigned start, unsigned max_items){
+    std::string GetRecords(unsigned start, unsigned max_items) const{
         return game_handler_.GetRecords(start, max_items);
     }
+
+    std::string GetRecordsETag(unsigned start, unsigned max_items) const{
+        return game_handler_.GetRecordsETag(start, max_items);
+    }
 private:
+    /* 
+        Снимок публикуется на каждом тике, а после действий игроков только помечается устаревшим:
+        иначе каждое нажатие клавиши сериализовало бы всю сессию. 
+        Чтение устаревшего снимка уходит в strand и публикует его один раз на серию действий
+    */
+    void MarkSnapshotStale(){
+        snapshot_stale_.store(true, std::memory_order_release);
+    }
+
+    /* 
+        Публикует новый снимок игры. Вызывается в strand.
+        Неизменившиеся части переиспользуются из предыдущего снимка: 
+        состояние сессии сериализуется заново, только если изменилась её версия,
+        а таблица токенов и списки игроков - только если изменился состав игроков
+    */
+    void PublishSnapshot();
+
+    /* 
+        Рассылает подписчикам состояние их сессий. 
+        Состояние сессии сериализуется один раз и разделяется всеми её подписчиками
+    */
+    void PublishState(){
+        std::erase_if(subscribers_, [this](const StateSubscriber& subscriber){
+            const Player* player = tokens_.FindPlayerByToken(subscriber.token);
+            if(!player){
+                subscriber.close();
+                return true;
+            }
+            return !subscriber.push(game_handler_.GetSessionState(player->GetSession()));
+        });
+    }
+
     Game& game_;
     Strand api_strand_;
     std::optional<unsigned> tick_period_;
@@ -319,6 +660,16 @@ private:
     GameUseCase game_handler_;
     std::shared_ptr<detail::Ticker> time_ticker_;
     std::shared_ptr<detail::Ticker> loot_ticker_;
+    const compression::EncodedBody maps_list_;
+    std::unordered_map<Map::Id, compression::EncodedBody, Game::MapIdHasher> map_descriptions_;
+    std::vector<StateSubscriber> subscribers_;
+    /* 
+        Читается и заменяется через std::atomic_load_explicit/std::atomic_store_explicit:
+        специализации std::atomic<std::shared_ptr> нет в libstdc++ до GCC 12
+    */
+    std::shared_ptr<const GameSnapshot> snapshot_;
+    std::atomic_bool snapshot_stale_ = false;
+    detail::GameMetrics game_metrics_;
 };
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "async_logger.h"
+#include <charconv>
+#include <ctime>
+
+namespace logger{
+
+using namespace std::literals;
+
+namespace {
+
+AsyncLogger* async_logger = nullptr;
+
+size_t RoundUpToPowerOfTwo(size_t value){
+    size_t result = 1;
+    while(result < value){
+        result <<= 1;
+    }
+    return result;
+}
+
+template <typename Number>
+void AppendNumber(std::string& out, Number number){
+    std::array<char, 32> buffer;
+    auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+    out.append(buffer.data(), ptr);
+}
+
+void AppendPadded(std::string& out, unsigned number, int width){
+    std::array<char, 16> buffer;
+    auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+    out.append(width - (ptr - buffer.data()), '0');
+    out.append(buffer.data(), ptr);
+}
+
+void AppendString(std::string& out, std::string_view str){
+    static constexpr char HEX[] = "0123456789abcdef";
+    out.push_back('"');
+    for(char c : str){
+        switch(c){
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20){
+                    out.append("\\u00");
+                    out.push_back(HEX[(c >> 4) & 0xF]);
+                    out.push_back(HEX[c & 0xF]);
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+/* Локальное время в формате ISO 8601 с микросекундами, как у Boost.Log */
+void AppendTimestamp(std::string& out, std::chrono::system_clock::time_point timestamp){
+    using namespace std::chrono;
+    const time_t seconds = system_clock::to_time_t(timestamp);
+    const auto micros = duration_cast<microseconds>(timestamp.time_since_epoch()).count() % 1'000'000;
+    std::tm local{};
+    localtime_r(&seconds, &local);
+
+    out.push_back('"');
+    AppendPadded(out, local.tm_year + 1900, 4);
+    out.push_back('-');
+    AppendPadded(out, local.tm_mon + 1, 2);
+    out.push_back('-');
+    AppendPadded(out, local.tm_mday, 2);
+    out.push_back('T');
+    AppendPadded(out, local.tm_hour, 2);
+    out.push_back(':');
+    AppendPadded(out, local.tm_min, 2);
+    out.push_back(':');
+    AppendPadded(out, local.tm_sec, 2);
+    out.push_back('.');
+    AppendPadded(out, static_cast<unsigned>(micros < 0 ? micros + 1'000'000 : micros), 6);
+    out.push_back('"');
+}
+
+}  // namespace
+
+/* ------------------------ RecordRing ----------------------------------- */
+
+RecordRing::RecordRing(size_t capacity)
+    : records_(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)))
+    , mask_(records_.size() - 1){
+}
+
+bool RecordRing::TryPush(const RequestLogRecord& record){
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if(head - tail_.load(std::memory_order_acquire) == records_.size()){
+        return false;
+    }
+    records_[head & mask_] = record;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool RecordRing::TryPop(RequestLogRecord& record){
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if(tail == head_.load(std::memory_order_acquire)){
+        return false;
+    }
+    record = records_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/* ------------------------ AsyncLogger ----------------------------------- */
+
+AsyncLogger::AsyncLogger(const AsyncLogOptions& options, BatchWriter write)
+    : options_(options)
+    , write_(std::move(write))
+    , dropped_records_(metrics::GetRegistry().AddCounter(
+        "log_records_dropped_total"s, "Request log records dropped because a thread buffer was full"s).WithLabels({}))
+    , worker_([this]{ Run(); }){
+}
+
+AsyncLogger::~AsyncLogger(){
+    stop_ = true;
+    worker_.join();
+}
+
+bool AsyncLogger::ShouldSample(){
+    if(options_.sample_rate >= 1.0){
+        return true;
+    }
+    /* Детерминированная выборка: в каждом потоке логируется доля sample_rate запросов */
+    thread_local double credit = 0;
+    credit += options_.sample_rate;
+    if(credit >= 1.0){
+        credit -= 1.0;
+        return true;
+    }
+    return false;
+}
+
+void AsyncLogger::Push(const RequestLogRecord& record){
+    RecordRing& ring = GetThreadRing();
+    while(!ring.TryPush(record)){
+        if(options_.overflow_policy == OverflowPolicy::DROP || stop_){
+            dropped_records_.Increment();
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+RecordRing& AsyncLogger::GetThreadRing(){
+    /* Буфер создаётся при первой записи из потока, дальше поток обращается к нему без блокировок */
+    struct ThreadRing{
+        const AsyncLogger* owner = nullptr;
+        RecordRing* ring = nullptr;
+    };
+    thread_local ThreadRing thread_ring;
+
+    if(thread_ring.owner != this){
+        auto ring = std::make_unique<RecordRing>(options_.buffer_capacity);
+        std::lock_guard lock(rings_mutex_);
+        thread_ring = {this, ring.get()};
+        rings_.push_back(std::move(ring));
+    }
+    return *thread_ring.ring;
+}
+
+void AsyncLogger::Run(){
+    std::string batch;
+    while(true){
+        /* Флаг читается до опустошения буферов, чтобы после остановки не потерять записи */
+        const bool stopping = stop_;
+        batch.clear();
+        const size_t count = Drain(batch);
+        if(count != 0){
+            write_(batch);
+        } else if(stopping){
+            return;
+        } else {
+            std::this_thread::sleep_for(options_.flush_period);
+        }
+    }
+}
+
+size_t AsyncLogger::Drain(std::string& batch){
+    std::vector<RecordRing*> rings;
+    {
+        std::lock_guard lock(rings_mutex_);
+        rings.reserve(rings_.size());
+        for(const auto& ring : rings_){
+            rings.push_back(ring.get());
+        }
+    }
+
+    size_t count = 0;
+    RequestLogRecord record;
+    for(RecordRing* ring : rings){
+        while(ring->TryPop(record)){
+            FormatRecord(record, batch);
+            batch.push_back('\n');
+            ++count;
+        }
+    }
+    return count;
+}
+
+/* ------------------------ AsyncLogging ----------------------------------- */
+
+AsyncLogging::AsyncLogging(const AsyncLogOptions& options, BatchWriter write)
+    : logger_(options, std::move(write)){
+    async_logger = &logger_;
+}
+
+AsyncLogging::~AsyncLogging(){
+    async_logger = nullptr;
+}
+
+AsyncLogger* GetAsyncLogger(){
+    return async_logger;
+}
+
+void FormatRecord(const RequestLogRecord& record, std::string& out){
+    out.append("{\"timestamp\":");
+    AppendTimestamp(out, record.timestamp);
+    out.append(",\"data\":{\"ip\":");
+    AppendString(out, record.ip.to_string());
+    switch(record.kind){
+        case RequestLogRecord::Kind::REQUEST_RECEIVED:
+            out.append(",\"URL\":");
+            AppendString(out, record.url.View());
+            out.append(",\"method\":");
+            AppendString(out, record.method.View());
+            out.append("},\"message\":\"request received\"}");
+            break;
+        case RequestLogRecord::Kind::RESPONSE_SENT:
+            out.append(",\"response_time\":");
+            AppendNumber(out, record.response_time);
+            out.append(",\"code\":");
+            AppendNumber(out, record.code);
+            out.append(",\"content_type\":");
+            AppendString(out, record.content_type.View());
+            out.append("},\"message\":\"response sent\"}");
+            break;
+    }
+}
+
+}; // namespace logger
@@ -0,0 +1,152 @@
+#pragma once
+#include <boost/asio/ip/address.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "metrics.h"
+
+namespace logger{
+
+/* Что делать с записью, если буфер потока переполнен */
+enum class OverflowPolicy{
+    /* Отбросить запись и увеличить счётчик log_records_dropped_total в /metrics */
+    DROP,
+    /* Дождаться, пока фоновый поток освободит место */
+    BLOCK
+};
+
+struct AsyncLogOptions{
+    /* Доля запросов, которые попадают в журнал: 1 - все, 0.1 - каждый десятый */
+    double sample_rate = 1.0;
+    OverflowPolicy overflow_policy = OverflowPolicy::DROP;
+    /* Число записей в буфере каждого потока, округляется вверх до степени двойки */
+    size_t buffer_capacity = 4096;
+    /* Как часто фоновый поток забирает записи, если буферы пусты */
+    std::chrono::milliseconds flush_period{10};
+};
+
+/* Строка фиксированной длины: длинные значения обрезаются */
+template <size_t Capacity>
+class FixedString{
+public:
+    void Assign(std::string_view str){
+        size_ = std::min(str.size(), Capacity);
+        std::copy_n(str.data(), size_, data_.data());
+    }
+
+    std::string_view View() const{
+        return {data_.data(), size_};
+    }
+private:
+    std::array<char, Capacity> data_;
+    size_t size_ = 0;
+};
+
+/*
+    Запись о запросе или ответе фиксированного размера.
+    Поля хранятся в двоичном виде, а в JSON превращаются в фоновом потоке
+*/
+struct RequestLogRecord{
+    enum class Kind : uint8_t{
+        REQUEST_RECEIVED,
+        RESPONSE_SENT
+    };
+
+    Kind kind;
+    std::chrono::system_clock::time_point timestamp;
+    boost::asio::ip::address ip;
+    /* Для REQUEST_RECEIVED */
+    FixedString<256> url;
+    FixedString<16> method;
+    /* Для RESPONSE_SENT */
+    size_t response_time = 0;
+    int code = 0;
+    FixedString<64> content_type;
+};
+
+/*
+    Кольцевой буфер с одним писателем и одним читателем.
+    Писатель - поток, которому принадлежит буфер, читатель - фоновый поток логгера
+*/
+class RecordRing{
+public:
+    explicit RecordRing(size_t capacity);
+
+    bool TryPush(const RequestLogRecord& record);
+
+    bool TryPop(RequestLogRecord& record);
+private:
+    std::vector<RequestLogRecord> records_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+};
+
+/* Выводит пачку готовых строк журнала. Вызывается только из фонового потока логгера */
+using BatchWriter = std::function<void(std::string_view batch)>;
+
+/*
+    Асинхронный журнал запросов.
+    Потоки ввода-вывода пишут записи в собственные кольцевые буферы без блокировок,
+    а фоновый поток форматирует их в JSON и отдаёт пачками в write
+*/
+class AsyncLogger{
+public:
+    AsyncLogger(const AsyncLogOptions& options, BatchWriter write);
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    /* Дописывает все оставшиеся записи и останавливает фоновый поток */
+    ~AsyncLogger();
+
+    /*
+        Решает, попадёт ли очередной запрос в журнал.
+        Запрос и ответ на него логируются вместе, поэтому решение принимается один раз на запрос
+    */
+    bool ShouldSample();
+
+    void Push(const RequestLogRecord& record);
+private:
+    RecordRing& GetThreadRing();
+
+    void Run();
+
+    /* Забирает записи из всех буферов и возвращает их число */
+    size_t Drain(std::string& batch);
+
+    AsyncLogOptions options_;
+    BatchWriter write_;
+    std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<RecordRing>> rings_;
+    metrics::Counter& dropped_records_;
+    std::atomic_bool stop_ = false;
+    std::thread worker_;
+};
+
+/* Включает асинхронный журнал запросов на время жизни объекта */
+class AsyncLogging{
+public:
+    AsyncLogging(const AsyncLogOptions& options, BatchWriter write);
+
+    ~AsyncLogging();
+private:
+    AsyncLogger logger_;
+};
+
+/* Асинхронный журнал, если он включён, иначе nullptr */
+AsyncLogger* GetAsyncLogger();
+
+/* Формирует JSON-строку записи в том же формате, что и синхронный журнал */
+void FormatRecord(const RequestLogRecord& record, std::string& out);
+
+}; // namespace logger
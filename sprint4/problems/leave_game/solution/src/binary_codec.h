@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace util {
+
+/*
+    Простейшее двоичное кодирование для файлов, которые читает тот же сервер:
+    числа записываются как есть, в порядке байтов машины,
+    строки - длиной uint32_t и байтами строки
+*/
+class BinaryWriter{
+public:
+    explicit BinaryWriter(std::string& out)
+        : out_(out){
+    }
+
+    template <typename Number>
+        requires std::is_arithmetic_v<Number>
+    void Put(Number number){
+        out_.append(reinterpret_cast<const char*>(&number), sizeof(number));
+    }
+
+    void Put(std::string_view str){
+        Put(static_cast<uint32_t>(str.size()));
+        out_.append(str);
+    }
+
+private:
+    std::string& out_;
+};
+
+/* Читает данные BinaryWriter. Каждый Get возвращает false, если данных не хватило */
+class BinaryReader{
+public:
+    explicit BinaryReader(std::string_view in)
+        : in_(in){
+    }
+
+    template <typename Number>
+        requires std::is_arithmetic_v<Number>
+    bool Get(Number& number){
+        if(in_.size() < sizeof(number)){
+            return false;
+        }
+        std::memcpy(&number, in_.data(), sizeof(number));
+        in_.remove_prefix(sizeof(number));
+        return true;
+    }
+
+    bool Get(std::string& str){
+        uint32_t size;
+        if(!Get(size) || in_.size() < size){
+            return false;
+        }
+        str.assign(in_.substr(0, size));
+        in_.remove_prefix(size);
+        return true;
+    }
+
+    bool IsEmpty() const{
+        return in_.empty();
+    }
+
+private:
+    std::string_view in_;
+};
+
+}  // namespace util
@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+namespace model {
+
+/*
+    Ограниченный журнал изменений игровой сессии.
+
+    Хранит, какие собаки и потерянные объекты были добавлены, изменены
+    или удалены на каждом тике. Записи старше окна в window_ticks тиков
+    и записи сверх max_entries отбрасываются. GetFirstTick() сообщает,
+    начиная с какого тика журнал содержит все изменения:
+    для более старых тиков нужно отдавать полное состояние.
+*/
+class ChangeJournal {
+public:
+    enum class Object {
+        DOG,
+        LOOT
+    };
+
+    enum class Change {
+        /* Объект добавлен или изменён */
+        UPSERT,
+        REMOVE
+    };
+
+    struct Entry {
+        uint64_t tick;
+        Object object;
+        Change change;
+        uint64_t id;
+    };
+
+    static constexpr uint64_t DEFAULT_WINDOW_TICKS = 200;
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1 << 16;
+
+    explicit ChangeJournal(uint64_t window_ticks = DEFAULT_WINDOW_TICKS, 
+                            size_t max_entries = DEFAULT_MAX_ENTRIES)
+        : window_ticks_(window_ticks), max_entries_(max_entries){
+    }
+
+    void Record(uint64_t tick, Object object, Change change, uint64_t id){
+        entries_.push_back({tick, object, change, id});
+        while(entries_.size() > max_entries_){
+            DropFront();
+        }
+    }
+
+    /* Отбрасывает записи, вышедшие за окно относительно текущего тика */
+    void Trim(uint64_t current_tick){
+        if(current_tick <= window_ticks_){
+            return;
+        }
+        const uint64_t window_start = current_tick - window_ticks_;
+        while(!entries_.empty() && entries_.front().tick < window_start){
+            DropFront();
+        }
+        first_tick_ = std::max(first_tick_, window_start);
+    }
+
+    uint64_t GetFirstTick() const{
+        return first_tick_;
+    }
+
+    bool Covers(uint64_t since) const{
+        return since >= first_tick_;
+    }
+
+    /* Вызывает action для всех записей, сделанных на тике since и позже, в порядке записи */
+    template <typename Action>
+    void ForEachSince(uint64_t since, Action&& action) const{
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), since, [](const Entry& entry, uint64_t tick){
+            return entry.tick < tick;
+        });
+        for(; it != entries_.end(); ++it){
+            action(*it);
+        }
+    }
+
+private:
+    void DropFront(){
+        first_tick_ = std::max(first_tick_, entries_.front().tick + 1);
+        entries_.pop_front();
+    }
+
+    uint64_t window_ticks_;
+    size_t max_entries_;
+    uint64_t first_tick_ = 0;
+    std::deque<Entry> entries_;
+};
+
+}  // namespace model
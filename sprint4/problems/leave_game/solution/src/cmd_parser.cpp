@@ -11,6 +11,7 @@ namespace cmd_parser{
     Args args;
     unsigned tick_period;
     std::string state_file;
+    std::string map_cache_file;
     unsigned save_state_period;
 ;
     desc.add_options()
@@ -20,7 +21,15 @@ namespace cmd_parser{
         ("www-root,w", po::value(&args.www_root)->value_name("dir"s), "set static files root")
         ("randomize-spawn-points", "spawn dogs at random positions ")
         ("state-file", po::value(&state_file)->value_name("state-file"s), "set file path, which saves a game state in procces, and restore it at startup")
-        ("save-state-period", po::value(&save_state_period)->value_name("milliseconds"s), "set period for automatic saving of game state.");
+        ("map-cache", po::value(&map_cache_file)->value_name("file"s), "set path of the binary cache of loaded maps (maps are loaded from the config file without a cache by default)")
+        ("save-state-period", po::value(&save_state_period)->value_name("milliseconds"s), "set period for automatic saving of game state.")
+        ("tick-threads", po::value(&args.tick_threads)->value_name("threads"s), "set number of threads updating game sessions on each tick (1 by default)")
+        ("log-sample-rate", po::value(&args.log_sample_rate)->value_name("rate"s), "set share of requests written to the log, from 0 to 1 (1 by default)")
+        ("log-block-on-overflow", "wait for free space in the log buffer instead of dropping records")
+        ("db-batch-size", po::value(&args.db_batch_size)->value_name("rows"s), "set max number of retired players written by one INSERT (100 by default)")
+        ("db-flush-interval", po::value(&args.db_flush_interval)->value_name("milliseconds"s), "set max delay before retired players are written to the database (100 by default)")
+        ("admin-api", "enable /admin/ requests, e.g. /admin/trace/start and /admin/trace/stop")
+        ("trace-file", po::value(&args.trace_file)->value_name("file"s), "set file for the trace written on SIGUSR1 (trace.json by default)");
         
     // variables_map хранит значения опций после разбора
     po::variables_map vm;
@@ -53,10 +62,26 @@ namespace cmd_parser{
         throw std::runtime_error("Static files path is not specified : Usage game_server -c <file> --w <dir>"s);
     }
 
+    if (vm.contains("map-cache"s)) {
+        args.map_cache_file = map_cache_file;
+    }
+
     if (vm.contains("randomize-spawn-points"s)) {
         args.randomize_spawn_points = true;
     }
 
+    if (vm.contains("admin-api"s)) {
+        args.admin_api = true;
+    }
+
+    if (vm.contains("log-block-on-overflow"s)) {
+        args.log_block_on_overflow = true;
+    }
+
+    if (args.log_sample_rate < 0 || args.log_sample_rate > 1) {
+        throw std::runtime_error("Log sample rate must be between 0 and 1"s);
+    }
+
     // С опциями программы всё в порядке, возвращаем структуру args
     return args;
 }
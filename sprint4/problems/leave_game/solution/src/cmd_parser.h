@@ -13,7 +13,15 @@ struct Args {
     std::string www_root;
     bool randomize_spawn_points = false;
     std::optional<std::string> state_file;
+    std::optional<std::string> map_cache_file;
     std::optional<unsigned> save_state_period;
+    unsigned tick_threads = 1;
+    double log_sample_rate = 1.0;
+    bool log_block_on_overflow = false;
+    unsigned db_batch_size = 100;
+    unsigned db_flush_interval = 100;
+    bool admin_api = false;
+    std::string trace_file = "trace.json";
 };
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]);
@@ -1,5 +1,8 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
 
 namespace collision_detector {
 
@@ -22,21 +25,134 @@ CollectionResult TryCollectPoint(Point2D a, Point2D b, Point2D c) {
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-// В задании на разработку тестов реализовывать следующую функцию не нужно -
-// она будет линковаться извне.
+namespace {
+
+/*
+    Равномерная сетка (spatial hash) для предметов.
+    Каждый предмет попадает ровно в одну ячейку по своей позиции,
+    поэтому кандидаты из разных ячеек никогда не повторяются.
+    Хранятся только непустые ячейки.
+*/
+class ItemsGrid {
+public:
+    ItemsGrid(const std::vector<Item>& items, double cell_size)
+        : cell_size_(cell_size) {
+        for(size_t item_id = 0; item_id < items.size(); ++item_id){
+            const Point2D& pos = items[item_id].position;
+            cells_[{ToCell(pos.x), ToCell(pos.y)}].push_back(item_id);
+        }
+    }
+
+    /*
+        Добавляет в candidates индексы предметов из ячеек,
+        которые пересекает прямоугольник [min, max].
+        Если ячеек в прямоугольнике больше, чем непустых ячеек сетки,
+        то дешевле пройти по непустым ячейкам и отфильтровать их.
+    */
+    void CollectCandidates(Point2D min, Point2D max, std::vector<size_t>& candidates) const {
+        const int64_t min_x = ToCell(min.x);
+        const int64_t max_x = ToCell(max.x);
+        const int64_t min_y = ToCell(min.y);
+        const int64_t max_y = ToCell(max.y);
+
+        const double cells_in_rect = static_cast<double>(max_x - min_x + 1) * static_cast<double>(max_y - min_y + 1);
+        if(cells_in_rect > static_cast<double>(cells_.size())){
+            for(const auto& [cell, items] : cells_){
+                if(min_x <= cell.first && cell.first <= max_x && min_y <= cell.second && cell.second <= max_y){
+                    candidates.insert(candidates.end(), items.begin(), items.end());
+                }
+            }
+            return;
+        }
+
+        for(int64_t x = min_x; x <= max_x; ++x){
+            for(int64_t y = min_y; y <= max_y; ++y){
+                if(auto it = cells_.find({x, y}); it != cells_.end()){
+                    candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+    }
+
+private:
+    using Cell = std::pair<int64_t, int64_t>;
+
+    struct CellHasher {
+        size_t operator()(const Cell& cell) const {
+            return std::hash<int64_t>{}(cell.first) * 37 + std::hash<int64_t>{}(cell.second);
+        }
+    };
+
+    int64_t ToCell(double coord) const {
+        return static_cast<int64_t>(std::floor(coord / cell_size_));
+    }
+
+    double cell_size_;
+    std::unordered_map<Cell, std::vector<size_t>, CellHasher> cells_;
+};
+
+/* Минимальный размер ячейки, чтобы при нулевых ширинах сетка не вырождалась */
+constexpr double MIN_CELL_SIZE = 1.0;
+
+} // namespace
 
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider){
-    std::vector<GatheringEvent> events;
+    /* Читаем предметы один раз, а не на каждую пару "собиратель - предмет" */
+    std::vector<Item> items;
+    items.reserve(provider.ItemsCount());
+    double max_item_width = 0;
+    for(size_t item_id = 0; item_id < provider.ItemsCount(); ++item_id){
+        const Item& item = items.emplace_back(provider.GetItem(item_id));
+        max_item_width = std::max(max_item_width, item.width);
+    }
+
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(provider.GatherersCount());
+    double max_gatherer_width = 0;
     for(size_t gatherer_id = 0; gatherer_id < provider.GatherersCount(); ++gatherer_id){
-        Gatherer gatherer = provider.GetGatherer(gatherer_id);
-        if(gatherer.start_pos != gatherer.end_pos){
-            for(size_t item_id = 0; item_id < provider.ItemsCount(); ++item_id){
-                Item item = provider.GetItem(item_id);
-                CollectionResult res = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
-
-                if(res.IsCollected(gatherer.width + item.width)){
-                    events.emplace_back(item_id, gatherer_id, res.sq_distance, res.proj_ratio);
-                }
+        const Gatherer& gatherer = gatherers.emplace_back(provider.GetGatherer(gatherer_id));
+        max_gatherer_width = std::max(max_gatherer_width, gatherer.width);
+    }
+
+    std::vector<GatheringEvent> events;
+    if(items.empty() || gatherers.empty()){
+        return events;
+    }
+
+    ItemsGrid grid(items, std::max(2 * (max_gatherer_width + max_item_width), MIN_CELL_SIZE));
+    std::vector<size_t> candidates;
+
+    for(size_t gatherer_id = 0; gatherer_id < gatherers.size(); ++gatherer_id){
+        const Gatherer& gatherer = gatherers[gatherer_id];
+        if(gatherer.start_pos == gatherer.end_pos){
+            continue;
+        }
+
+        /*
+            Предмет может быть подобран, только если он находится не дальше
+            суммы радиусов от отрезка перемещения, поэтому достаточно
+            проверить ячейки, покрывающие расширенный на эту сумму отрезок
+        */
+        const double reach = gatherer.width + max_item_width;
+        Point2D min{std::min(gatherer.start_pos.x, gatherer.end_pos.x) - reach,
+                    std::min(gatherer.start_pos.y, gatherer.end_pos.y) - reach};
+        Point2D max{std::max(gatherer.start_pos.x, gatherer.end_pos.x) + reach,
+                    std::max(gatherer.start_pos.y, gatherer.end_pos.y) + reach};
+
+        candidates.clear();
+        grid.CollectCandidates(min, max, candidates);
+
+        /* 
+            Проверяем предметы в порядке возрастания индекса, как при полном переборе,
+            чтобы после сортировки события шли в том же порядке
+        */
+        std::sort(candidates.begin(), candidates.end());
+        for(size_t item_id : candidates){
+            const Item& item = items[item_id];
+            CollectionResult res = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+
+            if(res.IsCollected(gatherer.width + item.width)){
+                events.emplace_back(item_id, gatherer_id, res.sq_distance, res.proj_ratio);
             }
         }
     }
@@ -53,8 +53,9 @@ struct GatheringEvent {
     double time;
 };
 
-// Эту функцию вам нужно будет реализовать в соответствующем задании.
-// При проверке ваших тестов она не нужна - функция будет линковаться снаружи.
+// Предметы раскладываются по ячейкам равномерной сетки, и каждый собиратель
+// проверяется только с предметами из ячеек, которые покрывает его перемещение.
+// События возвращаются в хронологическом порядке, как и при полном переборе.
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
 }  // namespace collision_detector
\ No newline at end of file
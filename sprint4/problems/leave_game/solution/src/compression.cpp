@@ -0,0 +1,106 @@
+#include "compression.h"
+#include <boost/crc.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <sstream>
+
+namespace compression {
+
+using namespace std::literals;
+namespace io = boost::iostreams;
+
+namespace {
+
+template <typename Compressor>
+std::string Compress(std::string_view data, Compressor compressor){
+    std::string result;
+    {
+        /* Поток дописывает хвост сжатых данных при уничтожении */
+        io::filtering_ostream out;
+        out.push(std::move(compressor));
+        out.push(io::back_inserter(result));
+        out.write(data.data(), data.size());
+    }
+    return result;
+}
+
+/* Метка содержимого: контрольная сумма и размер */
+std::string GetContentTag(std::string_view data){
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    std::ostringstream tag;
+    tag << std::hex << crc.checksum() << '-' << data.size();
+    return tag.str();
+}
+
+/* Сильный ETag варианта: метка исходного содержимого и кодирование */
+std::string MakeETag(std::string_view content_tag, Encoding encoding){
+    std::string etag = "\""s;
+    etag += content_tag;
+    if(encoding != Encoding::IDENTITY){
+        etag += '-';
+        etag += GetEncodingName(encoding);
+    }
+    etag += '"';
+    return etag;
+}
+
+size_t GetIndex(Encoding encoding){
+    return static_cast<size_t>(encoding);
+}
+
+}  // namespace
+
+std::string_view GetEncodingName(Encoding encoding) noexcept{
+    switch(encoding){
+        case Encoding::GZIP:
+            return "gzip"sv;
+        case Encoding::DEFLATE:
+            return "deflate"sv;
+        default:
+            return "identity"sv;
+    }
+}
+
+std::string Gzip(std::string_view data){
+    return Compress(data, io::gzip_compressor(io::gzip_params(io::gzip::best_compression)));
+}
+
+std::string Deflate(std::string_view data){
+    return Compress(data, io::zlib_compressor(io::zlib_params(io::zlib::best_compression)));
+}
+
+/* ------------------------ EncodedBody ----------------------------------- */
+
+EncodedBody::EncodedBody(std::string body, bool compress){
+    const std::string content_tag = GetContentTag(body);
+    auto add_variant = [this, &content_tag](Encoding encoding, std::string encoded){
+        variants_[GetIndex(encoding)] = Variant{encoding, std::make_shared<const std::string>(std::move(encoded)),
+                                                MakeETag(content_tag, encoding)};
+    };
+    if(compress){
+        if(std::string gzip = Gzip(body); gzip.size() < body.size()){
+            add_variant(Encoding::GZIP, std::move(gzip));
+        }
+        if(std::string deflate = Deflate(body); deflate.size() < body.size()){
+            add_variant(Encoding::DEFLATE, std::move(deflate));
+        }
+    }
+    add_variant(Encoding::IDENTITY, std::move(body));
+}
+
+const EncodedBody::Variant& EncodedBody::Get(Encoding encoding) const noexcept{
+    return Has(encoding) ? variants_[GetIndex(encoding)] : variants_[GetIndex(Encoding::IDENTITY)];
+}
+
+bool EncodedBody::Has(Encoding encoding) const noexcept{
+    return variants_[GetIndex(encoding)].body != nullptr;
+}
+
+bool EncodedBody::HasCompressed() const noexcept{
+    return Has(Encoding::GZIP) || Has(Encoding::DEFLATE);
+}
+
+}  // namespace compression
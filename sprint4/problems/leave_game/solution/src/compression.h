@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace compression {
+
+/* Кодирование тела ответа (заголовок Content-Encoding) */
+enum class Encoding{
+    IDENTITY,
+    GZIP,
+    DEFLATE
+};
+
+inline constexpr size_t ENCODING_COUNT = 3;
+
+/* Имя кодирования в заголовках Accept-Encoding и Content-Encoding */
+std::string_view GetEncodingName(Encoding encoding) noexcept;
+
+/* Сжимает данные в формате gzip (RFC 1952) с максимальной степенью сжатия. Результат не зависит от времени сжатия */
+std::string Gzip(std::string_view data);
+
+/* Сжимает данные в формате zlib (RFC 1950), который в HTTP называется deflate */
+std::string Deflate(std::string_view data);
+
+/*
+    Неизменяемое тело ответа, заранее подготовленное во всех кодированиях.
+    Сжатые варианты хранятся, только если они меньше исходного тела.
+    У каждого варианта свой сильный ETag, потому что это разные представления ресурса
+*/
+class EncodedBody{
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    struct Variant{
+        Encoding encoding = Encoding::IDENTITY;
+        Buffer body;
+        std::string etag;
+    };
+
+    /* compress = false - хранить только исходное тело, например для уже сжатых картинок */
+    explicit EncodedBody(std::string body, bool compress = true);
+
+    /* Вариант в кодировании encoding, а если его нет - исходное тело */
+    const Variant& Get(Encoding encoding) const noexcept;
+
+    bool Has(Encoding encoding) const noexcept;
+
+    /* Есть ли сжатые варианты, то есть зависит ли ответ от Accept-Encoding */
+    bool HasCompressed() const noexcept;
+
+private:
+    std::array<Variant, ENCODING_COUNT> variants_;
+};
+
+}  // namespace compression
@@ -1,31 +1,234 @@
 #include "connection_pool.h"
+#include "logger.h"
+#include "metrics.h"
+#include <algorithm>
+#include <future>
 
 namespace db_connection{
 
 /* ------------------------ ConnectionPool ----------------------------------- */
 
-ConnectionPool::ConnectionWrapper ConnectionPool::GetConnection(){
+namespace {
+
+int64_t ToNanoseconds(ConnectionPool::Clock::duration duration){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+/* Исключение из обработчика не должно останавливать поток пула */
+void InvokeHandler(const ConnectionPool::AcquireHandler& handler, boost::system::error_code ec,
+                    ConnectionPool::ConnectionWrapper&& conn){
+    try{
+        handler(ec, std::move(conn));
+    } catch(const std::exception& ex){
+        LOG_ERROR(0, ex.what(), "database connection handler"s);
+    }
+}
+
+metrics::Histogram& GetWaitMetric(){
+    static metrics::Histogram& wait = metrics::GetRegistry().AddHistogram("db_pool_wait_seconds"s, 
+        "Time spent waiting for a database connection"s).WithLabels({});
+    return wait;
+}
+
+metrics::Counter& GetTimeoutsMetric(){
+    static metrics::Counter& timeouts = metrics::GetRegistry().AddCounter("db_pool_timeouts_total"s, 
+        "Database connection requests that timed out"s).WithLabels({});
+    return timeouts;
+}
+
+}  // namespace
+
+ConnectionPool::~ConnectionPool(){
+    std::deque<WaiterPtr> waiters;
+    {
+        std::lock_guard lock{mutex_};
+        stopped_ = true;
+        waiters = std::move(waiters_);
+        waiters_.clear();
+        health_timer_.cancel();
+        for(const auto& waiter : waiters){
+            waiter->timer.cancel();
+        }
+    }
+    for(auto& waiter : waiters){
+        net::post(threads_, [waiter]{
+            InvokeHandler(waiter->handler, net::error::operation_aborted, {});
+        });
+    }
+    threads_.join();
+}
+
+void ConnectionPool::AsyncGetConnection(AcquireHandler handler){
     std::unique_lock lock{mutex_};
-    // Блокируем текущий поток и ждём, пока cond_var_ не получит уведомление и не освободится
-    // хотя бы одно соединение
-    cond_var_.wait(lock, [this] {
-        return used_connections_ < pool_.size();
+    if(stopped_){
+        lock.unlock();
+        net::post(threads_, [handler = std::move(handler)]{
+            InvokeHandler(handler, net::error::operation_aborted, {});
+        });
+        return;
+    }
+    if(!idle_.empty()){
+        ConnectionPtr conn = std::move(idle_.back());
+        idle_.pop_back();
+        ++in_use_;
+        lock.unlock();
+        AddWaitTime(Clock::duration::zero());
+        Deliver(std::move(conn), std::move(handler));
+        return;
+    }
+
+    // Свободных соединений нет: запрос ждёт в очереди, пока соединение не вернут или не истечёт таймер
+    auto waiter = std::make_shared<Waiter>(Waiter{std::move(handler), Clock::now(), 
+                                                net::steady_timer{threads_.get_executor(), options_.acquire_timeout}});
+    waiter->timer.async_wait([this, weak_waiter = std::weak_ptr(waiter)](boost::system::error_code ec){
+        if(auto waiter = weak_waiter.lock(); !ec && waiter){
+            OnWaitTimeout(waiter);
+        }
+    });
+    waiters_.push_back(std::move(waiter));
+}
+
+ConnectionPool::ConnectionWrapper ConnectionPool::GetConnection(){
+    auto promise = std::make_shared<std::promise<ConnectionWrapper>>();
+    auto result = promise->get_future();
+    AsyncGetConnection([promise](boost::system::error_code ec, ConnectionWrapper conn){
+        if(ec){
+            promise->set_exception(std::make_exception_ptr(
+                boost::system::system_error(ec, "database connection"s)));
+        } else {
+            promise->set_value(std::move(conn));
+        }
+    });
+    return result.get();
+}
+
+ConnectionPoolStats ConnectionPool::GetStats() const{
+    ConnectionPoolStats stats;
+    stats.capacity = capacity_;
+    {
+        std::lock_guard lock{mutex_};
+        stats.waiting = waiters_.size();
+    }
+    stats.in_use = in_use_.load(std::memory_order_relaxed);
+    stats.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+    stats.timeouts = timeouts_.load(std::memory_order_relaxed);
+    stats.reconnects = reconnects_.load(std::memory_order_relaxed);
+    stats.total_wait = std::chrono::nanoseconds(total_wait_ns_.load(std::memory_order_relaxed));
+    stats.max_wait = std::chrono::nanoseconds(max_wait_ns_.load(std::memory_order_relaxed));
+    stats.total_busy = std::chrono::nanoseconds(total_busy_ns_.load(std::memory_order_relaxed));
+    return stats;
+}
+
+void ConnectionPool::ReturnConnection(ConnectionPool::ConnectionPtr&& conn, Clock::duration busy_time){
+    total_busy_ns_.fetch_add(ToNanoseconds(busy_time), std::memory_order_relaxed);
+    WaiterPtr waiter;
+    {
+        std::lock_guard lock{mutex_};
+        if(waiters_.empty()){
+            idle_.push_back(std::move(conn));
+            --in_use_;
+            return;
+        }
+        // Соединение сразу передаётся первому ожидающему, таймер ожидания отменяется
+        waiter = std::move(waiters_.front());
+        waiters_.pop_front();
+        waiter->timer.cancel();
+    }
+    AddWaitTime(Clock::now() - waiter->since);
+    Deliver(std::move(conn), std::move(waiter->handler));
+}
+
+void ConnectionPool::Deliver(ConnectionPtr&& conn, AcquireHandler&& handler){
+    acquisitions_.fetch_add(1, std::memory_order_relaxed);
+    net::post(threads_, [this, conn = std::move(conn), handler = std::move(handler)]() mutable {
+        if(!conn->is_open() && !Reconnect(conn)){
+            // Разорванное соединение остаётся в пуле, следующий запрос попробует переподключиться снова
+            ReturnConnection(std::move(conn), Clock::duration::zero());
+            InvokeHandler(handler, net::error::connection_refused, {});
+            return;
+        }
+        InvokeHandler(handler, {}, ConnectionWrapper{std::move(conn), *this});
     });
-    // После выхода из цикла ожидания мьютекс остаётся захваченным
+}
 
-    return {std::move(pool_[used_connections_++]), *this};
+void ConnectionPool::OnWaitTimeout(const WaiterPtr& waiter){
+    {
+        std::lock_guard lock{mutex_};
+        auto it = std::find(waiters_.begin(), waiters_.end(), waiter);
+        if(it == waiters_.end()){
+            // Соединение уже выдано, таймер сработал одновременно с отменой
+            return;
+        }
+        waiters_.erase(it);
+    }
+    timeouts_.fetch_add(1, std::memory_order_relaxed);
+    GetTimeoutsMetric().Increment();
+    AddWaitTime(Clock::now() - waiter->since);
+    InvokeHandler(waiter->handler, net::error::timed_out, {});
 }
 
+void ConnectionPool::ScheduleHealthCheck(){
+    health_timer_.expires_after(options_.health_check_period);
+    health_timer_.async_wait([this](boost::system::error_code ec){
+        if(!ec){
+            CheckIdleConnections();
+        }
+    });
+}
 
-void ConnectionPool::ReturnConnection(ConnectionPool::ConnectionPtr&& conn){
-    // Возвращаем соединение обратно в пул
+void ConnectionPool::CheckIdleConnections(){
+    std::vector<ConnectionPtr> connections;
     {
         std::lock_guard lock{mutex_};
-        assert(used_connections_ != 0);
-        pool_[--used_connections_] = std::move(conn);
+        if(stopped_){
+            return;
+        }
+        // На время проверки соединения считаются занятыми, и новые запросы их не получат
+        connections = std::move(idle_);
+        idle_.clear();
+        in_use_ += connections.size();
+    }
+    for(auto& conn : connections){
+        bool is_alive = conn->is_open();
+        if(is_alive){
+            try{
+                pqxx::nontransaction ping{*conn};
+                ping.exec("SELECT 1;"_zv);
+            } catch(const std::exception&){
+                is_alive = false;
+            }
+        }
+        if(!is_alive){
+            Reconnect(conn);
+        }
+        ReturnConnection(std::move(conn), Clock::duration::zero());
+    }
+
+    std::lock_guard lock{mutex_};
+    if(!stopped_){
+        ScheduleHealthCheck();
+    }
+}
+
+bool ConnectionPool::Reconnect(ConnectionPtr& conn){
+    try{
+        conn = factory_(db_url_.c_str());
+        reconnects_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    } catch(const std::exception& ex){
+        LOG_ERROR(0, ex.what(), "database reconnect"s);
+        return false;
+    }
+}
+
+void ConnectionPool::AddWaitTime(Clock::duration wait_time){
+    GetWaitMetric().Observe(wait_time);
+    const int64_t wait_ns = ToNanoseconds(wait_time);
+    total_wait_ns_.fetch_add(wait_ns, std::memory_order_relaxed);
+    int64_t max_wait_ns = max_wait_ns_.load(std::memory_order_relaxed);
+    while(wait_ns > max_wait_ns 
+        && !max_wait_ns_.compare_exchange_weak(max_wait_ns, wait_ns, std::memory_order_relaxed)){
     }
-    // Уведомляем один из ожидающих потоков об изменении состояния пула
-    cond_var_.notify_one();
 }
 
 /* ------------------------ ConnectionFactory ----------------------------------- */
@@ -33,7 +236,8 @@ void ConnectionPool::ReturnConnection(ConnectionPool::ConnectionPtr&& conn){
 inline ConnectionPool::ConnectionPtr ConnectionFactory(const char* db_url){
     auto conn = std::make_shared<pqxx::connection>(db_url);
     conn->prepare("insert", R"(
-                        INSERT INTO retired_players (name, score, time) VALUES ($1, $2, $3);
+                        INSERT INTO retired_players (name, score, time, retirement_id) VALUES ($1, $2, $3, $4)
+                        ON CONFLICT (retirement_id) DO NOTHING;
                         )");
     conn->prepare("select", R"(
                         SELECT name, score, time FROM retired_players 
@@ -41,27 +245,215 @@ inline ConnectionPool::ConnectionPtr ConnectionFactory(const char* db_url){
                         LIMIT $1 
                         OFFSET $2;
                         )");
+    conn->prepare("select_all", R"(
+                        SELECT name, score, time, retirement_id FROM retired_players;
+                        )");
     return conn;
 }
 
+/* ------------------------ RetiredPlayersWriter ----------------------------------- */
+
+RetiredPlayersWriter::RetiredPlayersWriter(ConnectionPool& pool, const WriteBehindOptions& options)
+    : pool_(pool)
+    , options_(options){
+    options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+    worker_ = std::thread([this]{ Run(); });
+}
+
+RetiredPlayersWriter::~RetiredPlayersWriter(){
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    has_work_.notify_one();
+    worker_.join();
+}
+
+void RetiredPlayersWriter::Enqueue(RetiredPlayer player){
+    bool is_batch_ready;
+    {
+        std::lock_guard lock{mutex_};
+        pending_.push_back(std::move(player));
+        ++enqueued_count_;
+        is_batch_ready = pending_.size() >= options_.batch_size;
+    }
+    if(is_batch_ready){
+        has_work_.notify_one();
+    }
+}
+
+bool RetiredPlayersWriter::Flush(){
+    std::unique_lock lock{mutex_};
+    const uint64_t target = enqueued_count_;
+    const uint64_t lost_before = lost_count_;
+    if(written_count_ + lost_count_ < target){
+        flush_requested_ = true;
+        has_work_.notify_one();
+        written_.wait(lock, [this, target]{
+            return written_count_ + lost_count_ >= target;
+        });
+    }
+    return lost_count_ == lost_before;
+}
+
+void RetiredPlayersWriter::Run(){
+    std::unique_lock lock{mutex_};
+    while(true){
+        Clock::time_point wake_up = Clock::now() + options_.flush_interval;
+        for(const Batch& batch : retries_){
+            wake_up = std::min(wake_up, batch.retry_at);
+        }
+        has_work_.wait_until(lock, wake_up, [this]{
+            const bool has_batch = !pending_.empty() 
+                && (stop_ || flush_requested_ || pending_.size() >= options_.batch_size);
+            const bool is_done = stop_ && pending_.empty() && retries_.empty() && in_flight_count_ == 0;
+            return has_batch || is_done;
+        });
+        flush_requested_ = false;
+
+        std::vector<Batch> batches;
+        const Clock::time_point now = Clock::now();
+        std::erase_if(retries_, [&batches, now](Batch& batch){
+            if(batch.retry_at > now){
+                return false;
+            }
+            batches.push_back(std::move(batch));
+            return true;
+        });
+        for(size_t begin = 0; begin < pending_.size(); begin += options_.batch_size){
+            const size_t end = std::min(pending_.size(), begin + options_.batch_size);
+            batches.push_back(Batch{{std::make_move_iterator(pending_.begin() + begin), 
+                                     std::make_move_iterator(pending_.begin() + end)}});
+        }
+        pending_.clear();
+
+        if(batches.empty()){
+            // Поток завершается, только когда дописаны все пачки, уже отданные пулу, и все повторы
+            if(stop_ && retries_.empty() && in_flight_count_ == 0){
+                return;
+            }
+            continue;
+        }
+
+        for(const Batch& batch : batches){
+            in_flight_count_ += batch.rows.size();
+        }
+        lock.unlock();
+        for(Batch& batch : batches){
+            Dispatch(std::move(batch));
+        }
+        lock.lock();
+    }
+}
+
+void RetiredPlayersWriter::Dispatch(Batch&& batch){
+    auto shared_batch = std::make_shared<Batch>(std::move(batch));
+    pool_.AsyncGetConnection([this, shared_batch](boost::system::error_code ec, ConnectionPool::ConnectionWrapper conn){
+        OnConnection(ec, std::move(conn), std::move(*shared_batch));
+    });
+}
+
+void RetiredPlayersWriter::OnConnection(boost::system::error_code ec, ConnectionPool::ConnectionWrapper&& conn, 
+                                        Batch&& batch){
+    if(ec == net::error::timed_out){
+        // Все соединения заняты: строки возвращаются в очередь и попадут в следующую пачку
+        std::lock_guard lock{mutex_};
+        in_flight_count_ -= batch.rows.size();
+        pending_.insert(pending_.end(), std::make_move_iterator(batch.rows.begin()), 
+                        std::make_move_iterator(batch.rows.end()));
+        has_work_.notify_one();
+        return;
+    }
+
+    bool is_written = false;
+    if(ec){
+        LOG_ERROR(ec.value(), ec.message(), "retired players write"s);
+    } else {
+        try{
+            WriteBatch(*conn, batch.rows);
+            is_written = true;
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "retired players write"s);
+        }
+    }
+
+    // Уведомление под мьютексом: после его освобождения писатель может быть уже уничтожен
+    std::lock_guard lock{mutex_};
+    in_flight_count_ -= batch.rows.size();
+    if(is_written){
+        written_count_ += batch.rows.size();
+    } else if(++batch.failures < options_.max_attempts){
+        batch.retry_at = Clock::now() + options_.retry_backoff * (1u << std::min(batch.failures - 1, 10u));
+        retries_.push_back(std::move(batch));
+    } else {
+        lost_count_ += batch.rows.size();
+        LOG_ERROR(0, std::to_string(batch.rows.size()) + " retired players are lost after "s 
+                        + std::to_string(batch.failures) + " failed writes"s, "retired players write"s);
+    }
+    written_.notify_all();
+    has_work_.notify_one();
+}
+
+void RetiredPlayersWriter::WriteBatch(pqxx::connection& conn, const std::vector<RetiredPlayer>& batch){
+    std::string query = "INSERT INTO retired_players (name, score, time, retirement_id) VALUES "s;
+    pqxx::params params;
+    params.reserve(batch.size() * 4);
+    for(size_t i = 0; i < batch.size(); ++i){
+        if(i != 0){
+            query += ", "sv;
+        }
+        const size_t first = i * 4 + 1;
+        query += "($"s + std::to_string(first) + ", $"s + std::to_string(first + 1) 
+                + ", $"s + std::to_string(first + 2) + ", $"s + std::to_string(first + 3) + ")"s;
+        params.append(batch[i].name);
+        params.append(batch[i].score);
+        params.append(batch[i].time);
+        params.append(batch[i].retirement_id);
+    }
+    /* Пачка, повторённая после ошибки или при восстановлении из журнала, не дублирует строки */
+    query += " ON CONFLICT (retirement_id) DO NOTHING;"sv;
+
+    pqxx::work w{conn};
+    w.exec_params(query, params);
+    w.commit();
+}
+
 /* ------------------------ DatabaseManager ----------------------------------- */
 
-DatabaseManager::DatabaseManager(size_t capacity, const char* db_url)
-:connection_pool_(capacity, ConnectionFactory, db_url){}
+DatabaseManager::DatabaseManager(size_t capacity, const char* db_url, const WriteBehindOptions& write_options,
+                                const ConnectionPoolOptions& pool_options)
+:connection_pool_(capacity, ConnectionFactory, db_url, pool_options), writer_(connection_pool_, write_options){}
 
 pqxx::result DatabaseManager::SelectData(unsigned start, unsigned max_items){
+    /* Таблица рекордов должна видеть всех игроков, ушедших до запроса */
+    writer_.Flush();
     auto conn = connection_pool_.GetConnection();
     pqxx::read_transaction rt{*conn};
     return rt.exec_prepared("select", max_items, start);
 }
 
-void DatabaseManager::InsertData(std::string_view name, unsigned score, double time){
+pqxx::result DatabaseManager::SelectAll(){
+    writer_.Flush();
+    auto conn = connection_pool_.GetConnection();
+    pqxx::read_transaction rt{*conn};
+    return rt.exec_prepared("select_all");
+}
+
+void DatabaseManager::InsertData(std::string_view name, unsigned score, double time, std::string_view retirement_id){
     auto conn = connection_pool_.GetConnection();
     pqxx::work w{*conn};
-    w.exec_prepared("insert", name, score , time);
+    w.exec_prepared("insert", name, score , time, retirement_id);
     w.commit();
 }
 
+void DatabaseManager::EnqueueInsert(std::string name, unsigned score, double time, std::string retirement_id){
+    writer_.Enqueue({std::move(name), score, time, std::move(retirement_id)});
+}
+
+ConnectionPoolStats DatabaseManager::GetPoolStats() const{
+    return connection_pool_.GetStats();
+}
+
 /* ------------------------ CreateTable ----------------------------------- */
 
 void CreateTable(const char* db_url){
@@ -86,7 +478,8 @@ void CreateTable(const char* db_url){
             id SERIAL PRIMARY KEY,
             name varchar(100) NOT NULL,
             score integer NOT NULL,
-            time real NOT NULL
+            time real NOT NULL,
+            retirement_id char(32) NOT NULL UNIQUE
         );
         )"_zv);
     work.exec(R"(
@@ -1,25 +1,75 @@
 # pragma once
 #include <pqxx/pqxx>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace db_connection{
 
+namespace net = boost::asio;
+
 using pqxx::operator""_zv;
 using namespace std::literals;
 
 /* ------------------------ ConnectionPool ----------------------------------- */
 
+struct ConnectionPoolOptions{
+    /* Сколько запрос соединения может ждать в очереди, прежде чем завершится ошибкой timed_out */
+    std::chrono::milliseconds acquire_timeout{5000};
+    /* Как часто простаивающие соединения проверяются запросом SELECT 1 */
+    std::chrono::milliseconds health_check_period{30000};
+};
+
+/* Счётчики пула для мониторинга */
+struct ConnectionPoolStats{
+    size_t capacity = 0;
+    /* Число выданных соединений в момент запроса счётчиков */
+    size_t in_use = 0;
+    /* Число запросов, ожидающих свободного соединения */
+    size_t waiting = 0;
+    uint64_t acquisitions = 0;
+    uint64_t timeouts = 0;
+    uint64_t reconnects = 0;
+    /* Суммарное и наибольшее время ожидания соединения */
+    std::chrono::nanoseconds total_wait{0};
+    std::chrono::nanoseconds max_wait{0};
+    /* Суммарное время, в течение которого соединения были выданы */
+    std::chrono::nanoseconds total_busy{0};
+};
+
+/*
+    Пул соединений с асинхронной выдачей.
+    AsyncGetConnection не блокирует вызывающий поток: обработчик вызывается
+    в собственном пуле потоков базы данных, когда освободится соединение
+    или истечёт время ожидания. Запросы к базе выполняются в этих же потоках,
+    поэтому медленный запрос не задерживает потоки ввода-вывода и strand API.
+    Перед выдачей разорванное соединение пересоздаётся, а простаивающие соединения
+    периодически проверяются
+*/
 class ConnectionPool {
 public:
     using PoolType = ConnectionPool;
     using ConnectionPtr = std::shared_ptr<pqxx::connection>;
+    using Clock = std::chrono::steady_clock;
+
     class ConnectionWrapper {
     public:
+        ConnectionWrapper() = default;
+
         ConnectionWrapper(std::shared_ptr<pqxx::connection>&& conn, PoolType& pool) noexcept
             : conn_{std::move(conn)}
-            , pool_{&pool} {
+            , pool_{&pool}
+            , acquired_{Clock::now()} {
         }
 
         ConnectionWrapper(const ConnectionWrapper&) = delete;
@@ -37,53 +87,221 @@ public:
             return conn_.get();
         }
 
+        explicit operator bool() const noexcept {
+            return conn_ != nullptr;
+        }
+
         ~ConnectionWrapper() {
             if (conn_) {
-                pool_->ReturnConnection(std::move(conn_));
+                pool_->ReturnConnection(std::move(conn_), Clock::now() - acquired_);
             }
         }
 
     private:
         std::shared_ptr<pqxx::connection> conn_;
-        PoolType* pool_;
+        PoolType* pool_ = nullptr;
+        Clock::time_point acquired_;
     };
 
+    /* При ошибке соединение пустое, ec равен net::error::timed_out или коду ошибки переподключения */
+    using AcquireHandler = std::function<void(boost::system::error_code ec, ConnectionWrapper conn)>;
+
     // ConnectionFactory is a functional object returning std::shared_ptr<pqxx::connection>
     template <typename ConnectionFactory>
-    ConnectionPool(size_t capacity, ConnectionFactory&& connection_factory, const char* db_url){
-        pool_.reserve(capacity);
+    ConnectionPool(size_t capacity, ConnectionFactory&& connection_factory, const char* db_url,
+                    const ConnectionPoolOptions& options = {})
+        : threads_(capacity + 1)
+        , factory_(std::forward<ConnectionFactory>(connection_factory))
+        , db_url_(db_url)
+        , options_(options)
+        , health_timer_(threads_.get_executor()){
+        idle_.reserve(capacity);
         for (size_t i = 0; i < capacity; ++i) {
-            pool_.emplace_back(connection_factory(db_url));
+            idle_.emplace_back(factory_(db_url_.c_str()));
         }
+        capacity_ = capacity;
+        ScheduleHealthCheck();
     }
 
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /* Отменяет ожидающие запросы и дожидается завершения обработчиков */
+    ~ConnectionPool();
+
+    /*
+        Запрашивает соединение. Обработчик вызывается в потоке пула базы данных,
+        и в нём можно выполнять блокирующие запросы pqxx
+    */
+    void AsyncGetConnection(AcquireHandler handler);
+
+    /*
+        Синхронная обёртка над AsyncGetConnection для запуска и фоновых потоков.
+        Нельзя вызывать из обработчиков самого пула.
+        При ошибке выбрасывает boost::system::system_error
+    */
     ConnectionWrapper GetConnection();
 
+    ConnectionPoolStats GetStats() const;
+
 private:
-    void ReturnConnection(ConnectionPtr&& conn);
+    struct Waiter{
+        AcquireHandler handler;
+        Clock::time_point since;
+        net::steady_timer timer;
+    };
+    using WaiterPtr = std::shared_ptr<Waiter>;
 
-    std::mutex mutex_;
-    std::condition_variable cond_var_;
-    std::vector<ConnectionPtr> pool_;
-    size_t used_connections_ = 0;
+    void ReturnConnection(ConnectionPtr&& conn, Clock::duration busy_time);
+
+    /* Выдаёт соединение в потоке пула, при необходимости переподключив его */
+    void Deliver(ConnectionPtr&& conn, AcquireHandler&& handler);
+
+    void OnWaitTimeout(const WaiterPtr& waiter);
+
+    void ScheduleHealthCheck();
+
+    void CheckIdleConnections();
+
+    /* Пересоздаёт соединение. Возвращает false, если база данных недоступна */
+    bool Reconnect(ConnectionPtr& conn);
+
+    void AddWaitTime(Clock::duration wait_time);
+
+    net::thread_pool threads_;
+    std::function<ConnectionPtr(const char*)> factory_;
+    std::string db_url_;
+    ConnectionPoolOptions options_;
+    size_t capacity_ = 0;
+
+    mutable std::mutex mutex_;
+    std::vector<ConnectionPtr> idle_;
+    std::deque<WaiterPtr> waiters_;
+    bool stopped_ = false;
+    net::steady_timer health_timer_;
+
+    std::atomic<size_t> in_use_ = 0;
+    std::atomic<uint64_t> acquisitions_ = 0;
+    std::atomic<uint64_t> timeouts_ = 0;
+    std::atomic<uint64_t> reconnects_ = 0;
+    std::atomic<int64_t> total_wait_ns_ = 0;
+    std::atomic<int64_t> max_wait_ns_ = 0;
+    std::atomic<int64_t> total_busy_ns_ = 0;
 };
 
 /* ------------------------ ConnectionFactory ----------------------------------- */
 
 ConnectionPool::ConnectionPtr ConnectionFactory(const char* db_url);
 
+/* ------------------------ RetiredPlayersWriter ----------------------------------- */
+
+struct RetiredPlayer{
+    std::string name;
+    unsigned score;
+    double time;
+    /* Токен ушедшего игрока: повторная запись того же ухода игнорируется */
+    std::string retirement_id;
+};
+
+struct WriteBehindOptions{
+    /* Наибольшее число строк в одном INSERT */
+    size_t batch_size = 100;
+    /* Как долго строка может ждать записи, если пачка не набралась */
+    std::chrono::milliseconds flush_interval{100};
+    /* Сколько раз пытаться записать пачку, если запись завершилась ошибкой */
+    unsigned max_attempts = 5;
+    /* Пауза перед повторной записью, удваивается с каждой неудачной попыткой */
+    std::chrono::milliseconds retry_backoff{100};
+};
+
+/*
+    Отложенная запись ушедших на покой игроков.
+    Enqueue только ставит строку в очередь, а фоновый поток собирает
+    накопленные строки в пачки и отдаёт их пулу соединений, одним INSERT на пачку.
+    Если соединение не удалось получить вовремя, пачка возвращается в очередь.
+    Пачка, запись которой завершилась ошибкой, повторяется после паузы,
+    а после max_attempts неудачных попыток её строки теряются с записью в журнал ошибок.
+    При уничтожении все строки из очереди дописываются
+*/
+class RetiredPlayersWriter{
+public:
+    RetiredPlayersWriter(ConnectionPool& pool, const WriteBehindOptions& options);
+
+    RetiredPlayersWriter(const RetiredPlayersWriter&) = delete;
+    RetiredPlayersWriter& operator=(const RetiredPlayersWriter&) = delete;
+
+    ~RetiredPlayersWriter();
+
+    void Enqueue(RetiredPlayer player);
+
+    /* 
+        Дожидается, пока будут обработаны все строки, поставленные в очередь до вызова.
+        Возвращает false, если часть строк так и не удалось записать
+    */
+    bool Flush();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Batch{
+        std::vector<RetiredPlayer> rows;
+        /* Число неудачных попыток записи */
+        unsigned failures = 0;
+        /* Время, раньше которого пачку не пытаются записать снова */
+        Clock::time_point retry_at;
+    };
+
+    void Run();
+
+    /* Отдаёт пачку пулу: она пишется в потоке пула, фоновый поток сразу переходит к следующей */
+    void Dispatch(Batch&& batch);
+
+    /* Вызывается в потоке пула, когда соединение для пачки получено или ожидание завершилось ошибкой */
+    void OnConnection(boost::system::error_code ec, ConnectionPool::ConnectionWrapper&& conn, Batch&& batch);
+
+    static void WriteBatch(pqxx::connection& conn, const std::vector<RetiredPlayer>& batch);
+
+    ConnectionPool& pool_;
+    WriteBehindOptions options_;
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable written_;
+    std::vector<RetiredPlayer> pending_;
+    /* Пачки, ждущие повторной записи после ошибки */
+    std::vector<Batch> retries_;
+    /* Число строк, поставленных в очередь, записанных и потерянных за всё время */
+    uint64_t enqueued_count_ = 0;
+    uint64_t written_count_ = 0;
+    uint64_t lost_count_ = 0;
+    /* Число строк в пачках, которые ждут соединения или записываются */
+    uint64_t in_flight_count_ = 0;
+    bool flush_requested_ = false;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
 /* ------------------------ DatabaseManager ----------------------------------- */
 
 class DatabaseManager{
 public:
-    DatabaseManager(size_t capacity, const char* db_url);
+    DatabaseManager(size_t capacity, const char* db_url, const WriteBehindOptions& write_options = {},
+                    const ConnectionPoolOptions& pool_options = {});
 
     pqxx::result SelectData(unsigned start, unsigned max_items);
 
-    void InsertData(std::string_view name, unsigned score, double time);
+    /* Все записи таблицы рекордов без сортировки: name, score, time, retirement_id */
+    pqxx::result SelectAll();
+
+    void InsertData(std::string_view name, unsigned score, double time, std::string_view retirement_id);
+
+    /* Ставит строку в очередь отложенной записи, не дожидаясь базы данных */
+    void EnqueueInsert(std::string name, unsigned score, double time, std::string retirement_id);
+
+    ConnectionPoolStats GetPoolStats() const;
 
 private:
     ConnectionPool connection_pool_;
+    RetiredPlayersWriter writer_;
 };
 
 /* ------------------------ CreateTable ----------------------------------- */
@@ -0,0 +1,86 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace util {
+
+/* Файловый дескриптор POSIX. Ошибки сообщаются исключением std::system_error */
+class FileDescriptor{
+public:
+    FileDescriptor(const std::filesystem::path& path, int flags, mode_t mode = 0)
+        : fd_(::open(path.c_str(), flags | O_CLOEXEC, mode)){
+        if(fd_ < 0){
+            throw std::system_error(errno, std::generic_category(), "open " + path.string());
+        }
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor(){
+        ::close(fd_);
+    }
+
+    int Get() const noexcept{
+        return fd_;
+    }
+
+    void Write(std::string_view data){
+        while(!data.empty()){
+            const ssize_t written = ::write(fd_, data.data(), data.size());
+            if(written < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+
+    /* Сбрасывает на диск данные и метаданные файла */
+    void Sync(){
+        if(::fsync(fd_) != 0){
+            throw std::system_error(errno, std::generic_category(), "fsync");
+        }
+    }
+
+    /* Сбрасывает на диск только данные, без необязательных метаданных вроде времени изменения */
+    void DataSync(){
+        if(::fdatasync(fd_) != 0){
+            throw std::system_error(errno, std::generic_category(), "fdatasync");
+        }
+    }
+
+    off_t GetSize() const{
+        struct stat st;
+        if(::fstat(fd_, &st) != 0){
+            throw std::system_error(errno, std::generic_category(), "fstat");
+        }
+        return st.st_size;
+    }
+
+    void Truncate(off_t size){
+        if(::ftruncate(fd_, size) != 0){
+            throw std::system_error(errno, std::generic_category(), "ftruncate");
+        }
+    }
+
+private:
+    int fd_;
+};
+
+/* Сбрасывает на диск каталог файла path, чтобы созданные и переименованные файлы пережили сбой */
+inline void SyncParentDirectory(const std::filesystem::path& path){
+    std::filesystem::path directory = path.parent_path();
+    FileDescriptor dir(directory.empty() ? std::filesystem::path(".") : directory, O_RDONLY | O_DIRECTORY);
+    dir.Sync();
+}
+
+}  // namespace util
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * Хэш-таблица с открытой адресацией и линейным пробированием.
+ * Пары ключ-значение лежат прямо в одном векторе слотов, поэтому поиск
+ * обходится без переходов по указателям, как в узлах std::unordered_map.
+ *
+ * - Ёмкость - степень двойки, таблица заполняется не больше чем наполовину.
+ * - При удалении следующие элементы цепочки сдвигаются назад,
+ *   поэтому надгробия не нужны и поиск не замедляется со временем.
+ * - Адреса значений нестабильны: указатель, полученный из Find,
+ *   нельзя хранить дольше, чем до следующего добавления или удаления.
+ *
+ * Hasher должен хорошо перемешивать младшие биты хэша: номер слота - это младшие биты.
+ */
+template <typename Key, typename Value, typename Hasher>
+class FlatHashMap {
+public:
+    FlatHashMap() = default;
+
+    /* Добавляет значение. Возвращает false, если ключ уже есть в таблице */
+    bool Emplace(const Key& key, Value value) {
+        if((size_ + 1) * 2 > slots_.size()){
+            Rehash(slots_.empty() ? MIN_CAPACITY : slots_.size() * 2);
+        }
+        size_t index = FindSlot(key);
+        if(slots_[index].occupied){
+            return false;
+        }
+        slots_[index] = Slot{key, std::move(value), true};
+        ++size_;
+        return true;
+    }
+
+    bool Contains(const Key& key) const {
+        return Find(key) != nullptr;
+    }
+
+    Value* Find(const Key& key) {
+        if(slots_.empty()){
+            return nullptr;
+        }
+        Slot& slot = slots_[FindSlot(key)];
+        return slot.occupied ? &slot.value : nullptr;
+    }
+
+    const Value* Find(const Key& key) const {
+        if(slots_.empty()){
+            return nullptr;
+        }
+        const Slot& slot = slots_[FindSlot(key)];
+        return slot.occupied ? &slot.value : nullptr;
+    }
+
+    bool Erase(const Key& key) {
+        if(slots_.empty()){
+            return false;
+        }
+        size_t hole = FindSlot(key);
+        if(!slots_[hole].occupied){
+            return false;
+        }
+
+        /* Сдвигаем назад элементы, которые без дыры не нашлись бы от своего начального слота */
+        const size_t mask = slots_.size() - 1;
+        for(size_t index = (hole + 1) & mask; slots_[index].occupied; index = (index + 1) & mask){
+            const size_t home = GetHome(slots_[index].key);
+            /* Элемент остаётся на месте, если его начальный слот лежит между дырой и им самим */
+            const bool stays = (hole < index) ? (hole < home && home <= index) : (hole < home || home <= index);
+            if(!stays){
+                slots_[hole] = std::move(slots_[index]);
+                hole = index;
+            }
+        }
+        slots_[hole] = Slot{};
+        --size_;
+        return true;
+    }
+
+    /* Готовит таблицу к count элементам, чтобы при добавлении не было перестроений */
+    void Reserve(size_t count) {
+        size_t capacity = MIN_CAPACITY;
+        while(capacity < count * 2){
+            capacity *= 2;
+        }
+        if(capacity > slots_.size()){
+            Rehash(capacity);
+        }
+    }
+
+    /* Вызывает fn(key, value) для каждого элемента в порядке слотов */
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        for(const Slot& slot : slots_){
+            if(slot.occupied){
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool occupied = false;
+    };
+
+    size_t GetHome(const Key& key) const {
+        return Hasher{}(key) & (slots_.size() - 1);
+    }
+
+    /* Слот с ключом key или первый свободный слот его цепочки */
+    size_t FindSlot(const Key& key) const {
+        const size_t mask = slots_.size() - 1;
+        size_t index = GetHome(key);
+        while(slots_[index].occupied && !(slots_[index].key == key)){
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void Rehash(size_t capacity) {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(slots_);
+        for(Slot& slot : old_slots){
+            if(slot.occupied){
+                slots_[FindSlot(slot.key)] = std::move(slot);
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+};
+
+}  // namespace util
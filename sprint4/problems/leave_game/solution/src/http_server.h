@@ -7,7 +7,11 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include "logger.h"
 
 namespace http_server {
@@ -17,12 +21,170 @@ using tcp = net::ip::tcp;
 namespace beast = boost::beast;
 namespace sys = boost::system;
 namespace http = beast::http;
+namespace websocket = beast::websocket;
 
 inline void ReportError(beast::error_code ec, std::string_view what){
     using namespace std::literals;
     LOG_ERROR(ec.value(), ec.message(), what);
 }
 
+/* ------------------------ WebSocketSession ----------------------------------- */
+
+/*
+    Соединение, переведённое в режим WebSocket.
+    Сервер только отправляет клиенту кадры, входящие сообщения игнорируются.
+
+    Методы Accept, Reject, Push и Close можно вызывать из любого потока:
+    вся работа с потоком выполняется в его собственном executor.
+    Если клиент не успевает принимать кадры, промежуточные кадры отбрасываются
+    и отправляется только самый свежий.
+*/
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    using Frame = std::shared_ptr<const std::string>;
+    using HttpRequest = http::request<http::string_body>;
+    using HttpResponse = http::response<http::string_body>;
+
+    explicit WebSocketSession(beast::tcp_stream&& stream)
+        : ws_(std::move(stream)) {
+    }
+
+    /* Завершает рукопожатие и начинает отправку кадров */
+    void Accept(HttpRequest&& request) {
+        net::dispatch(ws_.get_executor(), [self = shared_from_this(), request = std::move(request)]() mutable {
+            self->DoAccept(std::move(request));
+        });
+    }
+
+    /* Отклоняет запрос на переход в режим WebSocket обычным HTTP-ответом */
+    void Reject(HttpResponse&& response) {
+        net::dispatch(ws_.get_executor(), [self = shared_from_this(), response = std::move(response)]() mutable {
+            self->DoReject(std::move(response));
+        });
+    }
+
+    /* Ставит кадр в очередь на отправку, заменяя ещё не отправленный */
+    void Push(Frame frame) {
+        net::dispatch(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            self->pending_ = std::move(frame);
+            self->DoWrite();
+        });
+    }
+
+    void Close() {
+        net::dispatch(ws_.get_executor(), [self = shared_from_this()] {
+            self->DoClose();
+        });
+    }
+
+    /* Соединение закрыто, кадры больше не будут отправлены */
+    bool IsClosed() const {
+        return is_closed_;
+    }
+private:
+    void DoAccept(HttpRequest&& request) {
+        upgrade_request_ = std::move(request);
+        // На время рукопожатия и обмена кадрами таймауты задаёт сам websocket-поток
+        beast::get_lowest_layer(ws_).expires_never();
+        ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+        ws_.text(true);
+        ws_.async_accept(upgrade_request_, 
+                        beast::bind_front_handler(&WebSocketSession::OnAccept, shared_from_this()));
+    }
+
+    void OnAccept(beast::error_code ec) {
+        using namespace std::literals;
+        if (ec) {
+            is_closed_ = true;
+            return ReportError(ec, "websocket accept"sv);
+        }
+        is_open_ = true;
+        Read();
+        DoWrite();
+    }
+
+    void DoReject(HttpResponse&& response) {
+        auto safe_response = std::make_shared<HttpResponse>(std::move(response));
+        safe_response->keep_alive(false);
+        is_closed_ = true;
+        http::async_write(ws_.next_layer(), *safe_response,
+                          [safe_response, self = shared_from_this()](beast::error_code, std::size_t) {
+                              beast::error_code shutdown_ec;
+                              self->ws_.next_layer().socket().shutdown(tcp::socket::shutdown_send, shutdown_ec);
+                          });
+    }
+
+    void Read() {
+        // Входящие сообщения не нужны, но чтение обрабатывает ping и закрытие соединения клиентом
+        ws_.async_read(buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, shared_from_this()));
+    }
+
+    void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        using namespace std::literals;
+        if (ec) {
+            is_closed_ = true;
+            if (ec != websocket::error::closed) {
+                ReportError(ec, "websocket read"sv);
+            }
+            return;
+        }
+        buffer_.consume(buffer_.size());
+        Read();
+    }
+
+    void DoWrite() {
+        if (!is_open_ || is_closed_ || is_writing_ || !pending_) {
+            return;
+        }
+        is_writing_ = true;
+        writing_ = std::move(pending_);
+        pending_.reset();
+        ws_.async_write(net::buffer(*writing_), 
+                        beast::bind_front_handler(&WebSocketSession::OnWrite, shared_from_this()));
+    }
+
+    void OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+        using namespace std::literals;
+        is_writing_ = false;
+        writing_.reset();
+        if (ec) {
+            is_closed_ = true;
+            return ReportError(ec, "websocket write"sv);
+        }
+        DoWrite();
+    }
+
+    void DoClose() {
+        if (!is_open_ || is_closed_) {
+            is_closed_ = true;
+            return;
+        }
+        is_closed_ = true;
+        pending_.reset();
+        ws_.async_close(websocket::close_code::normal, [self = shared_from_this()](beast::error_code) {});
+    }
+
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer buffer_;
+    HttpRequest upgrade_request_;
+    // Самый свежий кадр, ожидающий отправки
+    Frame pending_;
+    // Кадр, который отправляется прямо сейчас
+    Frame writing_;
+    bool is_open_ = false;
+    bool is_writing_ = false;
+    std::atomic_bool is_closed_ = false;
+};
+
+/*
+    Обработчик запросов на переход в режим WebSocket.
+    Должен вызвать Accept или Reject у переданной сессии
+*/
+using UpgradeHandler = std::function<void(http::request<http::string_body>&& request, 
+                                            std::shared_ptr<WebSocketSession> ws_session)>;
+
+/* ------------------------ SessionBase ----------------------------------- */
+
 class SessionBase {
 public:
     // Запрещаем копирование и присваивание объектов SessionBase и его наследников
@@ -40,6 +202,9 @@ protected:
 
     explicit SessionBase(tcp::socket&& socket)
         : stream_(std::move(socket)) {
+        // Адрес клиента не меняется, поэтому запрашиваем его один раз на соединение
+        beast::error_code ec;
+        remote_address_ = stream_.socket().remote_endpoint(ec).address();
     }
 
     template <typename Body, typename Fields>
@@ -54,6 +219,11 @@ protected:
                           });
     }
 
+    /* Забирает поток у сессии, после этого сессия больше не читает запросы */
+    beast::tcp_stream ReleaseStream() {
+        return std::move(stream_);
+    }
+
     ~SessionBase() = default;
 private:
     void Read() {
@@ -77,10 +247,10 @@ private:
             LOG_ERROR(ec.value(), ec.message(), "read");
             return ReportError(ec, "read"sv);
         }
-        std::string ip(stream_.socket().remote_endpoint().address().to_string());
-        std::string url(request_.target());
-        std::string method(request_.method_string());
-        LOG_REQUEST_RECEIVED(ip, url, method);
+        is_logged_ = logger::ShouldLogRequest();
+        if (is_logged_) {
+            LOG_REQUEST_RECEIVED(remote_address_, request_.target(), request_.method_string());
+        }
         response_timer_.Start();
         HandleRequest(std::move(request_));
     }
@@ -97,9 +267,10 @@ private:
             // Семантика ответа требует закрыть соединение
             return Close();
         }
-        std::string ip(stream_.socket().remote_endpoint().address().to_string());
-        std::string content_type(safe_response->at(http::field::content_type));
-        LOG_RESPONSE_SENT(ip, response_timer_.End(), static_cast<int>(safe_response->result()), content_type);
+        if (is_logged_) {
+            LOG_RESPONSE_SENT(remote_address_, response_timer_.End(), static_cast<int>(safe_response->result()), 
+                                safe_response->at(http::field::content_type));
+        }
 
         // Считываем следующий запрос
         Read();
@@ -119,6 +290,9 @@ private:
     beast::tcp_stream stream_;
     beast::flat_buffer buffer_;
     HttpRequest request_;
+    net::ip::address remote_address_;
+    // Попал ли текущий запрос в выборку журнала
+    bool is_logged_ = true;
     logger::Timer response_timer_;
 };
 
@@ -126,12 +300,21 @@ template <typename RequestHandler>
 class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
+    Session(tcp::socket&& socket, Handler&& request_handler, UpgradeHandler upgrade_handler)
         : SessionBase(std::move(socket))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::move(upgrade_handler)) {
     }
 private:
     void HandleRequest(HttpRequest&& request) override {
+        // Запрос на переход в режим WebSocket: дальше соединением владеет WebSocketSession
+        if (upgrade_handler_ && websocket::is_upgrade(request)) {
+            auto ws_session = std::make_shared<WebSocketSession>(ReleaseStream());
+            upgrade_handler_(std::move(request), std::move(ws_session));
+            return;
+        }
+
+
         // Захватываем умный указатель на текущий объект Session в лямбде,
         // чтобы продлить время жизни сессии до вызова лямбды.
         // Используется generic-лямбда функция, способная принять response произвольного типа
@@ -145,17 +328,20 @@ private:
     }
 
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
 template <typename RequestHandler>
 class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, 
+            UpgradeHandler upgrade_handler)
         : ioc_(ioc)
         // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::move(upgrade_handler)) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
         acceptor_.open(endpoint.protocol());
 
@@ -208,21 +394,28 @@ private:
     }
 
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, upgrade_handler_)->Run();
     }
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
+/* 
+    Если upgrade_handler не задан, 
+    запросы на переход в режим WebSocket обрабатываются как обычные HTTP-запросы
+*/
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, 
+                UpgradeHandler upgrade_handler = {}) {
     // При помощи decay_t исключим ссылки из типа RequestHandler,
     // чтобы Listener хранил RequestHandler по значению
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), 
+                                std::move(upgrade_handler))->Run();
 }
 
 }  // namespace http_server
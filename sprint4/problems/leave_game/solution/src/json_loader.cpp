@@ -1,4 +1,5 @@
 #include "json_loader.h"
+#include "map_cache.h"
 
 #include <iostream>
 #include <fstream>
@@ -14,8 +15,8 @@ int GetInt(std::string key, const json::object& obj){
 }
 
 std::string GetString(std::string key, const json::object& obj){
-    std::string result = json::serialize(obj.at(key));
-    return result.substr(1, result.size() - 2);
+    const json::string& result = obj.at(key).as_string();
+    return std::string(result.data(), result.size());
 }
 
 void AddRoadsFromJson(const json::object& json_map, Map& map){
@@ -123,7 +124,7 @@ void AddMaps(const json::array& json_maps, Game& game){
     }
 }
 
-void LoadConfig(std::string json_str, Game& game){
+bool LoadConfig(std::string json_str, Game& game){
     try{
         json::object attributes = json::parse(json_str).as_object();
 
@@ -148,19 +149,36 @@ void LoadConfig(std::string json_str, Game& game){
         }
     } catch(std::exception& ex){
         std::cerr << ex.what() << std::endl;
+        return false;
     }
+    return true;
 }
 
-model::Game LoadGame(const std::filesystem::path& json_path) {
+model::Game LoadGame(const std::filesystem::path& json_path, const std::optional<std::filesystem::path>& cache_path) {
     // Загрузить содержимое файла json_path, например, в виде строки
     // Распарсить строку как JSON, используя boost::json::parse
     // Загрузить модель игры из файла
-    Game game;
-
     std::ifstream input_json(json_path);
     std::ostringstream json_stream;
     json_stream << input_json.rdbuf();
-    LoadConfig(json_stream.str(), game);
+    std::string json_str = json_stream.str();
+
+    /* Пока конфигурация не меняется, карты читаются из двоичного кэша без разбора JSON */
+    const uint32_t checksum = map_cache::GetSourceChecksum(json_str);
+    if(cache_path){
+        if(std::optional<Game> cached = map_cache::Load(*cache_path, checksum)){
+            return std::move(*cached);
+        }
+    }
+
+    Game game;
+    if(LoadConfig(std::move(json_str), game) && cache_path){
+        try{
+            map_cache::Save(*cache_path, game, checksum);
+        } catch(std::exception& ex){
+            std::cerr << "map cache: " << ex.what() << std::endl;
+        }
+    }
     return game;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <boost/json.hpp>
 #include <filesystem>
+#include <optional>
 #include "model.h"
 
 namespace json_loader {
@@ -20,10 +21,16 @@ void AddOfficesFromJson(const json::object& json_map, Map& map);
 
 void AddLootTypesFromJson(const json::object& json_map, Map& map);
 
-void LoadConfig(std::string json_str, Game& game);
+/* Возвращает false, если конфигурация прочитана не полностью */
+bool LoadConfig(std::string json_str, Game& game);
 
 void AddMaps(const json::array& json_maps, Game& game);
 
-model::Game LoadGame(const std::filesystem::path& json_path);
+/*
+    Загружает игру из json_path. Если указан cache_path, карты берутся из двоичного кэша,
+    собранного из того же содержимого json_path, а при его отсутствии кэш пересобирается
+*/
+model::Game LoadGame(const std::filesystem::path& json_path,
+                        const std::optional<std::filesystem::path>& cache_path = std::nullopt);
 
 }  // namespace json_loader
@@ -0,0 +1,105 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+
+namespace util {
+
+using namespace std::literals;
+
+JsonWriter& JsonWriter::Key(uint64_t key){
+    BeforeValue();
+    out_ += '"';
+    AppendInteger(key);
+    out_ += "\":"sv;
+    need_comma_ = false;
+    return *this;
+}
+
+void JsonWriter::AppendString(std::string_view str){
+    constexpr std::string_view HEX = "0123456789abcdef"sv;
+    out_ += '"';
+    for(char c : str){
+        switch(c){
+            case '"':
+                out_ += "\\\""sv;
+                break;
+            case '\\':
+                out_ += "\\\\"sv;
+                break;
+            case '\b':
+                out_ += "\\b"sv;
+                break;
+            case '\f':
+                out_ += "\\f"sv;
+                break;
+            case '\n':
+                out_ += "\\n"sv;
+                break;
+            case '\r':
+                out_ += "\\r"sv;
+                break;
+            case '\t':
+                out_ += "\\t"sv;
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20){
+                    out_ += "\\u00"sv;
+                    out_ += HEX[(c >> 4) & 0xF];
+                    out_ += HEX[c & 0xF];
+                } else {
+                    out_ += c;
+                }
+        }
+    }
+    out_ += '"';
+}
+
+void JsonWriter::AppendInteger(int64_t value){
+    char buffer[24];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, ptr);
+}
+
+void JsonWriter::AppendInteger(uint64_t value){
+    char buffer[24];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, ptr);
+}
+
+void JsonWriter::AppendDouble(double value){
+    /* Особые значения записываются так же, как в boost::json */
+    if(std::isnan(value)){
+        out_ += "NaN"sv;
+        return;
+    }
+    if(std::isinf(value)){
+        out_ += value < 0 ? "-Infinity"sv : "Infinity"sv;
+        return;
+    }
+
+    /* Кратчайшая точная запись: "1.04e+01" превращается в "1.04E1", как у boost::json */
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+    const std::string_view digits(buffer, end - buffer);
+    const size_t exp_pos = digits.find('e');
+    out_ += digits.substr(0, exp_pos);
+    out_ += 'E';
+
+    std::string_view exponent = digits.substr(exp_pos + 1);
+    if(exponent.front() == '-'){
+        out_ += '-';
+    }
+    exponent.remove_prefix(1);
+    while(exponent.size() > 1 && exponent.front() == '0'){
+        exponent.remove_prefix(1);
+    }
+    out_ += exponent;
+}
+
+std::string& GetScratchBuffer(){
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+
+}  // namespace util
@@ -0,0 +1,117 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+/*
+    Потоковая запись JSON в строку без промежуточного дерева документа.
+    Запятые между элементами расставляются сами, вложенность проверяет вызывающий код.
+    Вывод совпадает с boost::json::serialize: числа с плавающей точкой
+    записываются в экспоненциальной форме (1.5E0), целые - как есть
+*/
+class JsonWriter{
+public:
+    explicit JsonWriter(std::string& out)
+        : out_(out){
+    }
+
+    JsonWriter& StartObject(){
+        BeforeValue();
+        out_ += '{';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndObject(){
+        out_ += '}';
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& StartArray(){
+        BeforeValue();
+        out_ += '[';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndArray(){
+        out_ += ']';
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Key(std::string_view key){
+        BeforeValue();
+        AppendString(key);
+        out_ += ':';
+        need_comma_ = false;
+        return *this;
+    }
+
+    /* Числовой ключ, например идентификатор игрока: {"5":...} */
+    JsonWriter& Key(uint64_t key);
+
+    JsonWriter& String(std::string_view value){
+        BeforeValue();
+        AppendString(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    template <std::integral Integer>
+    JsonWriter& Number(Integer value){
+        BeforeValue();
+        AppendInteger(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Number(double value){
+        BeforeValue();
+        AppendDouble(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    /* Массив [x, y] из двух чисел с плавающей точкой */
+    JsonWriter& Pair(double x, double y){
+        return StartArray().Number(x).Number(y).EndArray();
+    }
+
+private:
+    void BeforeValue(){
+        if(need_comma_){
+            out_ += ',';
+        }
+    }
+
+    void AppendString(std::string_view str);
+    void AppendInteger(int64_t value);
+    void AppendInteger(uint64_t value);
+    void AppendDouble(double value);
+
+    template <std::signed_integral Integer>
+    void AppendInteger(Integer value){
+        AppendInteger(static_cast<int64_t>(value));
+    }
+
+    template <std::unsigned_integral Integer>
+    void AppendInteger(Integer value){
+        AppendInteger(static_cast<uint64_t>(value));
+    }
+
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+/*
+    Буфер потока для сборки ответов. Ёмкость буфера сохраняется между вызовами,
+    поэтому запись ответа не выделяет память, кроме копии готового результата
+*/
+std::string& GetScratchBuffer();
+
+}  // namespace util
@@ -0,0 +1,72 @@
+#include "leaderboard.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <tuple>
+
+namespace app{
+
+namespace{
+
+/* 
+    Время в том виде, в каком его прочитает pqxx из столбца real: Postgres хранит float
+    и выводит его кратчайшей точной записью (12.3), которая затем читается как double
+*/
+double RoundAsReal(double time){
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<float>(time));
+    double result = time;
+    std::from_chars(buffer, end, result);
+    return result;
+}
+
+} // namespace
+
+/* ------------------------ Leaderboard ----------------------------------- */
+
+bool Leaderboard::EntryLess::operator()(const Entry& lhs, const Entry& rhs) const{
+    return std::tie(rhs.record.score, lhs.record.time, lhs.record.name, lhs.id) 
+            < std::tie(lhs.record.score, rhs.record.time, rhs.record.name, rhs.id);
+}
+
+void Leaderboard::Add(const std::string& name, unsigned score, double time){
+    entries_.insert(Entry{{name, score, RoundAsReal(time)}, next_id_++});
+}
+
+std::vector<Leaderboard::Record> Leaderboard::GetPage(size_t start, size_t max_items) const{
+    std::vector<Record> page;
+    if(start >= entries_.size()){
+        return page;
+    }
+    page.reserve(std::min(max_items, entries_.size() - start));
+    ForEachOnPage(start, max_items, [&page](const Record& record){
+        page.push_back(record);
+    });
+    return page;
+}
+
+uint64_t Leaderboard::GetPageTag(size_t start, size_t max_items) const{
+    /* FNV-1a по содержимому записей страницы, из которого строится ответ */
+    uint64_t tag = 14695981039346656037ull;
+    auto mix = [&tag](uint64_t value){
+        tag ^= value;
+        tag *= 1099511628211ull;
+    };
+    mix(start);
+    mix(max_items);
+    ForEachOnPage(start, max_items, [&mix](const Record& record){
+        for(char c : record.name){
+            mix(static_cast<unsigned char>(c));
+        }
+        mix(record.name.size());
+        mix(record.score);
+        mix(std::bit_cast<uint64_t>(record.time));
+    });
+    return tag;
+}
+
+size_t Leaderboard::Size() const{
+    return entries_.size();
+}
+
+} // namespace app
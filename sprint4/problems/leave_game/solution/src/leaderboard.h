@@ -0,0 +1,68 @@
+#pragma once
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace app{
+
+/* ------------------------ Leaderboard ----------------------------------- */
+
+/*
+    Таблица рекордов в памяти, упорядоченная так же, как запрос к базе:
+    по убыванию очков, затем по возрастанию времени игры и имени.
+    Записи хранятся в дереве с порядковой статистикой, поэтому
+    страница из k записей, начиная с позиции start, выбирается за O(log n + k).
+    Не потокобезопасна: используется только в strand API
+*/
+class Leaderboard{
+public:
+    struct Record{
+        std::string name;
+        unsigned score;
+        double time;
+    };
+
+    void Add(const std::string& name, unsigned score, double time);
+
+    std::vector<Record> GetPage(size_t start, size_t max_items) const;
+
+    /* Обходит записи страницы без копирования */
+    template <typename Fn>
+    void ForEachOnPage(size_t start, size_t max_items, Fn&& fn) const{
+        if(start >= entries_.size()){
+            return;
+        }
+        size_t count = 0;
+        for(auto it = entries_.find_by_order(start); it != entries_.end() && count < max_items; ++it, ++count){
+            fn(it->record);
+        }
+    }
+
+    /* 
+        Метка содержимого страницы: хеш имён, очков и времени её записей.
+        Номера записей для метки не годятся: после перезапуска сервера они начинаются заново
+    */
+    uint64_t GetPageTag(size_t start, size_t max_items) const;
+
+    size_t Size() const;
+private:
+    struct Entry{
+        Record record;
+        /* Номер добавления различает одинаковые записи */
+        uint64_t id;
+    };
+
+    struct EntryLess{
+        bool operator()(const Entry& lhs, const Entry& rhs) const;
+    };
+
+    using Tree = __gnu_pbds::tree<Entry, __gnu_pbds::null_type, EntryLess, 
+                                    __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update>;
+
+    Tree entries_;
+    uint64_t next_id_ = 0;
+};
+
+} // namespace app
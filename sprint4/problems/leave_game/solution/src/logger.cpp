@@ -1,5 +1,6 @@
 #include "logger.h"
 #include <filesystem>
+#include <mutex>
 #include <sstream>
 
 using namespace std::literals;
@@ -11,6 +12,14 @@ std::ostream& operator<<(std::ostream& out, LOG_MESSAGES msg){
     return out;
 }
 
+namespace{
+
+using ConsoleSink = logging::sinks::synchronous_sink<logging::sinks::text_ostream_backend>;
+
+boost::shared_ptr<ConsoleSink> console_sink;
+
+}  // namespace
+
 BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", json::value)
 BOOST_LOG_ATTRIBUTE_KEYWORD(timestamp, "TimeStamp", boost::posix_time::ptime)
 
@@ -40,16 +49,63 @@ void FileConfig(){
 
 void ConsoleConfig(){
     logging::add_common_attributes();
-    logging::add_console_log( 
+    console_sink = logging::add_console_log( 
         std::clog,
         keywords::format = &JSONFormatter,
         keywords::auto_flush = true
     );
 }
 
+void WriteRequestLog(std::string_view batch){
+    if(console_sink){
+        /* Приёмник пишет свои записи под этой же блокировкой бэкенда */
+        auto backend = console_sink->locked_backend();
+        std::clog.write(batch.data(), batch.size());
+        std::clog.flush();
+        return;
+    }
+    static std::mutex mutex;
+    std::lock_guard lock{mutex};
+    std::clog.write(batch.data(), batch.size());
+    std::clog.flush();
+}
+
 void Log(const json::value& data, LOG_MESSAGES message){
     BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data)
                             << message;
 }
 
+bool ShouldLogRequest(){
+    AsyncLogger* async_logger = GetAsyncLogger();
+    return !async_logger || async_logger->ShouldSample();
+}
+
+void LogRequestReceived(const boost::asio::ip::address& ip, std::string_view url, std::string_view method){
+    if(AsyncLogger* async_logger = GetAsyncLogger()){
+        RequestLogRecord record;
+        record.kind = RequestLogRecord::Kind::REQUEST_RECEIVED;
+        record.timestamp = std::chrono::system_clock::now();
+        record.ip = ip;
+        record.url.Assign(url);
+        record.method.Assign(method);
+        return async_logger->Push(record);
+    }
+    Log({{"ip"s, ip.to_string()}, {"URL"s, url}, {"method", method}}, LOG_MESSAGES::REQUEST_RECEIVED);
+}
+
+void LogResponseSent(const boost::asio::ip::address& ip, size_t response_time, int code, std::string_view content_type){
+    if(AsyncLogger* async_logger = GetAsyncLogger()){
+        RequestLogRecord record;
+        record.kind = RequestLogRecord::Kind::RESPONSE_SENT;
+        record.timestamp = std::chrono::system_clock::now();
+        record.ip = ip;
+        record.response_time = response_time;
+        record.code = code;
+        record.content_type.Assign(content_type);
+        return async_logger->Push(record);
+    }
+    Log({{"ip"s, ip.to_string()}, {"response_time"s, response_time}, {"code"s, code}, {"content_type", content_type}}, 
+        LOG_MESSAGES::RESPONSE_SENT);
+}
+
 }; // namespace logger
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <boost/json.hpp>
 #include <unordered_map>
 #include <chrono>
+#include "async_logger.h"
 
 /* Запуск сервера */
 #define LOG_SERVER_START(port, address) \
@@ -19,13 +20,20 @@
 #define LOG_SERVER_EXIT(code, ...) \
         logger::Log({{"code"s, code} __VA_OPT__(, {"exception"s, __VA_ARGS__})}, logger::LOG_MESSAGES::SERVER_EXITED); 
 
-/* Получение запроса */
+/* 
+    Получение запроса и формирование ответа. 
+    Если включён асинхронный журнал, записи уходят в него,
+    а IP-адрес превращается в строку уже в фоновом потоке
+*/
 #define LOG_REQUEST_RECEIVED(ip, URL, method) \
-    logger::Log({{"ip"s, ip}, {"URL"s, URL}, {"method", method}}, logger::LOG_MESSAGES::REQUEST_RECEIVED);
+    logger::LogRequestReceived(ip, URL, method);
 
-/* Формирование ответа */
 #define LOG_RESPONSE_SENT(ip, response_time, code, content_type) \
-    logger::Log({{"ip"s, ip}, {"response_time"s, response_time}, {"code"s, code}, {"content_type", content_type}}, logger::LOG_MESSAGES::RESPONSE_SENT);
+    logger::LogResponseSent(ip, response_time, code, content_type);
+
+/* Запись снимка состояния игры: размер в байтах и время копирования и записи в микросекундах */
+#define LOG_STATE_SAVED(size, capture_time, write_time) \
+    logger::Log({{"size"s, size}, {"capture_time"s, capture_time}, {"write_time"s, write_time}}, logger::LOG_MESSAGES::STATE_SAVED);
 
 /* Возникновение ошибки */
 #define LOG_ERROR(code, text, where) \
@@ -43,6 +51,7 @@ enum class LOG_MESSAGES{
     SERVER_EXITED,
     REQUEST_RECEIVED,
     RESPONSE_SENT,
+    STATE_SAVED,
     ERROR
 };
 
@@ -67,6 +76,7 @@ static const std::unordered_map<LOG_MESSAGES, std::string> STR_MESSAGES {
     {LOG_MESSAGES::SERVER_EXITED, "server exited"},
     {LOG_MESSAGES::REQUEST_RECEIVED, "request received"},
     {LOG_MESSAGES::RESPONSE_SENT, "response sent"},
+    {LOG_MESSAGES::STATE_SAVED, "state saved"},
     {LOG_MESSAGES::ERROR, "error"},
 };
 
@@ -78,8 +88,21 @@ void FileConfig();
 
 void ConsoleConfig();
 
+/* 
+    Выводит пачку строк асинхронного журнала в консоль. Пачка пишется под блокировкой
+    консольного приёмника Boost.Log, поэтому не перемешивается с остальными записями
+*/
+void WriteRequestLog(std::string_view batch);
+
 void Log(const json::value& data, LOG_MESSAGES message);
 
+/* Нужно ли логировать очередной запрос и ответ на него */
+bool ShouldLogRequest();
+
+void LogRequestReceived(const boost::asio::ip::address& ip, std::string_view url, std::string_view method);
+
+void LogResponseSent(const boost::asio::ip::address& ip, size_t response_time, int code, std::string_view content_type);
+
 }; // namespace logger
 
 /* Настройка для вывода в консоль */
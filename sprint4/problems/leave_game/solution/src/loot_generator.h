@@ -38,6 +38,10 @@ public:
     TimeInterval GetPeriod() const{
         return base_interval_;
     }
+
+    double GetProbability() const{
+        return probability_;
+    }
 private:
     static double DefaultGenerator() noexcept {
         return 1.0;
@@ -2,11 +2,13 @@
 //
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <fstream>
 #include <thread>
 
 #include "json_loader.h"
 #include "request_handler.h"
 #include "http_server.h"
+#include "tracing.h"
 
 using namespace std::literals;
 namespace net = boost::asio;
@@ -28,6 +30,23 @@ void RunWorkers(unsigned n, const Fn& fn) {
     fn();
 }
 
+// Первый SIGUSR1 включает трассировку, следующий выключает её и записывает трассу в trace_file
+void WaitTraceSignal(net::signal_set& signals, const std::string& trace_file) {
+    signals.async_wait([&signals, &trace_file](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+        if (ec) {
+            return;
+        }
+        if (!tracing::IsEnabled()) {
+            tracing::Start();
+        } else {
+            tracing::Stop();
+            std::ofstream out(trace_file, std::ios::out | std::ios::binary | std::ios::trunc);
+            out << tracing::DumpChromeTrace();
+        }
+        WaitTraceSignal(signals, trace_file);
+    });
+}
+
 }  // namespace
 
 int main(int argc, const char* argv[]) {
@@ -51,11 +70,24 @@ int main(int argc, const char* argv[]) {
             throw std::runtime_error("GAME_DB_URL is not specified");
         }
         db_connection::CreateTable(DB_URL);
-        auto db_manager = std::make_unique<db_connection::DatabaseManager>(NUM_THREADS, DB_URL);
-
         const cmd_parser::Args& received_args = args.value();
+
+        // Ушедшие на покой игроки записываются в базу пачками в фоновом потоке.
+        // Оставшиеся в очереди записи дописываются при уничтожении db_manager
+        db_connection::WriteBehindOptions write_options;
+        write_options.batch_size = received_args.db_batch_size;
+        write_options.flush_interval = std::chrono::milliseconds(received_args.db_flush_interval);
+        auto db_manager = std::make_unique<db_connection::DatabaseManager>(NUM_THREADS, DB_URL, write_options);
+        // Запросы и ответы логируются асинхронно, записи дописываются при выходе из блока
+        logger::AsyncLogOptions log_options;
+        log_options.sample_rate = received_args.log_sample_rate;
+        log_options.overflow_policy = received_args.log_block_on_overflow 
+                                        ? logger::OverflowPolicy::BLOCK : logger::OverflowPolicy::DROP;
+        logger::AsyncLogging async_logging(log_options, logger::WriteRequestLog);
+
         // 1. Загружаем карту из файла и построить модель игры
-        model::Game game = json_loader::LoadGame(received_args.config_file);
+        model::Game game = json_loader::LoadGame(received_args.config_file, received_args.map_cache_file);
+        game.SetTickParallelism(received_args.tick_threads);
 
         // 2. Инициализируем io_context
         net::io_context ioc(NUM_THREADS);
@@ -69,6 +101,9 @@ int main(int argc, const char* argv[]) {
             }
         });   
 
+        net::signal_set trace_signals(ioc, SIGUSR1);
+        WaitTraceSignal(trace_signals, received_args.trace_file);
+
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры. 
         //    А также устанавливаем слушаетеля, который сохраняет (сериализует) состояние
         //    игры синхронно ходу игровым часам.
@@ -84,6 +119,8 @@ int main(int argc, const char* argv[]) {
         constexpr net::ip::port_type port = 8080;
         http_server::ServeHttp(ioc, {address, port}, [&handler](auto&& req, auto&& send) {
             (*handler)(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
+        }, [&handler](auto&& req, std::shared_ptr<http_server::WebSocketSession> ws_session) {
+            handler->Upgrade(std::forward<decltype(req)>(req), std::move(ws_session));
         });
         
 
@@ -0,0 +1,345 @@
+#include "map_cache.h"
+#include "binary_codec.h"
+#include "file_descriptor.h"
+#include <boost/crc.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace map_cache {
+
+using namespace std::literals;
+using namespace model;
+
+namespace {
+
+constexpr uint32_t CACHE_MAGIC = 0x434D5347;  // "GSMC"
+
+/*
+    Заголовок кэша. За ним идут данные игры в кодировке util::BinaryWriter:
+    настройки игры, затем карты с дорогами, зданиями, офисами и типами трофеев
+*/
+struct Header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t source_checksum;
+    uint32_t payload_checksum;
+    uint64_t payload_size;
+};
+
+/* Файл, отображённый в память только для чтения */
+class MappedFile{
+public:
+    explicit MappedFile(const std::filesystem::path& path)
+        : file_(path, O_RDONLY){
+        struct stat file_stat;
+        if(::fstat(file_.Get(), &file_stat) != 0){
+            throw std::system_error(errno, std::generic_category(), "fstat " + path.string());
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if(size_ != 0){
+            void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_.Get(), 0);
+            if(data == MAP_FAILED){
+                throw std::system_error(errno, std::generic_category(), "mmap " + path.string());
+            }
+            data_ = static_cast<const char*>(data);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile(){
+        if(data_ != nullptr){
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    std::string_view View() const noexcept{
+        return {data_, size_};
+    }
+
+private:
+    util::FileDescriptor file_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/* Какие необязательные поля типа трофея заданы */
+enum LootTypeField : uint8_t{
+    NAME = 1 << 0,
+    FILE = 1 << 1,
+    TYPE = 1 << 2,
+    ROTATION = 1 << 3,
+    COLOR = 1 << 4,
+    SCALE = 1 << 5,
+    VALUE = 1 << 6
+};
+
+template <typename Value>
+void PutOptional(util::BinaryWriter& writer, const std::optional<Value>& value){
+    if(value.has_value()){
+        writer.Put(*value);
+    }
+}
+
+template <typename Value>
+bool GetOptional(util::BinaryReader& reader, uint8_t fields, LootTypeField field, std::optional<Value>& value){
+    if((fields & field) == 0){
+        return true;
+    }
+    Value result;
+    if(!reader.Get(result)){
+        return false;
+    }
+    value = std::move(result);
+    return true;
+}
+
+void PutLootType(util::BinaryWriter& writer, const LootType& loot_type){
+    uint8_t fields = 0;
+    fields |= loot_type.name ? NAME : 0;
+    fields |= loot_type.file ? FILE : 0;
+    fields |= loot_type.type ? TYPE : 0;
+    fields |= loot_type.rotation ? ROTATION : 0;
+    fields |= loot_type.color ? COLOR : 0;
+    fields |= loot_type.scale ? SCALE : 0;
+    fields |= loot_type.value ? VALUE : 0;
+    writer.Put(fields);
+    PutOptional(writer, loot_type.name);
+    PutOptional(writer, loot_type.file);
+    PutOptional(writer, loot_type.type);
+    PutOptional(writer, loot_type.rotation);
+    PutOptional(writer, loot_type.color);
+    PutOptional(writer, loot_type.scale);
+    PutOptional(writer, loot_type.value);
+}
+
+bool GetLootType(util::BinaryReader& reader, LootType& loot_type){
+    uint8_t fields;
+    return reader.Get(fields)
+        && GetOptional(reader, fields, NAME, loot_type.name)
+        && GetOptional(reader, fields, FILE, loot_type.file)
+        && GetOptional(reader, fields, TYPE, loot_type.type)
+        && GetOptional(reader, fields, ROTATION, loot_type.rotation)
+        && GetOptional(reader, fields, COLOR, loot_type.color)
+        && GetOptional(reader, fields, SCALE, loot_type.scale)
+        && GetOptional(reader, fields, VALUE, loot_type.value);
+}
+
+void PutMap(util::BinaryWriter& writer, const Map& map){
+    writer.Put(*map.GetId());
+    writer.Put(map.GetName());
+    writer.Put(map.GetDogSpeed());
+    writer.Put(map.GetBagCapacity());
+
+    writer.Put(static_cast<uint32_t>(map.GetRoads().size()));
+    for(const Road& road : map.GetRoads()){
+        writer.Put(road.GetStart().x);
+        writer.Put(road.GetStart().y);
+        writer.Put(road.GetEnd().x);
+        writer.Put(road.GetEnd().y);
+    }
+
+    writer.Put(static_cast<uint32_t>(map.GetBuildings().size()));
+    for(const Building& building : map.GetBuildings()){
+        const Rectangle& bounds = building.GetBounds();
+        writer.Put(bounds.position.x);
+        writer.Put(bounds.position.y);
+        writer.Put(bounds.size.width);
+        writer.Put(bounds.size.height);
+    }
+
+    writer.Put(static_cast<uint32_t>(map.GetOffices().size()));
+    for(const Office& office : map.GetOffices()){
+        writer.Put(*office.GetId());
+        writer.Put(office.GetPosition().x);
+        writer.Put(office.GetPosition().y);
+        writer.Put(office.GetOffset().dx);
+        writer.Put(office.GetOffset().dy);
+    }
+
+    writer.Put(static_cast<uint32_t>(map.GetLootTypes().size()));
+    for(const LootType& loot_type : map.GetLootTypes()){
+        PutLootType(writer, loot_type);
+    }
+}
+
+std::optional<Map> GetMap(util::BinaryReader& reader){
+    std::string id;
+    std::string name;
+    double dog_speed;
+    unsigned bag_capacity;
+    if(!reader.Get(id) || !reader.Get(name) || !reader.Get(dog_speed) || !reader.Get(bag_capacity)){
+        return std::nullopt;
+    }
+    Map map{Map::Id{std::move(id)}, std::move(name)};
+    map.AddDogSpeed(dog_speed);
+    map.AddBagCapacity(bag_capacity);
+
+    uint32_t count;
+    if(!reader.Get(count)){
+        return std::nullopt;
+    }
+    for(uint32_t i = 0; i < count; ++i){
+        Point start;
+        Point end;
+        if(!reader.Get(start.x) || !reader.Get(start.y) || !reader.Get(end.x) || !reader.Get(end.y)){
+            return std::nullopt;
+        }
+        if(start.y == end.y){
+            map.AddRoad(Road{Road::HORIZONTAL, start, end.x});
+        } else {
+            map.AddRoad(Road{Road::VERTICAL, start, end.y});
+        }
+    }
+
+    if(!reader.Get(count)){
+        return std::nullopt;
+    }
+    for(uint32_t i = 0; i < count; ++i){
+        Rectangle bounds;
+        if(!reader.Get(bounds.position.x) || !reader.Get(bounds.position.y)
+            || !reader.Get(bounds.size.width) || !reader.Get(bounds.size.height)){
+            return std::nullopt;
+        }
+        map.AddBuilding(Building{bounds});
+    }
+
+    if(!reader.Get(count)){
+        return std::nullopt;
+    }
+    for(uint32_t i = 0; i < count; ++i){
+        std::string office_id;
+        Point position;
+        Offset offset;
+        if(!reader.Get(office_id) || !reader.Get(position.x) || !reader.Get(position.y)
+            || !reader.Get(offset.dx) || !reader.Get(offset.dy)){
+            return std::nullopt;
+        }
+        map.AddOffice(Office{Office::Id{std::move(office_id)}, position, offset});
+    }
+
+    if(!reader.Get(count)){
+        return std::nullopt;
+    }
+    for(uint32_t i = 0; i < count; ++i){
+        LootType loot_type;
+        if(!GetLootType(reader, loot_type)){
+            return std::nullopt;
+        }
+        map.AddLootType(std::move(loot_type));
+    }
+    return map;
+}
+
+std::optional<Game> GetGame(util::BinaryReader& reader){
+    Game game;
+    double default_dog_speed;
+    unsigned default_bag_capacity;
+    unsigned dog_retirement_time;
+    uint8_t has_loot_generator;
+    if(!reader.Get(default_dog_speed) || !reader.Get(default_bag_capacity)
+        || !reader.Get(dog_retirement_time) || !reader.Get(has_loot_generator)){
+        return std::nullopt;
+    }
+    game.SetDefaultDogSpeed(default_dog_speed);
+    game.SetDefaultBagCapacity(default_bag_capacity);
+    game.SetDogRetirementTime(dog_retirement_time);
+    if(has_loot_generator != 0){
+        int64_t period;
+        double probability;
+        if(!reader.Get(period) || !reader.Get(probability)){
+            return std::nullopt;
+        }
+        game.SetLootGenerator(static_cast<double>(period), probability);
+    }
+
+    uint32_t map_count;
+    if(!reader.Get(map_count)){
+        return std::nullopt;
+    }
+    for(uint32_t i = 0; i < map_count; ++i){
+        std::optional<Map> map = GetMap(reader);
+        if(!map){
+            return std::nullopt;
+        }
+        game.AddMap(std::move(*map));
+    }
+    if(!reader.IsEmpty()){
+        return std::nullopt;
+    }
+    return game;
+}
+
+uint32_t Checksum(std::string_view data){
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+}  // namespace
+
+uint32_t GetSourceChecksum(std::string_view source){
+    return Checksum(source);
+}
+
+std::optional<Game> Load(const std::filesystem::path& cache_path, uint32_t source_checksum){
+    std::error_code ec;
+    if(!std::filesystem::exists(cache_path, ec)){
+        return std::nullopt;
+    }
+    try{
+        MappedFile file(cache_path);
+        std::string_view data = file.View();
+        Header header;
+        if(data.size() < sizeof(header)){
+            return std::nullopt;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        data.remove_prefix(sizeof(header));
+        if(header.magic != CACHE_MAGIC || header.version != CACHE_VERSION
+            || header.source_checksum != source_checksum || header.payload_size != data.size()
+            || Checksum(data) != header.payload_checksum){
+            return std::nullopt;
+        }
+
+        util::BinaryReader reader(data);
+        return GetGame(reader);
+    } catch(const std::exception&){
+        /* Повреждённый кэш просто пересобирается из JSON */
+        return std::nullopt;
+    }
+}
+
+void Save(const std::filesystem::path& cache_path, const Game& game, uint32_t source_checksum){
+    std::string data(sizeof(Header), '\0');
+    util::BinaryWriter writer(data);
+    writer.Put(game.GetDefaultDogSpeed());
+    writer.Put(game.GetDefaultBagCapacity());
+    writer.Put(game.GetDogRetirementTime());
+    const auto& loot_generator = game.GetLootGenerator();
+    writer.Put(static_cast<uint8_t>(loot_generator.has_value()));
+    if(loot_generator.has_value()){
+        writer.Put(static_cast<int64_t>(loot_generator->GetPeriod().count()));
+        writer.Put(loot_generator->GetProbability());
+    }
+    writer.Put(static_cast<uint32_t>(game.GetMaps().size()));
+    for(const Map& map : game.GetMaps()){
+        PutMap(writer, map);
+    }
+
+    const std::string_view payload = std::string_view(data).substr(sizeof(Header));
+    const Header header{CACHE_MAGIC, CACHE_VERSION, source_checksum, Checksum(payload), payload.size()};
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    std::filesystem::path temp_path = cache_path;
+    temp_path += ".tmp"s;
+    {
+        util::FileDescriptor file(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        file.Write(data);
+        file.Sync();
+    }
+    std::filesystem::rename(temp_path, cache_path);
+}
+
+}  // namespace map_cache
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include "model.h"
+
+namespace map_cache {
+
+/* Увеличивается при любом изменении формата кэша: кэш другой версии пересобирается из JSON */
+inline constexpr uint32_t CACHE_VERSION = 1;
+
+/* Контрольная сумма содержимого файла конфигурации, по ней кэш сверяется с исходным JSON */
+uint32_t GetSourceChecksum(std::string_view source);
+
+/*
+    Читает игру из двоичного кэша, отображённого в память.
+    Возвращает nullopt, если кэша нет, он другой версии, собран из другого JSON
+    или не прошёл проверку целостности
+*/
+std::optional<model::Game> Load(const std::filesystem::path& cache_path, uint32_t source_checksum);
+
+/*
+    Записывает карты и настройки игры в кэш. Файл заменяется атомарно,
+    поэтому прерванная запись не оставляет повреждённого кэша
+*/
+void Save(const std::filesystem::path& cache_path, const model::Game& game, uint32_t source_checksum);
+
+}  // namespace map_cache
@@ -0,0 +1,231 @@
+#include "metrics.h"
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace metrics {
+
+using namespace std::literals;
+
+namespace detail {
+
+size_t GetShardIndex(){
+    static std::atomic<size_t> next_index{0};
+    thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return index;
+}
+
+}  // namespace detail
+
+namespace {
+
+void AppendNumber(std::string& out, double value){
+    if(std::isinf(value)){
+        out += value > 0 ? "+Inf"sv : "-Inf"sv;
+        return;
+    }
+    if(std::isnan(value)){
+        out += "NaN"sv;
+        return;
+    }
+    char buffer[32];
+    /* Целые значения счётчиков выводятся без экспоненты */
+    auto [ptr, ec] = std::trunc(value) == value && std::abs(value) < 1e15
+        ? std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(value))
+        : std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ptr);
+}
+
+/* Экранирование значения метки: обратная косая черта, кавычка и перевод строки */
+void AppendLabelValue(std::string& out, std::string_view value){
+    for(char c : value){
+        switch(c){
+            case '\\':
+                out += "\\\\"sv;
+                break;
+            case '"':
+                out += "\\\""sv;
+                break;
+            case '\n':
+                out += "\\n"sv;
+                break;
+            default:
+                out += c;
+        }
+    }
+}
+
+void AppendLabel(std::string& out, bool& is_first, std::string_view name, std::string_view value){
+    out += is_first ? '{' : ',';
+    is_first = false;
+    out += name;
+    out += "=\""sv;
+    AppendLabelValue(out, value);
+    out += '"';
+}
+
+}  // namespace
+
+/* ------------------------ Counter ----------------------------------- */
+
+uint64_t Counter::GetValue() const{
+    uint64_t value = 0;
+    for(const detail::CounterShard& shard : shards_){
+        value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+/* ------------------------ Histogram ----------------------------------- */
+
+Histogram::Histogram(Buckets bounds)
+    : bounds_(std::move(bounds)){
+    std::sort(bounds_.begin(), bounds_.end());
+    for(Shard& shard : shards_){
+        shard.counts = std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1);
+    }
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const{
+    Snapshot snapshot;
+    snapshot.counts.resize(bounds_.size() + 1);
+    for(const Shard& shard : shards_){
+        for(size_t i = 0; i < snapshot.counts.size(); ++i){
+            snapshot.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    for(uint64_t count : snapshot.counts){
+        snapshot.count += count;
+    }
+    return snapshot;
+}
+
+/* ------------------------ Family ----------------------------------- */
+
+void FamilyBase::RenderHeader(std::string& out, std::string_view type) const{
+    out += "# HELP "sv;
+    out += name_;
+    out += ' ';
+    out += help_;
+    out += "\n# TYPE "sv;
+    out += name_;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void FamilyBase::RenderSample(std::string& out, std::string_view suffix, const LabelValues& values,
+                                double value, std::string_view extra_label, std::string_view extra_value) const{
+    out += name_;
+    out += suffix;
+    bool is_first = true;
+    for(size_t i = 0; i < values.size() && i < label_names_.size(); ++i){
+        AppendLabel(out, is_first, label_names_[i], values[i]);
+    }
+    if(!extra_label.empty()){
+        AppendLabel(out, is_first, extra_label, extra_value);
+    }
+    if(!is_first){
+        out += '}';
+    }
+    out += ' ';
+    AppendNumber(out, value);
+    out += '\n';
+}
+
+template <>
+void Family<Counter>::Render(std::string& out) const{
+    RenderHeader(out, "counter"sv);
+    std::shared_lock lock{mutex_};
+    for(const auto& [values, counter] : metrics_){
+        RenderSample(out, ""sv, values, static_cast<double>(counter->GetValue()));
+    }
+}
+
+template <>
+void Family<Gauge>::Render(std::string& out) const{
+    RenderHeader(out, "gauge"sv);
+    std::shared_lock lock{mutex_};
+    for(const auto& [values, gauge] : metrics_){
+        RenderSample(out, ""sv, values, gauge->GetValue());
+    }
+}
+
+template <>
+void Family<Histogram>::Render(std::string& out) const{
+    RenderHeader(out, "histogram"sv);
+    std::shared_lock lock{mutex_};
+    for(const auto& [values, histogram] : metrics_){
+        const Histogram::Snapshot snapshot = histogram->GetSnapshot();
+        const Histogram::Buckets& bounds = histogram->GetBounds();
+
+        /* Корзины в формате Prometheus накопительные */
+        uint64_t cumulative = 0;
+        std::string bound;
+        for(size_t i = 0; i < snapshot.counts.size(); ++i){
+            cumulative += snapshot.counts[i];
+            bound.clear();
+            AppendNumber(bound, i < bounds.size() ? bounds[i] : INFINITY);
+            RenderSample(out, "_bucket"sv, values, static_cast<double>(cumulative), "le"sv, bound);
+        }
+        RenderSample(out, "_sum"sv, values, snapshot.sum);
+        RenderSample(out, "_count"sv, values, static_cast<double>(snapshot.count));
+    }
+}
+
+/* ------------------------ Registry ----------------------------------- */
+
+template <typename Metric>
+Family<Metric>& Registry::Add(std::string name, std::string help, std::vector<std::string> label_names,
+                                typename Family<Metric>::Factory factory){
+    std::lock_guard lock{mutex_};
+    for(const auto& family : families_){
+        if(family->GetName() == name){
+            if(auto typed_family = dynamic_cast<Family<Metric>*>(family.get())){
+                return *typed_family;
+            }
+            throw std::logic_error("Metric "s + name + " is already registered with another type"s);
+        }
+    }
+    auto family = std::make_unique<Family<Metric>>(std::move(name), std::move(help),
+                                                    std::move(label_names), std::move(factory));
+    Family<Metric>& result = *family;
+    families_.push_back(std::move(family));
+    return result;
+}
+
+Family<Counter>& Registry::AddCounter(std::string name, std::string help, std::vector<std::string> label_names){
+    return Add<Counter>(std::move(name), std::move(help), std::move(label_names), []{
+        return std::make_unique<Counter>();
+    });
+}
+
+Family<Gauge>& Registry::AddGauge(std::string name, std::string help, std::vector<std::string> label_names){
+    return Add<Gauge>(std::move(name), std::move(help), std::move(label_names), []{
+        return std::make_unique<Gauge>();
+    });
+}
+
+Family<Histogram>& Registry::AddHistogram(std::string name, std::string help, std::vector<std::string> label_names,
+                                            Histogram::Buckets buckets){
+    return Add<Histogram>(std::move(name), std::move(help), std::move(label_names), [buckets = std::move(buckets)]{
+        return std::make_unique<Histogram>(buckets);
+    });
+}
+
+std::string Registry::Render() const{
+    std::string out;
+    std::lock_guard lock{mutex_};
+    for(const auto& family : families_){
+        family->Render(out);
+    }
+    return out;
+}
+
+Registry& GetRegistry(){
+    static Registry registry;
+    return registry;
+}
+
+}  // namespace metrics
@@ -0,0 +1,270 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metrics {
+
+namespace detail {
+
+/*
+    Число ячеек, по которым раскладываются обновления метрик.
+    Каждый поток пишет в свою ячейку, поэтому потоки не борются за одну линию кэша
+*/
+inline constexpr size_t SHARD_COUNT = 16;
+
+/* Номер ячейки текущего потока. Номера раздаются потокам по кругу при первом обращении */
+size_t GetShardIndex();
+
+struct alignas(64) CounterShard{
+    std::atomic<uint64_t> value{0};
+};
+
+}  // namespace detail
+
+/* ------------------------ Counter ----------------------------------- */
+
+/* Монотонно растущий счётчик */
+class Counter{
+public:
+    void Increment(uint64_t value = 1){
+        shards_[detail::GetShardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t GetValue() const;
+
+private:
+    std::array<detail::CounterShard, detail::SHARD_COUNT> shards_;
+};
+
+/* ------------------------ Gauge ----------------------------------- */
+
+/* Текущее значение величины, например число игроков */
+class Gauge{
+public:
+    void Set(double value){
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void Add(double delta){
+        value_.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    double GetValue() const{
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> value_{0};
+};
+
+/* ------------------------ Histogram ----------------------------------- */
+
+/*
+    Гистограмма с фиксированными границами корзин.
+    Значение попадает в первую корзину, верхняя граница которой не меньше значения,
+    значения больше последней границы - в корзину +Inf
+*/
+class Histogram{
+public:
+    /* Верхние границы корзин по возрастанию */
+    using Buckets = std::vector<double>;
+
+    struct Snapshot{
+        /* Число значений в каждой корзине, последняя - +Inf */
+        std::vector<uint64_t> counts;
+        double sum = 0;
+        uint64_t count = 0;
+    };
+
+    explicit Histogram(Buckets bounds);
+
+    void Observe(double value){
+        const size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+        Shard& shard = shards_[detail::GetShardIndex()];
+        shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /* Длительности записываются в секундах */
+    template <typename Rep, typename Period>
+    void Observe(std::chrono::duration<Rep, Period> duration){
+        Observe(std::chrono::duration<double>(duration).count());
+    }
+
+    const Buckets& GetBounds() const noexcept{
+        return bounds_;
+    }
+
+    Snapshot GetSnapshot() const;
+
+private:
+    struct alignas(64) Shard{
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::atomic<double> sum{0};
+    };
+
+    Buckets bounds_;
+    std::array<Shard, detail::SHARD_COUNT> shards_;
+};
+
+/* Границы корзин для длительностей в секундах: от 100 мкс до 10 с */
+inline const Histogram::Buckets LATENCY_BUCKETS{
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+/* Записывает в гистограмму время жизни объекта */
+class ScopedTimer{
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram){
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer(){
+        histogram_.Observe(std::chrono::steady_clock::now() - start_);
+    }
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+/* ------------------------ Family ----------------------------------- */
+
+/* Семейство метрик одного имени, различающихся значениями меток */
+class FamilyBase{
+public:
+    FamilyBase(std::string name, std::string help, std::vector<std::string> label_names)
+        : name_(std::move(name))
+        , help_(std::move(help))
+        , label_names_(std::move(label_names)){
+    }
+
+    virtual ~FamilyBase() = default;
+
+    const std::string& GetName() const noexcept{
+        return name_;
+    }
+
+    /* Дописывает семейство в out в текстовом формате Prometheus */
+    virtual void Render(std::string& out) const = 0;
+
+protected:
+    using LabelValues = std::vector<std::string>;
+
+    /* Сравнивает наборы значений меток разных типов, чтобы искать метрику без копирования значений */
+    struct LabelValuesLess{
+        using is_transparent = void;
+
+        template <typename Lhs, typename Rhs>
+        bool operator()(const Lhs& lhs, const Rhs& rhs) const{
+            return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                [](std::string_view a, std::string_view b){
+                    return a < b;
+                });
+        }
+    };
+
+    void RenderHeader(std::string& out, std::string_view type) const;
+
+    /* Дописывает строку "<name><suffix>{labels} value" */
+    void RenderSample(std::string& out, std::string_view suffix, const LabelValues& values,
+                        double value, std::string_view extra_label = {}, std::string_view extra_value = {}) const;
+
+    std::string name_;
+    std::string help_;
+    std::vector<std::string> label_names_;
+};
+
+/*
+    Метрики создаются при первом обращении с новым набором значений меток и живут до конца работы.
+    Поиск существующей метрики берёт разделяемую блокировку и не выделяет память,
+    а ссылку на метрику можно сохранить и обновлять её без поиска
+*/
+template <typename Metric>
+class Family : public FamilyBase{
+public:
+    using Factory = std::function<std::unique_ptr<Metric>()>;
+
+    Family(std::string name, std::string help, std::vector<std::string> label_names, Factory factory)
+        : FamilyBase(std::move(name), std::move(help), std::move(label_names))
+        , factory_(std::move(factory)){
+    }
+
+    /* Значения перечисляются в порядке имён меток семейства */
+    Metric& WithLabels(std::initializer_list<std::string_view> values){
+        {
+            std::shared_lock lock{mutex_};
+            if(auto it = metrics_.find(values); it != metrics_.end()){
+                return *it->second;
+            }
+        }
+        std::lock_guard lock{mutex_};
+        auto [it, inserted] = metrics_.try_emplace(LabelValues(values.begin(), values.end()));
+        if(inserted){
+            it->second = factory_();
+        }
+        return *it->second;
+    }
+
+    void Render(std::string& out) const override;
+
+private:
+    Factory factory_;
+    mutable std::shared_mutex mutex_;
+    std::map<LabelValues, std::unique_ptr<Metric>, LabelValuesLess> metrics_;
+};
+
+template <>
+void Family<Counter>::Render(std::string& out) const;
+
+template <>
+void Family<Gauge>::Render(std::string& out) const;
+
+template <>
+void Family<Histogram>::Render(std::string& out) const;
+
+/* ------------------------ Registry ----------------------------------- */
+
+/*
+    Реестр метрик сервера. Семейства регистрируются по имени один раз:
+    повторная регистрация возвращает уже существующее семейство
+*/
+class Registry{
+public:
+    Family<Counter>& AddCounter(std::string name, std::string help, std::vector<std::string> label_names = {});
+
+    Family<Gauge>& AddGauge(std::string name, std::string help, std::vector<std::string> label_names = {});
+
+    Family<Histogram>& AddHistogram(std::string name, std::string help, std::vector<std::string> label_names = {},
+                                    Histogram::Buckets buckets = LATENCY_BUCKETS);
+
+    /* Все метрики в текстовом формате Prometheus (text/plain; version=0.0.4) */
+    std::string Render() const;
+
+private:
+    template <typename Metric>
+    Family<Metric>& Add(std::string name, std::string help, std::vector<std::string> label_names,
+                        typename Family<Metric>::Factory factory);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<FamilyBase>> families_;
+};
+
+/* Реестр, который отдаётся по адресу /metrics */
+Registry& GetRegistry();
+
+}  // namespace metrics
@@ -1,4 +1,5 @@
 #include "model.h"
+#include "tracing.h"
 
 #include <stdexcept>
 #include <set>
@@ -50,8 +51,9 @@ private:
     Dogs dogs_;
 };
 
-ObjectsAndDogsProvider::Objects MakeLoot(const std::list<Loot>& loots){
+ObjectsAndDogsProvider::Objects MakeLoot(const GameSession::LootObjects& loots){
     ObjectsAndDogsProvider::Objects result;
+    result.reserve(loots.size());
 
     for(const Loot& loot : loots){
         result.emplace_back(loot.pos, LOOT_WIDTH);
@@ -62,6 +64,7 @@ ObjectsAndDogsProvider::Objects MakeLoot(const std::list<Loot>& loots){
 
 ObjectsAndDogsProvider::Objects MakeOffices(const std::deque<Office>& offices){
     ObjectsAndDogsProvider::Objects result;
+    result.reserve(offices.size());
 
     for(const Office& office : offices){
         Point2D pos = {
@@ -74,8 +77,9 @@ ObjectsAndDogsProvider::Objects MakeOffices(const std::deque<Office>& offices){
     return result;
 }
 
-ObjectsAndDogsProvider::Dogs MakeDogs(const std::list<Dog>& dogs, double delta){
+ObjectsAndDogsProvider::Dogs MakeDogs(const GameSession::Dogs& dogs, double delta){
     ObjectsAndDogsProvider::Dogs result;
+    result.reserve(dogs.size());
 
     for(const Dog& dog : dogs){
         PairDouble speed = *(dog.GetSpeed());
@@ -123,6 +127,11 @@ std::vector<Event> MixEvents(std::vector<GatheringEvent> collectings, std::vecto
     return result;
 }
 
+/* Атрибуты отрезка трассы для работы с сессией */
+tracing::SpanArgs GetSpanArgs(const GameSession& session){
+    return tracing::SpanArgs{*session.GetMap()->GetId(), session.GetId()};
+}
+
 } // namespace detail
 
 /* ------------------------ Map ----------------------------------- */
@@ -156,21 +165,26 @@ unsigned Map::GetRandomLootType() const{
 }
 
 void Map::AddRoad(const Road& road) {
-    const Road& added_road = roads_.emplace_back(road);
+    roads_.emplace_back(road);
+}
 
-    if(added_road.IsVertical()){
-        road_map_[Map::RoadTag::VERTICAL].insert({road.GetStart().x, added_road});
-    } else{
-        road_map_[Map::RoadTag::HORIZONTAl].insert({road.GetStart().y, added_road});
+void Map::BuildWalkableIndex(){
+    std::vector<WalkableIndex::Area> areas;
+    areas.reserve(roads_.size());
+    for(const Road& road : roads_){
+        Point start = road.GetStart();
+        Point end = road.GetEnd();
+        if(road.IsInvert()){
+            std::swap(start, end);
+        }
+        areas.push_back({start.x - ROAD_HALF_WIDTH, start.y - ROAD_HALF_WIDTH, 
+                            end.x + ROAD_HALF_WIDTH, end.y + ROAD_HALF_WIDTH});
     }
+    walkable_index_ = WalkableIndex(std::move(areas));
 }
 
-std::vector<const Road*> Map::FindRoadsByCoords(const Dog::Position& pos) const{
-    std::vector<const Road*> result;
-    FindInVerticals(pos, result);
-    FindInHorizontals(pos, result);
-
-    return result;
+const WalkableIndex& Map::GetWalkableIndex() const noexcept{
+    return walkable_index_;
 }
 
 void Map::AddBuilding(const Building& building) {
@@ -234,122 +248,151 @@ PairDouble Map::GetRandomPos(const model::Map::Roads& roads){
     return {x,y};
 }
 
-void Map::FindInVerticals(const Dog::Position& pos, std::vector<const Road*>& roads) const{
-    const auto& v_roads = road_map_.at(Map::RoadTag::VERTICAL);
-    ConstRoadIt it_x = v_roads.lower_bound((*pos).x);          /* Ищем ближайшую дорогу по полученной координате */
-
-    if(it_x != v_roads.end()){                 
-        if(it_x != v_roads.begin()){                   /* Если ближайшая дорога не является первой, то нужно проверить предыдущую */
-            ConstRoadIt prev_it_x = std::prev(it_x, 1);
-            if(CheckBounds(prev_it_x, pos)){
-                roads.push_back(&prev_it_x->second);
-            }
-        }
-
-        if(CheckBounds(it_x, pos)){                     /* Проверяем ближайшую дорогу */
-            roads.push_back(&it_x->second);
-        }
-    } else {                                            /* Если дорога не найдена, то полученная координата дальше всех дорог*/
-        it_x = std::prev(v_roads.end(), 1);            /* Тогда проверяем последнюю дорогу */
-        if(CheckBounds(it_x, pos)){
-            roads.push_back(&it_x->second);
-        }
-    }
-}
-
-void Map::FindInHorizontals(const Dog::Position& pos, std::vector<const Road*>& roads) const{
-    const auto& h_roads = road_map_.at(Map::RoadTag::HORIZONTAl);
-    ConstRoadIt it_y = h_roads.lower_bound((*pos).y);          /* Ищем ближайшую дорогу по полученной координате */
-
-    if(it_y != h_roads.end()){                 
-        if(it_y != h_roads.begin()){                   /* Если ближайшая дорога не является первой, то нужно проверить предыдущую */
-            ConstRoadIt prev_it_y = std::prev(it_y, 1);
-            if(CheckBounds(prev_it_y, pos)){
-                roads.push_back(&prev_it_y->second);
-            }
-        }
+/* ------------------------ GameSession ----------------------------------- */
 
-        if(CheckBounds(it_y, pos)){                     /* Проверяем ближайшую дорогу */
-            roads.push_back(&it_y->second);
-        }
-    } else {                                            /* Если дорога не найдена, то полученная координата дальше всех дорог*/
-        it_y = std::prev(h_roads.end(), 1);            /* Тогда проверяем последнюю дорогу */
-        if(CheckBounds(it_y, pos)){
-            roads.push_back(&it_y->second);
-        }
-    }
+GameSession::DogHandle GameSession::AddDog(int id, const Dog::Name& name, 
+                    const Dog::Position& pos, const Dog::Speed& vel, 
+                    Direction dir){
+    MarkChanged();
+    RecordChange(ChangeJournal::Object::DOG, ChangeJournal::Change::UPSERT, id);
+    return dogs_.Emplace(id, name, pos, vel, dir);
 }
 
-bool Map::CheckBounds(ConstRoadIt it, const Dog::Position& pos) const{
-    Point start = it->second.GetStart();
-    Point end = it->second.GetEnd();
-    if(it->second.IsInvert()){
-        std::swap(start, end);
-    }
-    return ((start.x - 0.4 <= (*pos).x && (*pos).x <= end.x + 0.4) && 
-                (start.y - 0.4 <= (*pos).y && (*pos).y <= end.y + 0.4));
+GameSession::DogHandle GameSession::AddCreatedDog(Dog new_dog){
+    MarkChanged();
+    RecordChange(ChangeJournal::Object::DOG, ChangeJournal::Change::UPSERT, new_dog.GetId());
+    return dogs_.Emplace(std::move(new_dog));
 }
-/* ------------------------ GameSession ----------------------------------- */
 
-Dog* GameSession::AddDog(int id, const Dog::Name& name, 
-                    const Dog::Position& pos, const Dog::Speed& vel, 
-                    Direction dir){
-    dogs_.emplace_back(id, name, pos, vel, dir);
-    return &dogs_.back();
+Dog* GameSession::FindDog(DogHandle handle){
+    return dogs_.Find(handle);
 }
 
-Dog* GameSession::AddCreatedDog(Dog new_dog){
-    dogs_.emplace_back(std::move(new_dog));
-    return &dogs_.back();
+const Dog* GameSession::FindDog(DogHandle handle) const{
+    return dogs_.Find(handle);
 }
 
 const Map* GameSession::GetMap() const {
     return map_;
 }
 
-std::list<Dog>& GameSession::GetDogs(){
+GameSession::Dogs& GameSession::GetDogs(){
     return dogs_;
 }
 
-const std::list<Dog>& GameSession::GetDogs() const{
-    return static_cast<const std::list<Dog>&>(dogs_);
+const GameSession::Dogs& GameSession::GetDogs() const{
+    return dogs_;
 }
 
-void GameSession::UpdateLoot(unsigned loot_count){
+std::vector<GameSession::LootDraw> GameSession::DrawLoot(unsigned loot_count) const{
+    std::vector<LootDraw> draws;
+    draws.reserve(loot_count);
     for(unsigned i = 0; i < loot_count; ++i){
         unsigned type = map_->GetRandomLootType();
-        PairDouble pos = Map::GetRandomPos(map_->GetRoads());
+        draws.push_back({type, Map::GetRandomPos(map_->GetRoads())});
+    }
+    return draws;
+}
+
+void GameSession::PlaceLoot(const std::vector<LootDraw>& draws){
+    if(!draws.empty()){
+        MarkChanged();
+    }
+    for(const auto& [type, pos] : draws){
         unsigned value = 1;
 
         const LootType& loot_type = map_->GetLootTypes().at(type);
         if(loot_type.value.has_value()){
             value = map_->GetLootTypes().at(type).value.value();
         }
-        loot_.emplace_back(++auto_loot_counter_, type, value, pos);
+        loot_.Emplace(++auto_loot_counter_, type, value, pos);
+        RecordChange(ChangeJournal::Object::LOOT, ChangeJournal::Change::UPSERT, auto_loot_counter_);
+    }
+}
+
+void GameSession::UpdateLoot(unsigned loot_count){
+    PlaceLoot(DrawLoot(loot_count));
+}
+
+void GameSession::SetLootObjects(const std::list<Loot>& new_loot){
+    MarkChanged();
+    for(const Loot& loot : loot_){
+        RecordChange(ChangeJournal::Object::LOOT, ChangeJournal::Change::REMOVE, loot.id);
+    }
+    loot_.Clear();
+    for(const Loot& loot : new_loot){
+        loot_.Emplace(loot);
+        RecordChange(ChangeJournal::Object::LOOT, ChangeJournal::Change::UPSERT, loot.id);
+        auto_loot_counter_ = std::max(auto_loot_counter_, loot.id);
     }
 }
 
-void GameSession::SetLootObjects(std::list<Loot> new_loot){
-    loot_ = std::move(new_loot);
+void GameSession::AddLoot(const Loot& loot){
+    MarkChanged();
+    loot_.Emplace(loot);
+    RecordChange(ChangeJournal::Object::LOOT, ChangeJournal::Change::UPSERT, loot.id);
+    auto_loot_counter_ = std::max(auto_loot_counter_, loot.id);
 }
 
-const std::list<Loot>& GameSession::GetLootObjects() const{
+unsigned GameSession::GetLastLootId() const{
+    return auto_loot_counter_;
+}
+
+const GameSession::LootObjects& GameSession::GetLootObjects() const{
     return loot_;
 }
 
 void GameSession::DeleteCollectedLoot(const std::set<size_t>& collected_items){
+    if(!collected_items.empty()){
+        MarkChanged();
+    }
+    /* 
+        Удаляем с конца: на место удалённого предмета переносится последний,
+        а все предметы с большими индексами к этому моменту уже удалены
+    */
     for(auto collect_id = collected_items.rbegin(); collect_id != collected_items.rend(); std::advance(collect_id, 1)){
-        auto it = std::next(loot_.begin(), *collect_id);
-        loot_.erase(it);
+        RecordChange(ChangeJournal::Object::LOOT, ChangeJournal::Change::REMOVE, loot_[*collect_id].id);
+        loot_.EraseAt(*collect_id);
     }
 }
 
-void GameSession::DeleteDog(const Dog* erasing_dog){
-    auto it = std::find_if(dogs_.begin(), dogs_.end(), [erasing_dog](const Dog& dog){
-        return &dog == erasing_dog;
-    });
+void GameSession::DeleteDog(DogHandle erasing_dog){
+    MarkChanged();
+    if(const Dog* dog = dogs_.Find(erasing_dog)){
+        RecordChange(ChangeJournal::Object::DOG, ChangeJournal::Change::REMOVE, dog->GetId());
+    }
+    dogs_.Erase(erasing_dog);
+}
+
+uint64_t GameSession::GetRevision() const{
+    return revision_;
+}
+
+void GameSession::MarkChanged(){
+    ++revision_;
+}
+
+void GameSession::MarkDogChanged(const Dog& dog){
+    MarkChanged();
+    RecordChange(ChangeJournal::Object::DOG, ChangeJournal::Change::UPSERT, dog.GetId());
+}
+
+uint64_t GameSession::GetTick() const{
+    return tick_;
+}
+
+void GameSession::NextTick(){
+    MarkChanged();
+    ++tick_;
+    journal_.Trim(tick_);
+}
 
-    dogs_.erase(it);
+const ChangeJournal& GameSession::GetChangeJournal() const{
+    return journal_;
+}
+
+void GameSession::RecordChange(ChangeJournal::Object object, ChangeJournal::Change change, uint64_t id){
+    journal_.Record(tick_, object, change, id);
 }
 
 /* ------------------------ Game ----------------------------------- */
@@ -360,7 +403,8 @@ void Game::AddMap(Map&& map) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
     } else {
         try {
-            maps_.emplace_back(std::move(map));
+            Map& added_map = maps_.emplace_back(std::move(map));
+            added_map.BuildWalkableIndex();
         } catch (...) {
             map_id_to_index_.erase(it);
             throw;
@@ -370,8 +414,8 @@ void Game::AddMap(Map&& map) {
 
 GameSession* Game::AddSession(const Map::Id& map_id){
     if(const Map* map = FindMap(map_id); map != nullptr){
-        GameSession* session = &(map_id_to_sessions_[map_id].emplace_back(map));
-        return session;
+        std::deque<GameSession>& sessions = map_id_to_sessions_[map_id];
+        return &sessions.emplace_back(map, sessions.size());
     }
     return nullptr;
 }
@@ -418,6 +462,14 @@ unsigned Game::GetDogRetirementTime() const{
     return dog_retirement_time_;
 }
 
+void Game::SetTickParallelism(unsigned parallelism){
+    if(parallelism > 1){
+        task_pool_ = std::make_unique<util::TaskPool>(parallelism);
+    } else {
+        task_pool_.reset();
+    }
+}
+
 const Game::Maps& Game::GetMaps() const noexcept {
     return maps_;
 }
@@ -433,27 +485,52 @@ detail::Milliseconds Game::GetLootGeneratePeriod() const{
     return loot_generator_.value().GetPeriod();
 }
 
+const std::optional<loot_gen::LootGenerator>& Game::GetLootGenerator() const noexcept{
+    return loot_generator_;
+}
+
 void Game::GenerateLootInSessions(detail::Milliseconds delta){
-    for(auto& [map_id, sessions] : map_id_to_sessions_){
-        for(GameSession& session : sessions){
-            unsigned current_loot_count = session.GetLootObjects().size();
-            unsigned loot_count = (*loot_generator_).Generate(delta, current_loot_count, session.GetDogs().size());
-            session.UpdateLoot(loot_count);
-        }
+    std::vector<GameSession*> sessions = GetSessionsList();
+
+    /* 
+        Генератор лута общий для всех сессий и хранит время без лута, а типы и места
+        предметов выбираются через rand(), который не обязан быть потокобезопасным.
+        Поэтому количество, типы и места выбираем последовательно, а раскладываем лут параллельно
+    */
+    std::vector<std::vector<GameSession::LootDraw>> loot_draws;
+    loot_draws.reserve(sessions.size());
+    for(const GameSession* session : sessions){
+        unsigned current_loot_count = session->GetLootObjects().size();
+        unsigned loot_count = (*loot_generator_).Generate(delta, current_loot_count, session->GetDogs().size());
+        loot_draws.push_back(session->DrawLoot(loot_count));
     }
+
+    RunInParallel(sessions.size(), [&sessions, &loot_draws](size_t idx){
+        tracing::Span span("place_loot", "tick", detail::GetSpanArgs(*sessions[idx]));
+        sessions[idx]->PlaceLoot(loot_draws[idx]);
+    });
 }
 
 void Game::UpdateGameState(unsigned delta){
     double delta_in_seconds = static_cast<double>(delta) / 1000;
-    for(auto& [map_id, sessions] : map_id_to_sessions_){
-        for(GameSession& session : sessions){
+    std::vector<GameSession*> sessions = GetSessionsList();
+
+    /* Сессии не разделяют изменяемого состояния, поэтому обновляются независимо */
+    RunInParallel(sessions.size(), [this, &sessions, delta_in_seconds](size_t idx){
+        GameSession& session = *sessions[idx];
+        session.NextTick();
+        {
+            tracing::Span span("collect_loot", "tick", detail::GetSpanArgs(session));
             UpdateDogsLoot(session, delta_in_seconds);
-            UpdateAllDogsPositions(session.GetDogs(), session.GetMap(), delta_in_seconds);
         }
-    }
+        {
+            tracing::Span span("move_dogs", "tick", detail::GetSpanArgs(session));
+            UpdateAllDogsPositions(session, delta_in_seconds);
+        }
+    });
 }
 
-void Game::DisconnectDogFromSession(const GameSession* player_session, const Dog* erasing_dog){
+void Game::DisconnectDogFromSession(const GameSession* player_session, GameSession::DogHandle erasing_dog){
     Map::Id map_id = player_session->GetMap()->GetId();
 
     std::deque<GameSession>& sessions = map_id_to_sessions_.at(map_id);
@@ -465,67 +542,55 @@ void Game::DisconnectDogFromSession(const GameSession* player_session, const Dog
     found_session.DeleteDog(erasing_dog);
 }
 
-void Game::UpdateAllDogsPositions(std::list<Dog>& dogs, const Map* map, double delta){
-    for(Dog& dog : dogs){
-        std::vector<const Road*> roads = map->FindRoadsByCoords(dog.GetPosition());
-        UpdateDogPos(dog, roads, delta);
+std::vector<GameSession*> Game::GetSessionsList(){
+    std::vector<GameSession*> result;
+    for(auto& [map_id, sessions] : map_id_to_sessions_){
+        for(GameSession& session : sessions){
+            result.push_back(&session);
+        }
     }
+    return result;
 }
 
-void Game::UpdateDogPos(Dog& dog, const std::vector<const Road*>& roads, double delta){
-    const auto [x, y] = *(dog.GetPosition());
-    const auto [vx, vy] = *(dog.GetSpeed());
-
-    const PairDouble getting_pos({x + vx * delta, y + vy * delta});
-    const PairDouble getting_speed({vx, vy});
-
-    PairDouble result_pos(getting_pos);
-    PairDouble result_speed(getting_speed);
-
-    std::set<PairDouble> collisions;
-
-    for(const Road* road : roads){
-        Point start = road->GetStart();
-        Point end = road->GetEnd();
-
-        if(road->IsInvert()){
-            std::swap(start, end);
-        }
-
-        if(IsInsideRoad(getting_pos, start, end)){
-            dog.SetPosition(Dog::Position(getting_pos));
-            dog.SetSpeed(Dog::Speed(getting_speed));
-            return;
-        }
+void Game::RunInParallel(size_t count, const std::function<void(size_t)>& action){
+    if(task_pool_){
+        task_pool_->ParallelFor(count, action);
+        return;
+    }
 
-        if(start.x - 0.4 >= getting_pos.x) {
-            result_pos.x = start.x - 0.4;
-        } else if(getting_pos.x >= end.x + 0.4){
-            result_pos.x = end.x + 0.4;
-        }
+    for(size_t idx = 0; idx < count; ++idx){
+        action(idx);
+    }
+}
 
-        if(start.y - 0.4 >= getting_pos.y) {
-            result_pos.y = start.y - 0.4;
-        } else if(getting_pos.y >= end.y + 0.4){
-            result_pos.y = end.y + 0.4;
+void Game::UpdateAllDogsPositions(GameSession& session, double delta){
+    const WalkableIndex& walkable_index = session.GetMap()->GetWalkableIndex();
+    for(Dog& dog : session.GetDogs()){
+        if(UpdateDogPos(dog, walkable_index, delta)){
+            session.MarkDogChanged(dog);
         }
-
-        collisions.insert(result_pos);
     }
+}
 
-    if(collisions.size() != 0){
-        result_pos = *(std::prev(collisions.end(), 1));
-        result_speed = {0,0};
-    }
-    
-    dog.SetPosition(Dog::Position(result_pos));
-    dog.SetSpeed(Dog::Speed(result_speed));
+bool Game::UpdateDogPos(Dog& dog, const WalkableIndex& walkable_index, double delta){
+    const auto [x, y] = *(dog.GetPosition());
+    const auto [vx, vy] = *(dog.GetSpeed());
+
+    const PairDouble getting_pos({x + vx * delta, y + vy * delta});
+    WalkableIndex::MoveResult result = walkable_index.Move({x, y}, getting_pos);
+
+    /* Упёршись в край дороги, собака останавливается */
+    const Dog::Speed new_speed = result.stopped ? Dog::Speed({0, 0}) : Dog::Speed({vx, vy});
+    const bool changed = result.pos != PairDouble{x, y} || *new_speed != PairDouble{vx, vy};
+    dog.SetPosition(Dog::Position(result.pos));
+    dog.SetSpeed(new_speed);
+    return changed;
 }   
 
 void Game::UpdateDogsLoot(GameSession& session, double delta) {
     using namespace collision_detector;
-    std::list<Dog>& dogs = session.GetDogs();
-    const std::list<Loot>& all_loots = session.GetLootObjects();
+    GameSession::Dogs& dogs = session.GetDogs();
+    const GameSession::LootObjects& all_loots = session.GetLootObjects();
     unsigned max_bag_capacity = session.GetMap()->GetBagCapacity();
     const std::deque<Office>& offices = session.GetMap()->GetOffices();
 
@@ -537,8 +602,7 @@ void Game::UpdateDogsLoot(GameSession& session, double delta) {
     auto events = detail::MixEvents(FindGatherEvents(loots_provider), FindGatherEvents(offices_provider));
     std::set<size_t> collected_loot;
     for(const auto& [event, event_type] : events){
-        auto dog_it = std::next(dogs.begin(), event.gatherer_id);
-        Dog& dog = *dog_it;
+        Dog& dog = dogs[event.gatherer_id];
         switch (event_type){
             case detail::GatheringEventType::DOG_COLLECT_ITEM:
                 // Собака подбирает предмет
@@ -546,15 +610,17 @@ void Game::UpdateDogsLoot(GameSession& session, double delta) {
                 if((*dog.GetBag()).size() < max_bag_capacity){
                     // если до этого этот предмет не подбирали
                     if(!collected_loot.count(event.item_id)){
-                        auto loot_it = std::next(all_loots.begin(), event.item_id);
-                        const Loot& loot = *loot_it;
-                        dog.CollectItem(loot);
+                        dog.CollectItem(all_loots[event.item_id]);
                         collected_loot.insert(event.item_id);
+                        session.MarkDogChanged(dog);
                     }
                 }
                 break;
             case detail::GatheringEventType::DOG_DELIVER_ALL_ITEMS:
-                dog.ClearBag();
+                if(!(*dog.GetBag()).empty()){
+                    dog.ClearBag();
+                    session.MarkDogChanged(dog);
+                }
                 break;
         
             default:
@@ -566,14 +632,5 @@ void Game::UpdateDogsLoot(GameSession& session, double delta) {
     session.DeleteCollectedLoot(collected_loot);
 }
 
-bool Game::IsInsideRoad(const PairDouble& getting_pos, const Point& start, const Point& end){
-    bool in_left_border = getting_pos.x >= start.x - road_offset_;
-    bool in_right_border = getting_pos.x <= end.x + road_offset_;
-    bool in_upper_border = getting_pos.y >= start.y - road_offset_;
-    bool in_lower_border = getting_pos.y <= end.y + road_offset_;
-
-    return in_left_border && in_right_border && in_upper_border && in_lower_border;
-}
-
 
 }  // namespace model
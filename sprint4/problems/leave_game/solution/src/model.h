@@ -9,10 +9,16 @@
 #include <list>
 #include <iostream>
 #include <optional>
+#include <memory>
+#include <functional>
 #include <boost/signals2.hpp>
 
 #include "geom.h"
 #include "tagged.h"
+#include "slot_map.h"
+#include "change_journal.h"
+#include "task_pool.h"
+#include "walkable_index.h"
 #include "loot_generator.h"
 #include "collision_detector.h"
 
@@ -264,9 +270,6 @@ public:
         HORIZONTAl
     };
     using Roads = std::deque<Road>;
-    using RoadMap = std::map<RoadTag, std::map<double, const Road&>>;
-    using RoadIt = std::map<double, const Road&>::iterator;
-    using ConstRoadIt = std::map<double, const Road&>::const_iterator;
     using Buildings = std::deque<Building>;
     using Offices = std::deque<Office>;
     using LootTypes = std::deque<LootType>;
@@ -290,9 +293,18 @@ public:
 
     unsigned GetRandomLootType() const;
 
+    /* Половина ширины дороги */
+    static constexpr double ROAD_HALF_WIDTH = 0.4;
+
     void AddRoad(const Road& road);
 
-    std::vector<const Road*> FindRoadsByCoords(const Dog::Position& pos) const;
+    /* 
+        Строит индекс проходимой области по добавленным дорогам.
+        Вызывается после добавления всех дорог, Game::AddMap делает это сам
+    */
+    void BuildWalkableIndex();
+
+    const WalkableIndex& GetWalkableIndex() const noexcept;
 
     void AddBuilding(const Building& building);
 
@@ -318,18 +330,10 @@ private:
 
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
 
-    /* Поиск вертикальных дорог по x координате*/
-    void FindInVerticals(const Dog::Position& pos, std::vector<const Road*>& roads) const;
-
-    /* Поиск горизонтальных дорог по y координате*/
-    void FindInHorizontals(const Dog::Position& pos, std::vector<const Road*>& roads) const;
-
-    bool CheckBounds(ConstRoadIt it, const Dog::Position& pos) const;
-
     Id id_;
     std::string name_;
     Roads roads_;
-    RoadMap road_map_;
+    WalkableIndex walkable_index_;
     Buildings buildings_;
     LootTypes loot_types_;
 
@@ -341,33 +345,96 @@ private:
 
 class GameSession{
 public:
-    explicit GameSession(const Map* map)
-        : map_(map){
+    using Dogs = util::SlotMap<Dog>;
+    using DogHandle = Dogs::Handle;
+    using LootObjects = util::SlotMap<Loot>;
+
+    explicit GameSession(const Map* map, uint64_t id = 0)
+        : id_(id)
+        , map_(map){
     }
 
-    Dog* AddDog(int id, const Dog::Name& name, const Dog::Position& pos, const Dog::Speed& vel, Direction dir);
+    /* Номер сессии среди сессий её карты */
+    uint64_t GetId() const noexcept{
+        return id_;
+    }
 
-    Dog* AddCreatedDog(Dog new_dog);
+    DogHandle AddDog(int id, const Dog::Name& name, const Dog::Position& pos, const Dog::Speed& vel, Direction dir);
+
+    DogHandle AddCreatedDog(Dog new_dog);
+
+    Dog* FindDog(DogHandle handle);
+
+    const Dog* FindDog(DogHandle handle) const;
 
     const Map* GetMap() const;
 
-    std::list<Dog>& GetDogs();
+    Dogs& GetDogs();
+
+    const Dogs& GetDogs() const;
+
+    /* Тип и место нового предмета */
+    struct LootDraw{
+        unsigned type;
+        PairDouble pos;
+    };
+
+    /* 
+        Выбирает типы и места loot_count новых предметов. 
+        Использует rand(), поэтому вызывается только из одного потока
+    */
+    std::vector<LootDraw> DrawLoot(unsigned loot_count) const;
 
-    const std::list<Dog>& GetDogs() const;
+    /* Раскладывает выбранные заранее предметы. Сессии можно заполнять параллельно */
+    void PlaceLoot(const std::vector<LootDraw>& draws);
 
     void UpdateLoot(unsigned loot_count);
 
-    void SetLootObjects(std::list<Loot> new_loot);
+    void SetLootObjects(const std::list<Loot>& new_loot);
 
-    const std::list<Loot>& GetLootObjects() const;
+    /* Добавляет предмет с уже назначенным идентификатором, например при восстановлении из журнала */
+    void AddLoot(const Loot& loot);
 
+    /* Идентификатор последнего созданного предмета. Предметы, созданные позже, получат большие идентификаторы */
+    unsigned GetLastLootId() const;
+
+    const LootObjects& GetLootObjects() const;
+
+    /* Удаляет подобранные предметы по их индексам в GetLootObjects() */
     void DeleteCollectedLoot(const std::set<size_t>& collected_items);
 
-    void DeleteDog(const Dog* erasing_dog);
+    void DeleteDog(DogHandle erasing_dog);
+
+    /* 
+        Номер версии состояния сессии.
+        Увеличивается при каждом изменении собак или потерянных объектов,
+        по нему можно понять, что закэшированное представление сессии устарело
+    */
+    uint64_t GetRevision() const;
+
+    /* Отмечает изменение состояния, сделанное в обход методов сессии (например, через Dog) */
+    void MarkChanged();
+
+    /* То же, что MarkChanged, но дополнительно записывает изменение собаки в журнал */
+    void MarkDogChanged(const Dog& dog);
+
+    /* Номер текущего тика сессии. Увеличивается при каждом обновлении игрового состояния */
+    uint64_t GetTick() const;
+
+    /* Переводит сессию на следующий тик и отбрасывает устаревшие записи журнала */
+    void NextTick();
+
+    const ChangeJournal& GetChangeJournal() const;
 private:
+    void RecordChange(ChangeJournal::Object object, ChangeJournal::Change change, uint64_t id);
+
+    uint64_t revision_ = 0;
+    uint64_t tick_ = 0;
+    ChangeJournal journal_;
     unsigned auto_loot_counter_ = 0;
-    std::list<Loot> loot_;
-    std::list<Dog> dogs_;
+    LootObjects loot_;
+    Dogs dogs_;
+    uint64_t id_;
     const Map* map_;
 };
 
@@ -399,6 +466,12 @@ public:
     void SetDogRetirementTime(unsigned dog_retirement_time);
     
     unsigned GetDogRetirementTime() const;
+
+    /* 
+        Задаёт число потоков, в которых сессии обновляются на каждом тике.
+        По умолчанию сессии обновляются последовательно в вызывающем потоке
+    */
+    void SetTickParallelism(unsigned parallelism);
     
     const Maps& GetMaps() const noexcept;
 
@@ -406,19 +479,25 @@ public:
 
     detail::Milliseconds GetLootGeneratePeriod() const;
 
+    const std::optional<loot_gen::LootGenerator>& GetLootGenerator() const noexcept;
+
     void GenerateLootInSessions(detail::Milliseconds delta);
 
     void UpdateGameState(unsigned delta);
 
-    void DisconnectDogFromSession(const GameSession* player_session, const Dog* erasing_dog);
+    void DisconnectDogFromSession(const GameSession* player_session, GameSession::DogHandle erasing_dog);
 private:
-    void UpdateAllDogsPositions(std::list<Dog>& dogs, const Map* map, double delta);
+    std::vector<GameSession*> GetSessionsList();
 
-    void UpdateDogPos(Dog& dog, const std::vector<const Road*>& roads, double delta);
+    /* Вызывает action(i) для i из [0, count) в пуле потоков и дожидается завершения всех вызовов */
+    void RunInParallel(size_t count, const std::function<void(size_t)>& action);
 
-    void UpdateDogsLoot(GameSession& session, double delta);
+    void UpdateAllDogsPositions(GameSession& session, double delta);
+
+    /* Возвращает true, если позиция или скорость собаки изменились */
+    bool UpdateDogPos(Dog& dog, const WalkableIndex& walkable_index, double delta);
 
-    static bool IsInsideRoad(const PairDouble& getting_pos, const Point& start, const Point& end);
+    void UpdateDogsLoot(GameSession& session, double delta);
 
     Maps maps_;
     SessionsByMapId map_id_to_sessions_;
@@ -426,8 +505,8 @@ private:
     std::optional<loot_gen::LootGenerator> loot_generator_;
     double default_dog_speed_ = 1.0;
     double default_bag_capacity_ = 3;
-    static constexpr double road_offset_ = 0.4;
     unsigned dog_retirement_time_ = 60;
+    std::unique_ptr<util::TaskPool> task_pool_;
 };
 
 }  // namespace model
@@ -4,6 +4,7 @@
 #include <boost/serialization/deque.hpp>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/version.hpp>
 
 
 #include "player.h"
@@ -41,7 +42,7 @@ public:
     :id_(0), name_(), token_(""){}
 
     PlayerRepr(const Player* player)
-    :id_(player->GetId()), name_(*(player->GetName())), token_(*(player->GetToken())){}
+    :id_(player->GetId()), name_(*(player->GetName())), token_(player->GetToken().ToHex()){}
 
     int GetId() const{
         return id_;
@@ -124,8 +125,8 @@ public:
 
     SessionRepr() = default;
 
-    void AddLoots(const std::list<Loot>& loot){
-        loot_ = loot;
+    void AddLoots(const GameSession::LootObjects& loot){
+        loot_.assign(loot.begin(), loot.end());
     }
 
     const std::list<Loot>& GetLoot() const{
@@ -157,10 +158,10 @@ public:
 
     GameStateRepr(const Game::SessionsByMapId& sessions_by_map, const Players& players){
         for(const auto& [map_id, sessions] : sessions_by_map){
-            std::list<Loot> loot;
+            const GameSession::LootObjects* loot = nullptr;
             std::list<DogRepr> dogs_repr;
             for(const auto& session : sessions){
-                loot = session.GetLootObjects();
+                loot = &session.GetLootObjects();
                 for(const auto& dog : session.GetDogs()){
                     dogs_repr.emplace_back(DogRepr(dog));
 
@@ -171,7 +172,9 @@ public:
             }
 
             SessionRepr session_repr;
-            session_repr.AddLoots(loot);
+            if(loot != nullptr){
+                session_repr.AddLoots(*loot);
+            }
             session_repr.AddDogsRepr(dogs_repr);
 
             all_sessions_[*map_id].emplace_back(std::move(session_repr));
@@ -181,14 +184,30 @@ public:
     const SessionsByMapId& GetAllSessions() const{
         return all_sessions_;
     }
+
+    /* Первый сегмент журнала действий, изменения из которого не вошли в снимок */
+    uint64_t GetJournalSegment() const{
+        return journal_segment_;
+    }
+
+    void SetJournalSegment(uint64_t segment){
+        journal_segment_ = segment;
+    }
     
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& all_sessions_;
+        /* В снимках первой версии журнала ещё не было */
+        if(version >= 1){
+            ar& journal_segment_;
+        }
     }
     
 private:
     SessionsByMapId all_sessions_;
+    uint64_t journal_segment_ = 0;
 };
 
 }  // namespace serialization
+
+BOOST_CLASS_VERSION(::serialization::GameStateRepr, 1)
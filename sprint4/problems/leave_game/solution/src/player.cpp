@@ -1,4 +1,3 @@
-#include <iomanip>
 #include "player.h"
 
 namespace util {
@@ -16,8 +15,8 @@ namespace model{
 
 /* ------------------------ Players ----------------------------------- */
 
-Player& Players::Add(int id, const Player::Name& name, Dog* dog, const GameSession* session){
-    util::DogMapKey key = std::make_pair(dog->GetId(), session->GetMap()->GetId());
+Player& Players::Add(int id, const Player::Name& name, GameSession::DogHandle dog, GameSession* session){
+    util::DogMapKey key = std::make_pair(session->FindDog(dog)->GetId(), session->GetMap()->GetId());
     Player player(id, name, dog, session);
     auto [it, is_emplaced] = players_.emplace(key, player);
     if(is_emplaced){
@@ -49,32 +48,33 @@ void Players::DeletePlayer(const Player* erasing_player){
 /* ---------------------- PlayerTokens ------------------------------------- */
 
 Token PlayerTokens::AddPlayer(Player& player){
-    auto [it, is_emplaced] = token_to_player_.emplace(GenerateToken(), &player);
-    if(is_emplaced){
-        players_by_session_[player.GetSession()].push_back(it->second);
-        player.SetToken(it->first);
-        return it->first;
+    ++revision_;
+    const Token token = GenerateToken();
+    if(token_to_player_.Emplace(token, &player)){
+        players_by_session_[player.GetSession()].push_back(&player);
+        player.SetToken(token);
+        return token;
     }
 
     throw std::logic_error("Player with this token has already been added");
 }
 
 void PlayerTokens::AddPlayerWithToken(Player& player, Token token){
-    auto [it, is_emplaced] = token_to_player_.emplace(std::move(token), &player);
-    if(!is_emplaced){
+    ++revision_;
+    if(!token_to_player_.Emplace(token, &player)){
         throw std::logic_error("Player with this token has already been added");
     }
+    player.SetToken(token);
 }
 
 void PlayerTokens::AddPlayerInSession(Player& player, const GameSession* session){
+    ++revision_;
     players_by_session_[session].push_back(&player);
 }
 
 Player* PlayerTokens::FindPlayerByToken(const Token& token){
-    if(token_to_player_.contains(token)){
-        return token_to_player_.at(token);
-    } 
-    return nullptr;
+    Player* const* player = token_to_player_.Find(token);
+    return player ? *player : nullptr;
 }
 
 const PlayerTokens::PlayersInSession& PlayerTokens::GetPlayersBySession(const GameSession* session) const{
@@ -86,10 +86,8 @@ const PlayerTokens::PlayersInSession& PlayerTokens::GetPlayersBySession(const Ga
 }
 
 const Player* PlayerTokens::FindPlayerByToken(const Token& token) const{
-    if(token_to_player_.contains(token)){
-        return const_cast<const Player*>(token_to_player_.at(token));
-    } 
-    return nullptr;
+    Player* const* player = token_to_player_.Find(token);
+    return player ? *player : nullptr;
 }
 
 const PlayerTokens::TokenToPlayer& PlayerTokens::GetAllTokens() const{
@@ -97,13 +95,9 @@ const PlayerTokens::TokenToPlayer& PlayerTokens::GetAllTokens() const{
 }
 
 void PlayerTokens::DeletePlayer(const Player* erasing_player){
+    ++revision_;
     /* Удаляем из хэш-таблицы с токенами */
-    auto token_it = std::find_if(token_to_player_.begin(), 
-                                token_to_player_.end(), 
-                                [erasing_player](const auto& token_and_player){
-                                    return token_and_player.second == erasing_player;});
-
-    token_to_player_.erase(token_it);
+    token_to_player_.Erase(erasing_player->GetToken());
 
     /* Удаляем из хэш-таблицы c сессиями */
     PlayersInSession& players_in_session = players_by_session_.at(erasing_player->GetSession());
@@ -115,11 +109,18 @@ void PlayerTokens::DeletePlayer(const Player* erasing_player){
     players_in_session.erase(session_it);
 }
 
+const PlayerTokens::SessionToPlayers& PlayerTokens::GetAllSessions() const{
+    return players_by_session_;
+}
+
+uint64_t PlayerTokens::GetRevision() const{
+    return revision_;
+}
+
 Token PlayerTokens::GenerateToken() {
-    std::ostringstream out;
-    out << std::hex << std::setw(16) << std::setfill('0') << generator1_();
-    out << std::hex << std::setw(16) << std::setfill('0') << generator2_();
-    return Token(out.str());
+    /* Первое число - старшие 16 шестнадцатеричных цифр токена, второе - младшие */
+    const uint64_t high = generator1_();
+    return Token(high, generator2_());
 }
 
 } // namespace model
\ No newline at end of file
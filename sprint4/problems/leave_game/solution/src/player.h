@@ -1,6 +1,8 @@
 #pragma once
 #include <random>
 #include "model.h"
+#include "token.h"
+#include "flat_hash_map.h"
 
 namespace util {
 
@@ -13,13 +15,6 @@ struct DogMapKeyHasher{
 
 namespace model{
 
-namespace detail {
-struct TokenTag {};
-}  // namespace detail
-
-using Token = util::Tagged<std::string, detail::TokenTag>;
-
-
 class Players;
 class PlayerTokens;
 
@@ -37,21 +32,29 @@ public:
     }
 
     Dog* GetDog(){
-        return dog_;
+        return session_->FindDog(dog_);
     }
 
     void SetPlayerTimeClock(const Dog::SpeedSignal::slot_type& slot) const {
-        dog_->SetSlotSpeed(slot);
+        GetDog()->SetSlotSpeed(slot);
     }
 
     const Dog* GetDog() const{
-        return static_cast<const Dog*>(dog_);
+        return static_cast<const GameSession*>(session_)->FindDog(dog_);
+    }
+
+    GameSession::DogHandle GetDogHandle() const{
+        return dog_;
     }
 
     const GameSession* GetSession() const{
         return session_;
     }
 
+    GameSession* GetSession(){
+        return session_;
+    }
+
     void SetToken(Token token){
         token_ = token;
     }
@@ -63,15 +66,19 @@ private:
     friend PlayerTokens;
     friend Players;
 
-    Player(int id, Name name, Dog* dog, const GameSession* session)
-        : id_(id), name_(name), dog_(dog), token_(""),session_(session){
+    Player(int id, Name name, GameSession::DogHandle dog, GameSession* session)
+        : id_(id), name_(name), dog_(dog), session_(session){
     }
 
     int id_;
     Name name_;
     Token token_;
-    Dog* dog_;
-    const GameSession* session_;
+    /* 
+        Собака хранится в сессии по дескриптору:
+        адрес собаки меняется при удалении других собак из сессии
+    */
+    GameSession::DogHandle dog_;
+    GameSession* session_;
 };
 
 /* ------------------------ Players ----------------------------------- */
@@ -81,7 +88,7 @@ public:
     using PlayerList = std::unordered_map<util::DogMapKey, Player, util::DogMapKeyHasher>;
     Players() = default;
 
-    Player& Add(int id, const Player::Name& name, Dog* dog, const GameSession* session);
+    Player& Add(int id, const Player::Name& name, GameSession::DogHandle dog, GameSession* session);
 
     const Player* FindByDogIdAndMapId(int dog_id, std::string map_id) const;
 
@@ -97,7 +104,7 @@ private:
 class PlayerTokens{
 public:
     using PlayersInSession = std::deque<const Player*>;
-    using TokenToPlayer = std::unordered_map<Token, Player*, util::TaggedHasher<Token>>;
+    using TokenToPlayer = util::FlatHashMap<Token, Player*, TokenHasher>;
     using SessionToPlayers = std::unordered_map<const model::GameSession*, PlayersInSession>;
     PlayerTokens() = default;
 
@@ -116,8 +123,14 @@ public:
     const TokenToPlayer& GetAllTokens() const;
 
     void DeletePlayer(const Player* erasing_player);
+
+    const SessionToPlayers& GetAllSessions() const;
+
+    /* Номер версии набора игроков. Увеличивается при добавлении и удалении игроков */
+    uint64_t GetRevision() const;
 private:
     Token GenerateToken();
+    uint64_t revision_ = 0;
     std::random_device random_device_;
 
     std::mt19937_64 generator1_{[this] {
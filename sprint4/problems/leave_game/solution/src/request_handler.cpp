@@ -52,48 +52,167 @@ std::string DecodeTarget(std::string_view req_target){
     return result;
 }
 
-std::pair<std::string, std::string> ParseArg(std::string_view arg){
-    size_t equal_sign = arg.find('=');
-    std::string key = std::string(arg.substr(0, equal_sign));
-    std::string value = std::string(arg.substr(equal_sign+1, arg.npos));
+std::string MakeErrorCode(std::string_view code, std::string_view message){
+    json::object body;
+    body["code"] = std::string(code);
+    body["message"] = std::string(message);
+    return json::serialize(body);
+}
 
-    return std::make_pair(std::move(key), std::move(value));
+namespace {
+
+/* Следующий элемент списка через запятую без пробелов по краям */
+std::string_view NextListItem(std::string_view& list){
+    const size_t comma = list.find(',');
+    std::string_view item = list.substr(0, comma);
+    list.remove_prefix(comma == list.npos ? list.size() : comma + 1);
+    while(!item.empty() && (item.front() == ' ' || item.front() == '\t')){
+        item.remove_prefix(1);
+    }
+    while(!item.empty() && (item.back() == ' ' || item.back() == '\t')){
+        item.remove_suffix(1);
+    }
+    return item;
 }
 
-std::unordered_map<std::string, std::string> ParseTargetArgs(std::string_view req_target){
-    std::unordered_map<std::string, std::string> args;
-    
-    size_t prev = req_target.find('?') + 1;;
-    size_t next_amper = req_target.find('&');
-    while(next_amper != req_target.npos){
-        std::string arg;
-        size_t length = next_amper - prev;
-        arg = req_target.substr(prev, length);
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs){
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char a, char b){
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+}
 
-        auto parsed_arg = ParseArg(arg);
-        args.emplace(std::move(parsed_arg.first), std::move(parsed_arg.second));
+/* Пропускает пробельные символы JSON */
+void SkipWhitespace(std::string_view& str){
+    while(!str.empty() && (str.front() == ' ' || str.front() == '\t' || str.front() == '\n' || str.front() == '\r')){
+        str.remove_prefix(1);
+    }
+}
 
-        prev = next_amper + 1;
-        next_amper = req_target.find('&', prev);
+/* Отделяет от строки token вместе с пробелами перед ним */
+bool Consume(std::string_view& str, std::string_view token){
+    SkipWhitespace(str);
+    if(!str.starts_with(token)){
+        return false;
     }
+    str.remove_prefix(token.size());
+    return true;
+}
 
-    size_t length = next_amper - prev;
-    std::string last_arg = std::string(req_target.substr(prev, length));
-    auto parsed_arg = ParseArg(last_arg);
-    args.emplace(std::move(parsed_arg.first), std::move(parsed_arg.second));
+}  // namespace
 
-    return args;
+bool MatchesETag(std::string_view if_none_match, std::string_view etag){
+    constexpr std::string_view WEAK_PREFIX = "W/"sv;
+    if(etag.starts_with(WEAK_PREFIX)){
+        etag.remove_prefix(WEAK_PREFIX.size());
+    }
+    while(!if_none_match.empty()){
+        std::string_view tag = NextListItem(if_none_match);
+        if(tag == "*"sv){
+            return true;
+        }
+        if(tag.starts_with(WEAK_PREFIX)){
+            tag.remove_prefix(WEAK_PREFIX.size());
+        }
+        if(tag == etag){
+            return true;
+        }
+    }
+    return false;
 }
 
-std::string MakeErrorCode(std::string_view code, std::string_view message){
-    json::object body;
-    body["code"] = std::string(code);
-    body["message"] = std::string(message);
-    return json::serialize(body);
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding){
+    while(!accept_encoding.empty()){
+        std::string_view item = NextListItem(accept_encoding);
+        std::string_view name = item.substr(0, item.find(';'));
+        while(!name.empty() && name.back() == ' '){
+            name.remove_suffix(1);
+        }
+        if(!EqualsIgnoreCase(name, coding) && name != "*"sv){
+            continue;
+        }
+        /* Кодирование с весом q=0 запрещено */
+        const size_t q_pos = item.find("q="sv);
+        if(q_pos == item.npos){
+            return true;
+        }
+        std::string_view weight = item.substr(q_pos + 2);
+        return !weight.starts_with('0') || weight.find_first_not_of("0."sv) != weight.npos;
+    }
+    return false;
 }
 
-bool IsMatched(const std::string& str, std::string reg_expression){
-    return boost::regex_match(str, boost::regex(reg_expression));
+compression::Encoding SelectEncoding(std::string_view accept_encoding, const compression::EncodedBody& body){
+    for(compression::Encoding encoding : {compression::Encoding::GZIP, compression::Encoding::DEFLATE}){
+        if(body.Has(encoding) && AcceptsEncoding(accept_encoding, compression::GetEncodingName(encoding))){
+            return encoding;
+        }
+    }
+    return compression::Encoding::IDENTITY;
+}
+
+std::optional<std::string_view> ParseMoveAction(std::string_view body){
+    if(!Consume(body, "{"sv) || !Consume(body, "\"move\""sv) || !Consume(body, ":"sv) || !Consume(body, "\""sv)){
+        return std::nullopt;
+    }
+    const size_t end = body.find('"');
+    if(end == body.npos){
+        return std::nullopt;
+    }
+    std::string_view move = body.substr(0, end);
+    if(!IsValidMove(move)){
+        return std::nullopt;
+    }
+    body.remove_prefix(end + 1);
+    if(!Consume(body, "}"sv)){
+        return std::nullopt;
+    }
+    SkipWhitespace(body);
+    return body.empty() ? std::optional<std::string_view>(move) : std::nullopt;
+}
+
+bool IsValidMove(std::string_view move){
+    return move == ""sv || move == "U"sv || move == "D"sv || move == "L"sv || move == "R"sv;
+}
+
+std::optional<app::Token> ParseBearerToken(std::string_view authorization){
+    constexpr std::string_view BEARER = "Bearer ";
+    if(!authorization.starts_with(BEARER)){
+        return std::nullopt;
+    }
+    authorization.remove_prefix(BEARER.size());
+    return app::Token::FromHex(authorization);
+}
+
+std::string_view GetRouteLabel(std::string_view req_target){
+    std::string_view path = req_target.substr(0, req_target.find('?'));
+    if(path == METRICS_TARGET){
+        return METRICS_TARGET;
+    }
+    if(path.starts_with(ADMIN_PREFIX)){
+        return ADMIN_PREFIX;
+    }
+    if(!path.starts_with("/api/"sv)){
+        return "static"sv;
+    }
+    if(std::optional<router::RouteMatch> route = router::Match(req_target)){
+        return router::GetPattern(route->endpoint);
+    }
+    return "unknown"sv;
+}
+
+void ObserveRequest(std::string_view route, unsigned status, Clock::duration duration){
+    static metrics::Family<metrics::Histogram>& request_duration = metrics::GetRegistry().AddHistogram(
+        "http_request_duration_seconds"s, "Time from reading a request to sending its response"s, {"route"s, "status"s});
+
+    char status_str[8];
+    auto [ptr, ec] = std::to_chars(status_str, status_str + sizeof(status_str), status);
+    request_duration.WithLabels({route, std::string_view(status_str, ptr - status_str)}).Observe(duration);
+}
+
+void ObserveStrandDelay(Clock::duration delay){
+    static metrics::Histogram& strand_delay = metrics::GetRegistry().AddHistogram(
+        "api_strand_queue_delay_seconds"s, "Time an API request waits for the API strand"s).WithLabels({});
+    strand_delay.Observe(delay);
 }
 
 } // namespace detail
@@ -120,6 +239,25 @@ StringResponse BaseHandler::MakeErrorResponse(http::status status, std::string_v
     return MakeResponse(status, body, version, body.size(), "application/json"s);
 }
 
+StringResponse BaseHandler::MakeNotModifiedResponse(std::string_view etag, unsigned http_version){
+    StringResponse response(http::status::not_modified, http_version);
+
+    response.set(http::field::etag, etag);
+    response.set(http::field::cache_control, "no-cache"s);
+    return response;
+}
+
+SharedResponse BaseHandler::MakeSharedResponse(http::status status, SharedBuffer body,
+                                    unsigned http_version, std::string content_type){
+    SharedResponse response(status, http_version);
+
+    response.set(http::field::content_type, content_type);
+    response.set(http::field::cache_control, "no-cache"s);
+    response.body() = std::move(body);
+    response.prepare_payload();
+    return response;
+}
+
 /* -------------------------- FileHandler --------------------------------- */
 
 std::string FileHandler::GetRequiredContentType(std::string_view req_target){
@@ -1,16 +1,22 @@
 #pragma once
-#include <boost/regex.hpp>
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <iostream>
 #include "app.h"
 #include "cmd_parser.h"
+#include "shared_body.h"
+#include "http_server.h"
+#include "router.h"
+#include "metrics.h"
+#include "static_cache.h"
+#include "tracing.h"
 #include <iostream>
 #include <filesystem>
 #include <variant>
 #include <unordered_map>
 #include <optional>
+#include <charconv>
 
 namespace request_handler {
 
@@ -41,19 +47,65 @@ inline char FromHexToChar(char a, char b);
 
 std::string DecodeTarget(std::string_view req_target);
 
-std::pair<std::string, std::string> ParseArg(std::string_view arg);
+std::string MakeErrorCode(std::string_view code, std::string_view message);
 
-std::unordered_map<std::string, std::string> ParseTargetArgs(std::string_view req_target);
+/* Число из строки целиком, без выделения памяти */
+template<typename Number>
+std::optional<Number> ParseNumber(std::string_view str){
+    Number value{};
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if(ec != std::errc() || ptr != str.data() + str.size()){
+        return std::nullopt;
+    }
+    return value;
+}
 
-std::string MakeErrorCode(std::string_view code, std::string_view message);
+/* Совпадает ли etag с одним из тегов заголовка If-None-Match (слабое сравнение, как требует RFC 9110) */
+bool MatchesETag(std::string_view if_none_match, std::string_view etag);
+
+/* Разрешает ли заголовок Accept-Encoding кодирование coding, например "gzip" */
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding);
+
+/* Кодирование тела body для клиента с заголовком Accept-Encoding: gzip, затем deflate, иначе без сжатия */
+compression::Encoding SelectEncoding(std::string_view accept_encoding, const compression::EncodedBody& body);
+
+/*
+    Направление из тела действия {"move":"<направление>"} без выделения памяти.
+    Разбирается только эта форма (пробелы допускаются) с направлением "U", "D", "L", "R" или "".
+    Для любого другого тела возвращается nullopt, и его разбирает общий парсер JSON
+*/
+std::optional<std::string_view> ParseMoveAction(std::string_view body);
+
+/* Направление действия: "U", "D", "L", "R" или "" для остановки */
+bool IsValidMove(std::string_view move);
+
+/* Токен из заголовка "Authorization: Bearer <token>" */
+std::optional<app::Token> ParseBearerToken(std::string_view authorization);
 
-bool IsMatched(const std::string& str, std::string reg_expression);
+/* Адрес, по которому отдаются метрики сервера */
+inline constexpr std::string_view METRICS_TARGET = "/metrics"sv;
+
+/* Служебные запросы, например управление трассировкой */
+inline constexpr std::string_view ADMIN_PREFIX = "/admin/"sv;
+
+/* 
+    Метка маршрута для метрик: шаблон пути конечной точки API,
+    а не сама цель запроса, чтобы число рядов метрики не зависело от запросов
+*/
+std::string_view GetRouteLabel(std::string_view req_target);
+
+/* Время от получения запроса до отправки ответа по маршруту и коду ответа */
+void ObserveRequest(std::string_view route, unsigned status, Clock::duration duration);
+
+/* Время ожидания запроса в очереди strand API */
+void ObserveStrandDelay(Clock::duration delay);
 
 }; // namespace detail
 
 using StringResponse = http::response<http::string_body>;
-using FileResponse = http::response<http::file_body>;
-using VariantResponse = std::variant<StringResponse, FileResponse>;
+using SharedResponse = http::response<http_server::SharedStringBody>;
+using VariantResponse = std::variant<StringResponse, SharedResponse>;
+using ApiResponse = std::variant<StringResponse, SharedResponse>;
 
 /* 
     Предварительное объявление 
@@ -76,6 +128,44 @@ protected:
 
     StringResponse MakeErrorResponse(http::status status, std::string_view code, 
                                     std::string_view message, unsigned int version);
+
+    /* Ответ 304 на условный запрос с совпавшим If-None-Match */
+    StringResponse MakeNotModifiedResponse(std::string_view etag, unsigned http_version);
+
+    /* Ответ с разделяемым телом: буфер не копируется */
+    SharedResponse MakeSharedResponse(http::status status, SharedBuffer body,
+                                    unsigned http_version, std::string content_type);
+
+    /*
+        Ответ с заранее подготовленным телом в кодировании, которое принимает клиент.
+        Если у клиента уже есть этот вариант тела (совпал If-None-Match), отвечает 304
+    */
+    template<typename Request>
+    VariantResponse MakeEncodedResponse(const Request& req, const compression::EncodedBody& body,
+                                        std::string content_type, std::string_view cache_control = "no-cache"sv){
+        const compression::EncodedBody::Variant& variant = 
+            body.Get(detail::SelectEncoding(req[http::field::accept_encoding], body));
+        auto set_cache_headers = [&body, &variant, cache_control](auto& response){
+            response.set(http::field::etag, variant.etag);
+            response.set(http::field::cache_control, cache_control);
+            if(body.HasCompressed()){
+                response.set(http::field::vary, "Accept-Encoding"sv);
+            }
+        };
+
+        if(detail::MatchesETag(req[http::field::if_none_match], variant.etag)){
+            StringResponse response = MakeNotModifiedResponse(variant.etag, req.version());
+            set_cache_headers(response);
+            return response;
+        }
+
+        SharedResponse response = MakeSharedResponse(http::status::ok, variant.body, req.version(), std::move(content_type));
+        set_cache_headers(response);
+        if(variant.encoding != compression::Encoding::IDENTITY){
+            response.set(http::field::content_encoding, compression::GetEncodingName(variant.encoding));
+        }
+        return response;
+    }
 };
 
 /* -------------------------- ApiHandler --------------------------------- */
@@ -117,30 +207,106 @@ class ApiHandler : public BaseHandler{
     };
 
 public:
+    /*
+        Запрос только читает данные, которые есть в снимке игры или не меняются после загрузки,
+        поэтому его можно обработать вне strand
+    */
+    template<typename Request>
+    static bool IsReadOnly(const Request& req){
+        std::optional<router::RouteMatch> route = router::Match(req.target());
+        if(!route.has_value()){
+            return false;
+        }
+        switch(route->endpoint){
+            case router::Endpoint::MAPS_LIST:
+            case router::Endpoint::MAP_DESCRIPTION:
+            case router::Endpoint::PLAYERS_LIST:
+                return true;
+            case router::Endpoint::GAME_STATE:
+                /* Изменения с тика since берутся из журнала сессии, который меняется в strand */
+                return !route->params.GetQueryParam("since").has_value();
+            default:
+                return false;
+        }
+    }
+
     template<typename Request>
-    StringResponse MakeApiResponse(Request&& req){
-        std::string target = std::string(req.target());
-        if(detail::IsMatched(target, "(/api/v1/maps)"s)){
-            return MakeMapsListsResponse(req);
-        } else if(detail::IsMatched(target, "(/api/v1/maps/).+"s)) {
-            return MakeMapDescResponse(req);
-        } else if(detail::IsMatched(target, "(/api/v1/game/).*"s)){
-            if(detail::IsMatched(target, "(/api/v1/game/join)"s)){
+    ApiResponse MakeApiResponse(Request&& req){
+        std::optional<router::RouteMatch> route = router::Match(req.target());
+        if(!route.has_value()){
+            return MakeErrorResponse(http::status::bad_request, "badRequest"sv, "Bad request"sv, req.version());
+        }
+
+        const router::RouteParams& params = route->params;
+        switch(route->endpoint){
+            case router::Endpoint::MAPS_LIST:
+                return MakeMapsListsResponse(req);
+            case router::Endpoint::MAP_DESCRIPTION:
+                return MakeMapDescResponse(req, params);
+            case router::Endpoint::JOIN_GAME:
                 return MakeAuthResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/players)"s)) {
+            case router::Endpoint::PLAYERS_LIST:
                 return MakePlayerListResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/state)"s)) {
-                return MakeGameStateResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/tick)"s)){
+            case router::Endpoint::GAME_STATE:
+                return MakeGameStateResponse(req, params);
+            case router::Endpoint::TICK:
                 return MakeIncreaseTimeResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/player/action)"s)){
+            case router::Endpoint::PLAYER_ACTION:
                 return MakeActionResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/records).*"s)){
-                return MakeRecordsResponse(req);
-            }
+            case router::Endpoint::PLAYER_ACTIONS:
+                return MakeBatchActionResponse(req);
+            case router::Endpoint::RECORDS:
+                return MakeRecordsResponse(req, params);
         }
-        auto res = MakeErrorResponse(http::status::bad_request, "badRequest"sv, "Bad request"sv, req.version());
-        return res;
+        return MakeErrorResponse(http::status::bad_request, "badRequest"sv, "Bad request"sv, req.version());
+    }
+
+    /* 
+        Подписка на состояние игры через WebSocket. 
+        Клиент авторизуется тем же токеном, что и при HTTP-запросах
+    */
+    template<typename Request>
+    void Subscribe(Request&& req, std::shared_ptr<http_server::WebSocketSession> ws_session){
+        std::optional<router::RouteMatch> route = router::Match(req.target());
+        if(!route.has_value() || route->endpoint != router::Endpoint::GAME_STATE){
+            return ws_session->Reject(MakeErrorResponse(http::status::bad_request, 
+                "badRequest"sv, "Bad request"sv, req.version()));
+        }
+
+        std::optional<Token> token;
+        if(auto it = req.find(http::field::authorization); it != req.end()){
+            token = detail::ParseBearerToken(it->value());
+        }
+        if(!token.has_value()){
+            return ws_session->Reject(MakeErrorResponse(http::status::unauthorized, 
+                "invalidToken"sv, "Authorization header is missing"sv, req.version()));
+        }
+        if(!app_.FindPlayerByToken(*token)){
+            return ws_session->Reject(MakeErrorResponse(http::status::unauthorized, 
+                "unknownToken"sv, "Player token has not been found"sv, req.version()));
+        }
+
+        std::weak_ptr<http_server::WebSocketSession> weak_session = ws_session;
+        app::StateSubscriber subscriber{
+            *token,
+            [weak_session](SharedBuffer state){
+                auto session = weak_session.lock();
+                if(!session || session->IsClosed()){
+                    return false;
+                }
+                session->Push(std::move(state));
+                return true;
+            },
+            [weak_session](){
+                if(auto session = weak_session.lock()){
+                    session->Close();
+                }
+            }
+        };
+
+        /* Рукопожатие ставится в очередь соединения раньше первого кадра */
+        ws_session->Accept(std::forward<Request>(req));
+        app_.SubscribeToState(std::move(subscriber));
     }
 
     void SaveState(){
@@ -164,6 +330,14 @@ private:
         return app_.GetStrand();
     }
 
+    bool IsSnapshotStale() const{
+        return app_.IsSnapshotStale();
+    }
+
+    void RefreshSnapshot(){
+        app_.RefreshSnapshot();
+    }
+
     template<typename Request>
     void DumpRequest(const Request& req){
         std::cout << "HTTP/1.1 "
@@ -192,40 +366,31 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakeMapsListsResponse(Request&& req){
+    ApiResponse MakeMapsListsResponse(Request&& req){
         using namespace std::literals;
 
         SetMethods methods("GET", "HEAD");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
-            std::string body = app_.GetMapsList();
-            return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
+            return MakeEncodedResponse(req, app_.GetMapsList(), "application/json"s);
         } else{
             auto res =  MakeErrorResponse(http::status::method_not_allowed, 
                 "invalidMethod"sv, "Only GET method is expected"sv, req.version());
             res.insert("Allow"s, methods.MakeSequence());
             return res;
         }
-
-        std::string body = app_.GetMapsList();
-        return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
     }
 
     template<typename Request>
-    StringResponse MakeMapDescResponse(Request&& req){
+    ApiResponse MakeMapDescResponse(Request&& req, const router::RouteParams& params){
         using namespace std::literals;
 
         SetMethods methods("GET", "HEAD");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
-            std::string req_target = std::string(req.target());
-            model::Map::Id id(std::string(req_target.substr(13, req_target.npos)));
-            if(auto map = app_.FindMap(id); map){
-                std::string body = app_.GetMapDescription(map);
-                return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
+            model::Map::Id id(std::string(params.GetPathParam("id").value()));
+            if(const compression::EncodedBody* body = app_.GetMapDescription(id)){
+                return MakeEncodedResponse(req, *body, "application/json"s);
             }
 
             return MakeErrorResponse(http::status::not_found, 
@@ -285,32 +450,29 @@ private:
         Проверяет на правильность запрос 
         с авторизационным токеном.
         Если запрос невалиден, возвращает ответ с кодом ошибки.
-        Если валиден, то вызывает функцию action 
-        с переданным ей запросом.
+        Если валиден, то находит по токену объект find(token)
+        и вызывает функцию action с переданным ей запросом
+        и найденным объектом. find возвращает nullptr, если токен неизвестен
     */
-    template <typename Request, typename Fn>
-    StringResponse ExecuteAuthorized(const SetMethods& methods, Request&& req, Fn&& action) {
+    template <typename Request, typename Find, typename Fn>
+    ApiResponse ExecuteAuthorized(const SetMethods& methods, Request&& req, Find&& find, Fn&& action) {
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
             auto it = req.find(http::field::authorization);
             try{
-                if(it != req.end()){
-                    std::string_view req_token = it->value();
-                    Token token(std::string(req_token.substr(7, req_token.npos)));
-                    if((*token).size() != 32){
-                        throw std::logic_error("Incorrect token");
-                    }
-
-                    if(app_.FindPlayerByToken(token)){
-                        /* Запрос без ошибок */
-                        return action(std::move(req), token);
-                    }
-
-                    return MakeErrorResponse(http::status::unauthorized, 
-                        "unknownToken"sv, "Player token has not been found"sv, req.version());
-                } else {
+                if(it == req.end()){
                     throw std::logic_error("Token is missing");
                 }
+                std::optional<Token> token = detail::ParseBearerToken(it->value());
+                if(!token.has_value()){
+                    throw std::logic_error("Incorrect token");
+                }
+                if(auto found = find(*token)){
+                    /* Запрос без ошибок */
+                    return action(std::move(req), found);
+                }
+                return MakeErrorResponse(http::status::unauthorized, 
+                    "unknownToken"sv, "Player token has not been found"sv, req.version());
             } catch(...){
                 return MakeErrorResponse(http::status::unauthorized, 
                     "invalidToken"sv, "Authorization header is missing"sv, req.version());
@@ -323,23 +485,57 @@ private:
         return res;
     }
 
+    /* 
+        Запрос, который читает только снимок игры и может выполняться вне strand.
+        action получает представление сессии игрока из снимка
+    */
+    template <typename Request, typename Fn>
+    ApiResponse ExecuteForSession(const SetMethods& methods, Request&& req, Fn&& action) {
+        std::shared_ptr<const app::GameSnapshot> snapshot = app_.GetSnapshot();
+        return ExecuteAuthorized(methods, req, [&snapshot](const Token& token){
+            return snapshot->FindSession(token);
+        }, action);
+    }
+
+    /* Запрос, который выполняется в strand. action получает игрока */
+    template <typename Request, typename Fn>
+    ApiResponse ExecuteForPlayer(const SetMethods& methods, Request&& req, Fn&& action) {
+        return ExecuteAuthorized(methods, req, [this](const Token& token){
+            return app_.FindPlayerByToken(token);
+        }, action);
+    }
+
     template<typename Request>
-    StringResponse MakePlayerListResponse(Request&& req){
+    ApiResponse MakePlayerListResponse(Request&& req){
         SetMethods available_methods("GET", "HEAD");
-        return ExecuteAuthorized(available_methods, req, [this](Request&& req, const Token& token){
-                std::string body = this->app_.GetPlayerList(token);
-                return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
-                    "application/json"s);
+        return ExecuteForSession(available_methods, req, 
+            [this](Request&& req, const app::GameSnapshot::SessionView* session) -> ApiResponse{
+                return this->MakeSharedResponse(http::status::ok, session->players, 
+                    req.version(), "application/json"s);
         });
     }
 
     template<typename Request>
-    StringResponse MakeGameStateResponse(Request&& req){
+    ApiResponse MakeGameStateResponse(Request&& req, const router::RouteParams& params){
         SetMethods available_methods("GET", "HEAD");
-        return ExecuteAuthorized(available_methods, req, [this](Request&& req, const Token& token){
-                std::string body = this->app_.GetGameState(token);
-                return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
-                    "application/json"s);
+        /* Параметр since запрашивает только изменения, начиная с указанного тика */
+        if(auto since_param = params.GetQueryParam("since")){
+            return ExecuteForPlayer(available_methods, req, 
+                [this, since_param](Request&& req, const Player* player) -> ApiResponse{
+                    std::optional<uint64_t> since = detail::ParseNumber<uint64_t>(*since_param);
+                    if(!since.has_value()){
+                        return this->MakeErrorResponse(http::status::bad_request, 
+                            "invalidArgument"sv, "Invalid since parameter"sv, req.version());
+                    }
+                    return this->MakeSharedResponse(http::status::ok, this->app_.GetGameStateDelta(player, *since), 
+                        req.version(), "application/json"s);
+            });
+        }
+
+        return ExecuteForSession(available_methods, req, 
+            [this](Request&& req, const app::GameSnapshot::SessionView* session) -> ApiResponse{
+                return this->MakeSharedResponse(http::status::ok, session->state, 
+                    req.version(), "application/json"s);
         });
     }
 
@@ -377,28 +573,32 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakeActionResponse(Request&& req){
+    ApiResponse MakeActionResponse(Request&& req){
         if(auto it = req.find(http::field::content_type); it != req.end()){
             if(it->value() == "application/json"s){
-                try{
-                    json::object action = json::parse(req.body()).as_object();
-                    if(auto it = action.find("move"); it != action.end()){
-                        /* Запрос без ошибок */
-                        SetMethods available_methods("POST");
-                        return ExecuteAuthorized(available_methods, req, [this, &action](Request&& req, const Token& token){
-                            std::string body = this->app_.ApplyPlayerAction(action, token);
-                            return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
-                            "application/json"s);
-                        });
-                    } else{
-                        throw std::runtime_error("Failed to parse action");
+                /* Обычное тело {"move":"L"} разбирается без json::parse */
+                std::optional<std::string_view> move = detail::ParseMoveAction(req.body());
+                json::value action;
+                if(!move.has_value()){
+                    try{
+                        action = json::parse(req.body());
+                        move = action.as_object().at("move").as_string();
+                        if(!detail::IsValidMove(*move)){
+                            throw std::logic_error("Incorrect move");
+                        }
+                    } catch(std::exception& ex){
+                        return MakeErrorResponse(http::status::bad_request, 
+                            "invalidArgument"sv, "Failed to parse action"sv, req.version());
                     }
-
-                } catch(std::exception& ex){
-                    auto res =  MakeErrorResponse(http::status::bad_request, 
-                    "invalidArgument"sv, "Failed to parse action"sv, req.version());
-                    return res;
                 }
+
+                /* Запрос без ошибок */
+                SetMethods available_methods("POST");
+                return ExecuteForPlayer(available_methods, req, [this, move = *move](Request&& req, Player* player){
+                    std::string body = this->app_.ApplyPlayerAction(player, move);
+                    return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                    "application/json"s);
+                });
             }
         }
         auto res =  MakeErrorResponse(http::status::bad_request, 
@@ -406,33 +606,92 @@ private:
         return res;
     }
 
+    /*
+        Действия многих игроков одним запросом:
+        [{"token": "<токен>", "move": "L"}, ...].
+        Каждое действие авторизуется своим токеном. Если хотя бы одно действие
+        неверно или его токен неизвестен, не применяется ни одно
+    */
     template<typename Request>
-    StringResponse MakeRecordsResponse(Request&& req){
+    ApiResponse MakeBatchActionResponse(Request&& req){
+        SetMethods methods("POST");
+        std::string method = std::string(req.method_string());
+        if(!methods.IsSame(method)){
+            auto res =  MakeErrorResponse(http::status::method_not_allowed, 
+                "invalidMethod"sv, "Only POST method is expected"sv, req.version());
+            res.insert("Allow"s, methods.MakeSequence());
+            return res;
+        }
+
+        auto it = req.find(http::field::content_type);
+        if(it == req.end() || it->value() != "application/json"sv){
+            return MakeErrorResponse(http::status::bad_request, 
+                "invalidArgument"sv, "Invalid content type"sv, req.version());
+        }
+
+        json::value body;
+        std::vector<app::PlayerAction> actions;
+        try{
+            body = json::parse(req.body());
+            const json::array& items = body.as_array();
+            actions.reserve(items.size());
+            for(const json::value& item : items){
+                const json::object& action = item.as_object();
+                std::string_view token = action.at("token").as_string();
+                if(token.size() != Token::HEX_SIZE){
+                    throw std::logic_error("Incorrect token");
+                }
+                /* Запись, которая не разбирается как число, не совпадает ни с одним токеном */
+                std::optional<Token> parsed_token = Token::FromHex(token);
+                Player* player = parsed_token ? app_.FindPlayerByToken(*parsed_token) : nullptr;
+                if(!player){
+                    return MakeErrorResponse(http::status::unauthorized, 
+                        "unknownToken"sv, "Player token has not been found"sv, req.version());
+                }
+                std::string_view move = action.at("move").as_string();
+                if(!detail::IsValidMove(move)){
+                    throw std::logic_error("Incorrect move");
+                }
+                actions.push_back({player, move});
+            }
+        } catch(std::exception& ex){
+            return MakeErrorResponse(http::status::bad_request, 
+                "invalidArgument"sv, "Failed to parse actions"sv, req.version());
+        }
+
+        app_.ApplyPlayerActions(actions);
+        return MakeResponse(http::status::ok, "{}"sv, req.version(), 2, "application/json"s);
+    }
+
+    template<typename Request>
+    StringResponse MakeRecordsResponse(Request&& req, const router::RouteParams& params){
         SetMethods methods("GET", "HEAD");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
-            std::string target = std::string(req.target());
-            
             unsigned start = 0;
             unsigned max_items = 100;
-            try{
-                auto url_args = detail::ParseTargetArgs(target);
-                if(url_args.contains("start")){
-                    start = std::stol(url_args.at("start"));
-                }
-
-                if(url_args.contains("maxItems")){
-                    max_items = std::stol(url_args.at("maxItems"));
-                }
-            } catch(...){ 
+            /* Некорректные значения параметров заменяются значениями по умолчанию */
+            if(auto start_param = params.GetQueryParam("start")){
+                start = detail::ParseNumber<unsigned>(*start_param).value_or(start);
+            }
+            if(auto max_items_param = params.GetQueryParam("maxItems")){
+                max_items = detail::ParseNumber<unsigned>(*max_items_param).value_or(max_items);
             }
 
             if(max_items > 100){
                 throw std::logic_error("Incorrect maxItems parameter");
             }
+            /* Если состав страницы не изменился, клиент может использовать сохранённую копию */
+            std::string etag = app_.GetRecordsETag(start, max_items);
+            if(detail::MatchesETag(req[http::field::if_none_match], etag)){
+                return MakeNotModifiedResponse(etag, req.version());
+            }
+
             std::string body = app_.GetRecords(start, max_items);
-            return MakeResponse(http::status::ok, body, 
+            auto res = MakeResponse(http::status::ok, body, 
                                         req.version(), body.size(), "application/json"s);
+            res.set(http::field::etag, etag);
+            return res;
         }
 
         auto res =  MakeErrorResponse(http::status::method_not_allowed, 
@@ -450,43 +709,101 @@ private:
 class FileHandler : public BaseHandler{
     friend class RequestHandler;
 public:
+    /* 
+        Файлы отдаются из кэша в памяти. Текстовые файлы отдаются сжатыми,
+        если клиент это принимает, а на условный запрос с актуальным ETag отвечаем 304
+    */
     template<typename Request>
     VariantResponse MakeFileResponse(Request&& req){    
-        FileResponse response;
-        if(req.target() == "/"){
-            req.target("/index.html");
+        std::string_view target = req.target();
+        target = target.substr(0, target.find('?'));
+        if(target == "/"sv){
+            target = "/index.html"sv;
         }
 
-        http::file_body::value_type file;
-        std::string uncoded_target = detail::DecodeTarget(req.target().substr(1));
-        std::string content_type = GetRequiredContentType(req.target());
-
-        fs::path required_path(uncoded_target);
-        fs::path summary_path = fs::weakly_canonical(static_path_ / required_path);
-        if (sys::error_code ec; file.open(summary_path.string().data(), beast::file_mode::read, ec), ec) {
+        /* Путь, выходящий за корень статики, в кэше не найдётся */
+        const std::string path = fs::path(detail::DecodeTarget(target.substr(1))).lexically_normal().generic_string();
+        const static_cache::AssetPtr asset = cache_.Find(path);
+        if(!asset){
             std::string empty_body;
             return MakeResponse(http::status::not_found, empty_body,  
                                             req.version(), empty_body.size(), "text/plain");
         }
-        
-        response.version(req.version());
-        response.result(http::status::ok);
-        response.insert(http::field::content_type, content_type);
-        response.body() = std::move(file);
-        // Метод prepare_payload заполняет заголовки Content-Length и Transfer-Encoding
-        // в зависимости от свойств тела сообщения
-        response.prepare_payload();
 
-        return response;
+        return MakeEncodedResponse(req, asset->body, asset->content_type, asset->cache_control);
     }
 private:
-    explicit FileHandler(fs::path static_path)
-        : static_path_(fs::canonical(static_path)){
+    FileHandler(const fs::path& static_path, net::any_io_executor executor)
+        : cache_(static_path, &FileHandler::GetRequiredContentType){
+        cache_.Watch(std::move(executor));
     }
 
-    std::string GetRequiredContentType(std::string_view req_target);
+    static std::string GetRequiredContentType(std::string_view req_target);
 
-    fs::path static_path_;
+    static_cache::StaticCache cache_;
+};
+
+/* -------------------------- MetricsHandler --------------------------------- */
+
+class MetricsHandler : public BaseHandler{
+    friend class RequestHandler;
+public:
+    /* Метрики сервера в текстовом формате Prometheus */
+    template<typename Request>
+    StringResponse MakeMetricsResponse(const Request& req){
+        if(req.method() != http::verb::get && req.method() != http::verb::head){
+            auto res = MakeErrorResponse(http::status::method_not_allowed, 
+                "invalidMethod"sv, "Only GET method is expected"sv, req.version());
+            res.insert("Allow"s, "GET, HEAD"s);
+            return res;
+        }
+        std::string body = metrics::GetRegistry().Render();
+        return MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                            "text/plain; version=0.0.4"s);
+    }
+private:
+    MetricsHandler() = default;
+};
+
+/* -------------------------- AdminHandler --------------------------------- */
+
+class AdminHandler : public BaseHandler{
+    friend class RequestHandler;
+public:
+    /*
+        POST /admin/trace/start начинает запись трассы,
+        POST /admin/trace/stop останавливает её и возвращает трассу в формате Chrome Trace
+    */
+    template<typename Request>
+    StringResponse MakeAdminResponse(const Request& req){
+        if(!enabled_){
+            return MakeErrorResponse(http::status::not_found, "notFound"sv, "Admin API is disabled"sv, req.version());
+        }
+        const std::string_view target = req.target();
+        if(target != "/admin/trace/start"sv && target != "/admin/trace/stop"sv){
+            return MakeErrorResponse(http::status::not_found, "notFound"sv, "Unknown admin request"sv, req.version());
+        }
+        if(req.method() != http::verb::post){
+            auto res = MakeErrorResponse(http::status::method_not_allowed, 
+                "invalidMethod"sv, "Only POST method is expected"sv, req.version());
+            res.insert("Allow"s, "POST"s);
+            return res;
+        }
+
+        if(target == "/admin/trace/start"sv){
+            tracing::Start();
+            return MakeResponse(http::status::ok, "{}"sv, req.version(), 2, "application/json"s);
+        }
+        tracing::Stop();
+        std::string body = tracing::DumpChromeTrace();
+        return MakeResponse(http::status::ok, body, req.version(), body.size(), "application/json"s);
+    }
+private:
+    explicit AdminHandler(bool enabled)
+        : enabled_(enabled){
+    }
+
+    bool enabled_;
 };
 
 /* ------------------------- RequestHandler ---------------------------------- */
@@ -496,26 +813,54 @@ public:
     explicit RequestHandler(model::Game& game, const cmd_parser::Args& args, Strand api_strand, DatabaseManagerPtr&& db_manager)
         : game_{game}, 
         api_handler_{game, api_strand, args.tick_period, args.state_file, args.save_state_period, args.randomize_spawn_points, std::move(db_manager)},
-        file_handler_{args.www_root}{}
+        file_handler_{args.www_root, api_strand.get_inner_executor()},
+        admin_handler_{args.admin_api}{}
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
     template<typename Request, typename Send>
-    void operator()(Request&& req, Send&& send) {
+    void operator()(Request&& req, Send&& send_response) {
         // Обработать запрос request и отправить ответ, используя send
+
+        /* Время обработки запроса записывается в метрики перед отправкой ответа */
+        const std::string_view route = detail::GetRouteLabel(req.target());
+        auto send = [send_response, route, start = Clock::now()](auto&& response){
+            const auto end = Clock::now();
+            detail::ObserveRequest(route, response.result_int(), end - start);
+            tracing::Record(route, "http", start, end);
+            send_response(std::forward<decltype(response)>(response));
+        };
+
+        if(route == detail::METRICS_TARGET){
+            return send(metrics_handler_.MakeMetricsResponse(req));
+        }
+
+        if(route == detail::ADMIN_PREFIX){
+            return send(admin_handler_.MakeAdminResponse(req));
+        }
     
         /* Api запросы обрабатывает ApiHandler*/
-        if(detail::IsMatched(std::string(req.target()), "(/api/).*")){
-            auto handle = [self = shared_from_this(), send, req] {
-                try {
-                    // Этот assert не выстрелит, так как лямбда-функция будет выполняться внутри strand
-                    assert(self->api_handler_.GetStrand().running_in_this_thread());
-                    return send(self->api_handler_.MakeApiResponse(req));
-                } catch (...) {
-                    send(self->api_handler_.MakeErrorResponse(http::status::bad_request, 
-                        "badRequest"sv, "Bad request"sv, req.version()));
+        if(req.target().starts_with("/api/"sv)){
+            /* 
+                Запросы на чтение обслуживаются по снимку игры прямо в потоке соединения.
+                Если снимок отстаёт от игры, запрос сначала обновляет его в strand
+            */
+            const bool read_only = ApiHandler::IsReadOnly(req);
+            if(read_only && !api_handler_.IsSnapshotStale()){
+                return SendApiResponse(req, send);
+            }
+
+            auto handle = [self = shared_from_this(), send, req, read_only, queued = Clock::now()] {
+                // Этот assert не выстрелит, так как лямбда-функция будет выполняться внутри strand
+                assert(self->api_handler_.GetStrand().running_in_this_thread());
+                const auto dequeued = Clock::now();
+                detail::ObserveStrandDelay(dequeued - queued);
+                tracing::Record("strand_wait", "http", queued, dequeued);
+                if(read_only){
+                    self->api_handler_.RefreshSnapshot();
                 }
+                self->SendApiResponse(req, send);
             };
             return net::dispatch(api_handler_.GetStrand(), handle);
         }
@@ -528,6 +873,17 @@ public:
                 file_handler_.MakeFileResponse(std::forward<decltype(req)>(req)));  
     }
 
+    /* Запросы на переход в режим WebSocket обрабатываются в strand API, как и остальные запросы к API */
+    template<typename Request>
+    void Upgrade(Request&& req, std::shared_ptr<http_server::WebSocketSession> ws_session){
+        auto handle = [self = shared_from_this(), req = std::forward<Request>(req), ws_session = std::move(ws_session),
+                        queued = Clock::now()]() mutable {
+            detail::ObserveStrandDelay(Clock::now() - queued);
+            self->api_handler_.Subscribe(std::move(req), std::move(ws_session));
+        };
+        net::dispatch(api_handler_.GetStrand(), std::move(handle));
+    }
+
     void SaveState(){
         api_handler_.SaveState();
     }
@@ -537,9 +893,25 @@ public:
     }
 
 private:
+    template<typename Request, typename Send>
+    void SendApiResponse(const Request& req, const Send& send){
+        try {
+            std::visit(
+                [&send](auto&& result) {
+                    send(std::forward<decltype(result)>(result));
+                },
+                api_handler_.MakeApiResponse(req));
+        } catch (...) {
+            send(api_handler_.MakeErrorResponse(http::status::bad_request, 
+                "badRequest"sv, "Bad request"sv, req.version()));
+        }
+    }
+
     model::Game& game_;
     ApiHandler api_handler_;
     FileHandler file_handler_;
+    MetricsHandler metrics_handler_;
+    AdminHandler admin_handler_;
 };
 
 }  // namespace request_handler
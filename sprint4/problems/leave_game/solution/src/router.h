@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace router {
+
+/* Конечные точки API */
+enum class Endpoint {
+    MAPS_LIST,
+    MAP_DESCRIPTION,
+    JOIN_GAME,
+    PLAYERS_LIST,
+    GAME_STATE,
+    TICK,
+    PLAYER_ACTION,
+    PLAYER_ACTIONS,
+    RECORDS
+};
+
+/*
+    Шаблон маршрута задаётся путём из сегментов, разделённых '/'.
+    Сегмент вида {name} совпадает с любым непустым сегментом
+    и сохраняется как параметр пути с именем name
+*/
+struct Route {
+    std::string_view pattern;
+    Endpoint endpoint;
+};
+
+inline constexpr std::array ROUTES{
+    Route{"/api/v1/maps", Endpoint::MAPS_LIST},
+    Route{"/api/v1/maps/{id}", Endpoint::MAP_DESCRIPTION},
+    Route{"/api/v1/game/join", Endpoint::JOIN_GAME},
+    Route{"/api/v1/game/players", Endpoint::PLAYERS_LIST},
+    Route{"/api/v1/game/state", Endpoint::GAME_STATE},
+    Route{"/api/v1/game/tick", Endpoint::TICK},
+    Route{"/api/v1/game/player/action", Endpoint::PLAYER_ACTION},
+    Route{"/api/v1/game/player/actions", Endpoint::PLAYER_ACTIONS},
+    Route{"/api/v1/game/records", Endpoint::RECORDS},
+};
+
+/*
+    Параметры пути и строки запроса.
+    Значения ссылаются на цель запроса и не декодируются,
+    поэтому RouteParams нельзя использовать дольше самого запроса
+*/
+class RouteParams {
+public:
+    static constexpr size_t MAX_PATH_PARAMS = 4;
+    static constexpr size_t MAX_QUERY_PARAMS = 16;
+    using Param = std::pair<std::string_view, std::string_view>;
+
+    constexpr std::optional<std::string_view> GetPathParam(std::string_view name) const {
+        return Find(path_, path_count_, name);
+    }
+
+    constexpr std::optional<std::string_view> GetQueryParam(std::string_view name) const {
+        return Find(query_, query_count_, name);
+    }
+
+    constexpr bool AddPathParam(std::string_view name, std::string_view value) {
+        return Add(path_, path_count_, name, value);
+    }
+
+    /* Параметры сверх MAX_QUERY_PARAMS отбрасываются */
+    constexpr bool AddQueryParam(std::string_view name, std::string_view value) {
+        return Add(query_, query_count_, name, value);
+    }
+
+private:
+    template <size_t N>
+    static constexpr std::optional<std::string_view> Find(const std::array<Param, N>& params, size_t count,
+                                                            std::string_view name) {
+        for (size_t i = 0; i < count; ++i) {
+            if (params[i].first == name) {
+                return params[i].second;
+            }
+        }
+        return std::nullopt;
+    }
+
+    template <size_t N>
+    static constexpr bool Add(std::array<Param, N>& params, size_t& count,
+                                std::string_view name, std::string_view value) {
+        if (count == N) {
+            return false;
+        }
+        params[count++] = {name, value};
+        return true;
+    }
+
+    std::array<Param, MAX_PATH_PARAMS> path_{};
+    size_t path_count_ = 0;
+    std::array<Param, MAX_QUERY_PARAMS> query_{};
+    size_t query_count_ = 0;
+};
+
+struct RouteMatch {
+    Endpoint endpoint;
+    RouteParams params;
+};
+
+namespace detail {
+
+/* Отделяет от строки часть до разделителя separator, сам разделитель отбрасывается */
+constexpr std::string_view NextSegment(std::string_view& str, char separator) {
+    size_t pos = str.find(separator);
+    std::string_view segment = str.substr(0, pos);
+    str.remove_prefix(pos == str.npos ? str.size() : pos + 1);
+    return segment;
+}
+
+constexpr bool IsPlaceholder(std::string_view segment) {
+    return segment.size() > 2 && segment.front() == '{' && segment.back() == '}';
+}
+
+/* Отделяет от пути сегмент, следующий за начальным '/'. Сам разделитель после сегмента остаётся в пути */
+constexpr std::string_view TakePathSegment(std::string_view& path) {
+    path.remove_prefix(1);
+    size_t pos = path.find('/');
+    std::string_view segment = path.substr(0, pos);
+    path.remove_prefix(segment.size());
+    return segment;
+}
+
+constexpr bool MatchPath(std::string_view pattern, std::string_view path, RouteParams& params) {
+    while (!pattern.empty() && !path.empty()) {
+        if (pattern.front() != '/' || path.front() != '/') {
+            return false;
+        }
+        std::string_view pattern_segment = TakePathSegment(pattern);
+        std::string_view path_segment = TakePathSegment(path);
+        if (IsPlaceholder(pattern_segment)) {
+            if (path_segment.empty()
+                || !params.AddPathParam(pattern_segment.substr(1, pattern_segment.size() - 2), path_segment)) {
+                return false;
+            }
+        } else if (pattern_segment != path_segment) {
+            return false;
+        }
+    }
+    return pattern.empty() && path.empty();
+}
+
+constexpr void ParseQuery(std::string_view query, RouteParams& params) {
+    while (!query.empty()) {
+        std::string_view arg = NextSegment(query, '&');
+        if (arg.empty()) {
+            continue;
+        }
+        std::string_view name = NextSegment(arg, '=');
+        params.AddQueryParam(name, arg);
+    }
+}
+
+constexpr bool HasDuplicatePatterns() {
+    for (size_t i = 0; i < ROUTES.size(); ++i) {
+        for (size_t j = i + 1; j < ROUTES.size(); ++j) {
+            if (ROUTES[i].pattern == ROUTES[j].pattern) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}  // namespace detail
+
+/*
+    Находит маршрут для цели запроса вида /path?query.
+    Таблица маршрутов небольшая и известна на этапе компиляции,
+    сопоставление идёт по сегментам без выделения памяти
+*/
+constexpr std::optional<RouteMatch> Match(std::string_view target) {
+    std::string_view path = detail::NextSegment(target, '?');
+    for (const Route& route : ROUTES) {
+        RouteParams params;
+        if (detail::MatchPath(route.pattern, path, params)) {
+            detail::ParseQuery(target, params);
+            return RouteMatch{route.endpoint, params};
+        }
+    }
+    return std::nullopt;
+}
+
+/* Шаблон пути конечной точки, например для меток метрик */
+constexpr std::string_view GetPattern(Endpoint endpoint) {
+    for (const Route& route : ROUTES) {
+        if (route.endpoint == endpoint) {
+            return route.pattern;
+        }
+    }
+    return {};
+}
+
+static_assert(!detail::HasDuplicatePatterns(), "Route patterns must be unique");
+static_assert(Match("/api/v1/maps")->endpoint == Endpoint::MAPS_LIST);
+static_assert(Match("/api/v1/maps/map1")->params.GetPathParam("id") == "map1");
+static_assert(!Match("/api/v1/maps/"));
+static_assert(!Match("/api/v1/maps/map1/extra"));
+static_assert(Match("/api/v1/game/records?start=5&maxItems=10")->params.GetQueryParam("maxItems") == "10");
+static_assert(!Match("/api/v1/game/unknown"));
+static_assert(Match("/api/v1/game/player/actions")->endpoint == Endpoint::PLAYER_ACTIONS);
+static_assert(GetPattern(Endpoint::MAP_DESCRIPTION) == "/api/v1/maps/{id}");
+
+}  // namespace router
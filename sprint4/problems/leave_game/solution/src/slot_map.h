@@ -0,0 +1,165 @@
+#pragma once
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * Вспомогательный шаблонный класс "Slot map".
+ * Хранит объекты плотно в одном векторе, а доступ к конкретному объекту
+ * выдаёт через стабильный дескриптор (Handle) с номером поколения.
+ *
+ * - Добавление и удаление выполняются за O(1):
+ *   при удалении на место удалённого объекта переносится последний.
+ * - Дескриптор остаётся валидным, пока объект жив, даже если объект
+ *   был перемещён внутри вектора. После удаления дескриптор
+ *   перестаёт находить объект, даже если его слот занят новым.
+ * - Адреса объектов нестабильны: указатели и ссылки на элементы
+ *   нельзя хранить дольше, чем до следующего добавления или удаления.
+ *
+ * Порядок обхода - порядок плотного хранения,
+ * и индекс в нём можно использовать для доступа через operator[].
+ */
+template <typename Value>
+class SlotMap {
+public:
+    using Values = std::vector<Value>;
+    using iterator = typename Values::iterator;
+    using const_iterator = typename Values::const_iterator;
+
+    struct Handle {
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        auto operator<=>(const Handle&) const = default;
+    };
+
+    template <typename... Args>
+    Handle Emplace(Args&&... args) {
+        values_.emplace_back(std::forward<Args>(args)...);
+
+        uint32_t slot_index;
+        if(!free_slots_.empty()){
+            slot_index = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            slot_index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(Slot{});
+        }
+
+        Slot& slot = slots_[slot_index];
+        slot.dense_index = static_cast<uint32_t>(values_.size() - 1);
+        dense_to_slot_.push_back(slot_index);
+
+        return {slot_index, slot.generation};
+    }
+
+    bool Contains(Handle handle) const {
+        return handle.index < slots_.size()
+            && slots_[handle.index].generation == handle.generation
+            && slots_[handle.index].dense_index != Handle::INVALID_INDEX;
+    }
+
+    Value* Find(Handle handle) {
+        return Contains(handle) ? &values_[slots_[handle.index].dense_index] : nullptr;
+    }
+
+    const Value* Find(Handle handle) const {
+        return Contains(handle) ? &values_[slots_[handle.index].dense_index] : nullptr;
+    }
+
+    /* Дескриптор объекта, лежащего по индексу dense_index плотного хранения */
+    Handle GetHandle(size_t dense_index) const {
+        uint32_t slot_index = dense_to_slot_[dense_index];
+        return {slot_index, slots_[slot_index].generation};
+    }
+
+    bool Erase(Handle handle) {
+        if(!Contains(handle)){
+            return false;
+        }
+        EraseAt(slots_[handle.index].dense_index);
+        return true;
+    }
+
+    /*
+        Удаляет объект по индексу плотного хранения.
+        Последний объект переносится на место удалённого,
+        поэтому при удалении нескольких объектов по индексам
+        их нужно удалять в порядке убывания индексов
+    */
+    void EraseAt(size_t dense_index) {
+        const size_t last_index = values_.size() - 1;
+        const uint32_t erased_slot = dense_to_slot_[dense_index];
+
+        if(dense_index != last_index){
+            values_[dense_index] = std::move(values_[last_index]);
+            dense_to_slot_[dense_index] = dense_to_slot_[last_index];
+            slots_[dense_to_slot_[dense_index]].dense_index = static_cast<uint32_t>(dense_index);
+        }
+        values_.pop_back();
+        dense_to_slot_.pop_back();
+
+        Slot& slot = slots_[erased_slot];
+        slot.dense_index = Handle::INVALID_INDEX;
+        ++slot.generation;
+        free_slots_.push_back(erased_slot);
+    }
+
+    void Clear() {
+        while(!values_.empty()){
+            EraseAt(values_.size() - 1);
+        }
+    }
+
+    Value& operator[](size_t dense_index) {
+        return values_[dense_index];
+    }
+
+    const Value& operator[](size_t dense_index) const {
+        return values_[dense_index];
+    }
+
+    size_t size() const {
+        return values_.size();
+    }
+
+    bool empty() const {
+        return values_.empty();
+    }
+
+    iterator begin() {
+        return values_.begin();
+    }
+
+    iterator end() {
+        return values_.end();
+    }
+
+    const_iterator begin() const {
+        return values_.begin();
+    }
+
+    const_iterator end() const {
+        return values_.end();
+    }
+
+private:
+    struct Slot {
+        uint32_t dense_index = Handle::INVALID_INDEX;
+        uint32_t generation = 0;
+    };
+
+    Values values_;
+    std::vector<uint32_t> dense_to_slot_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
+};
+
+}  // namespace util
@@ -0,0 +1,173 @@
+#include "state_writer.h"
+#include "file_descriptor.h"
+#include "logger.h"
+#include "metrics.h"
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <fstream>
+#include <sstream>
+
+namespace serialization {
+
+using namespace std::literals;
+
+namespace {
+
+template <typename InputArchive>
+bool TryReadState(const std::filesystem::path& state_file, GameStateRepr& state){
+    std::ifstream in(state_file, std::ios::in | std::ios::binary);
+    if(!in){
+        return false;
+    }
+    try{
+        InputArchive input_archive{in};
+        input_archive >> state;
+        return true;
+    } catch(...){
+        state = GameStateRepr{};
+        return false;
+    }
+}
+
+std::chrono::microseconds ToMicroseconds(std::chrono::nanoseconds duration){
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+/* Длительность и размер записанного снимка попадают в метрики сервера */
+void ObserveStateSaved(uintmax_t size, std::chrono::nanoseconds capture_time, std::chrono::nanoseconds write_time){
+    metrics::Registry& registry = metrics::GetRegistry();
+    static metrics::Histogram& capture = registry.AddHistogram("state_snapshot_capture_seconds"s, 
+        "Time spent copying the game state in the API strand"s).WithLabels({});
+    static metrics::Histogram& write = registry.AddHistogram("state_snapshot_write_seconds"s, 
+        "Time spent writing a state snapshot to disk"s).WithLabels({});
+    static metrics::Gauge& size_bytes = registry.AddGauge("state_snapshot_size_bytes"s, 
+        "Size of the last written state snapshot"s).WithLabels({});
+    capture.Observe(capture_time);
+    write.Observe(write_time);
+    size_bytes.Set(static_cast<double>(size));
+}
+
+void ObserveStateSaveError(){
+    static metrics::Counter& errors = metrics::GetRegistry().AddCounter("state_snapshot_errors_total"s, 
+        "State snapshots that failed to be written"s).WithLabels({});
+    errors.Increment();
+}
+
+}  // namespace
+
+/* ------------------------ StateWriter ----------------------------------- */
+
+StateWriter::StateWriter(std::filesystem::path state_file)
+    : state_file_(std::move(state_file)){
+    worker_ = std::thread([this]{ Run(); });
+}
+
+StateWriter::~StateWriter(){
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    has_work_.notify_one();
+    worker_.join();
+}
+
+void StateWriter::Save(GameStateRepr state, std::chrono::nanoseconds capture_time, std::function<void()> on_saved){
+    {
+        std::lock_guard lock{mutex_};
+        pending_.emplace(PendingState{std::move(state), capture_time, std::move(on_saved)});
+        ++requested_;
+    }
+    has_work_.notify_one();
+}
+
+void StateWriter::Flush(){
+    std::unique_lock lock{mutex_};
+    const uint64_t target = requested_;
+    saved_.wait(lock, [this, target]{
+        return written_ >= target;
+    });
+}
+
+StateSaveStats StateWriter::GetStats() const{
+    std::lock_guard lock{mutex_};
+    return stats_;
+}
+
+void StateWriter::Run(){
+    std::unique_lock lock{mutex_};
+    while(true){
+        has_work_.wait(lock, [this]{
+            return stop_ || pending_.has_value();
+        });
+        if(!pending_){
+            return;
+        }
+
+        PendingState pending = std::move(*pending_);
+        pending_.reset();
+        const uint64_t sequence = requested_;
+        lock.unlock();
+
+        const auto start = std::chrono::steady_clock::now();
+        std::optional<uintmax_t> size;
+        try{
+            size = WriteStateFile(state_file_, pending.state);
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "state save"s);
+            ObserveStateSaveError();
+        }
+        const auto write_time = ToMicroseconds(std::chrono::steady_clock::now() - start);
+        if(size){
+            LOG_STATE_SAVED(*size, ToMicroseconds(pending.capture_time).count(), write_time.count());
+            ObserveStateSaved(*size, pending.capture_time, write_time);
+            if(pending.on_saved){
+                pending.on_saved();
+            }
+        }
+
+        lock.lock();
+        if(size){
+            ++stats_.saved_count;
+            stats_.capture_time = ToMicroseconds(pending.capture_time);
+            stats_.write_time = write_time;
+            stats_.size = *size;
+        }
+        written_ = sequence;
+        saved_.notify_all();
+    }
+}
+
+/* ------------------------ WriteStateFile ----------------------------------- */
+
+uintmax_t WriteStateFile(const std::filesystem::path& state_file, const GameStateRepr& state){
+    std::ostringstream buffer(std::ios::out | std::ios::binary);
+    {
+        boost::archive::binary_oarchive output_archive{buffer};
+        output_archive << state;
+    }
+    const std::string data = std::move(buffer).str();
+
+    std::filesystem::path temp_file = state_file;
+    temp_file += ".tmp"s;
+    {
+        util::FileDescriptor file(temp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        file.Write(data);
+        file.Sync();
+    }
+    std::filesystem::rename(temp_file, state_file);
+    /* Переименование попадает на диск только вместе с каталогом */
+    util::SyncParentDirectory(state_file);
+    return data.size();
+}
+
+/* ------------------------ ReadStateFile ----------------------------------- */
+
+GameStateRepr ReadStateFile(const std::filesystem::path& state_file){
+    GameStateRepr state;
+    if(!TryReadState<boost::archive::binary_iarchive>(state_file, state)){
+        TryReadState<boost::archive::text_iarchive>(state_file, state);
+    }
+    return state;
+}
+
+}  // namespace serialization
@@ -0,0 +1,87 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "model_serialization.h"
+
+namespace serialization {
+
+struct StateSaveStats{
+    uint64_t saved_count = 0;
+    /* Сколько занял последний снимок: копирование состояния на strand и запись на диск */
+    std::chrono::microseconds capture_time{0};
+    std::chrono::microseconds write_time{0};
+    /* Размер последнего записанного файла в байтах */
+    uintmax_t size = 0;
+};
+
+/*
+    Фоновая запись снимков состояния игры.
+    Save только забирает готовую копию состояния, а двоичный архив
+    формируется и записывается на диск в собственном потоке.
+    Если предыдущий снимок ещё не записан, он заменяется новым:
+    на диске нужно только самое свежее состояние.
+    При уничтожении последний снимок дописывается
+*/
+class StateWriter{
+public:
+    explicit StateWriter(std::filesystem::path state_file);
+
+    StateWriter(const StateWriter&) = delete;
+    StateWriter& operator=(const StateWriter&) = delete;
+
+    ~StateWriter();
+
+    /* 
+        on_saved вызывается в фоновом потоке, когда снимок надёжно записан на диск.
+        Для снимка, заменённого более новым, on_saved не вызывается
+    */
+    void Save(GameStateRepr state, std::chrono::nanoseconds capture_time, std::function<void()> on_saved = {});
+
+    /* Дожидается записи всех снимков, переданных в Save до вызова */
+    void Flush();
+
+    StateSaveStats GetStats() const;
+
+private:
+    struct PendingState{
+        GameStateRepr state;
+        std::chrono::nanoseconds capture_time;
+        std::function<void()> on_saved;
+    };
+
+    void Run();
+
+    std::filesystem::path state_file_;
+    mutable std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::condition_variable saved_;
+    std::optional<PendingState> pending_;
+    /* Номер последнего переданного и последнего записанного снимка */
+    uint64_t requested_ = 0;
+    uint64_t written_ = 0;
+    StateSaveStats stats_;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+/* 
+    Записывает состояние в двоичный архив рядом с файлом state_file,
+    сбрасывает его на диск и атомарно заменяет им state_file.
+    При сбое во время записи прежний файл состояния остаётся целым.
+    Возвращает размер файла
+*/
+uintmax_t WriteStateFile(const std::filesystem::path& state_file, const GameStateRepr& state);
+
+/* 
+    Читает состояние из двоичного архива, а если это не удалось - из текстового,
+    в котором состояние сохранялось раньше. Если файла нет или он повреждён, возвращает пустое состояние
+*/
+GameStateRepr ReadStateFile(const std::filesystem::path& state_file);
+
+}  // namespace serialization
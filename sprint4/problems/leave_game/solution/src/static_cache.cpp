@@ -0,0 +1,183 @@
+#include "static_cache.h"
+#include "logger.h"
+#include <sys/inotify.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace static_cache {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                | IN_DELETE_SELF | IN_ONLYDIR;
+
+bool IsCompressible(std::string_view content_type){
+    return content_type.starts_with("text/"sv) || content_type == "application/json"sv
+        || content_type == "application/xml"sv || content_type == "image/svg+xml"sv;
+}
+
+/* HTML запрашивается заново при каждом переходе, остальные файлы кэшируются браузером на час */
+std::string GetCacheControl(std::string_view content_type){
+    return content_type == "text/html"sv ? "no-cache"s : "public, max-age=3600"s;
+}
+
+std::string ReadFile(const fs::path& path){
+    std::ifstream file(path, std::ios::binary);
+    if(!file){
+        throw std::runtime_error("Failed to open "s + path.string());
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    return std::move(content).str();
+}
+
+}  // namespace
+
+StaticCache::StaticCache(fs::path root, ContentTypeResolver get_content_type)
+    : root_(fs::canonical(root))
+    , get_content_type_(std::move(get_content_type)){
+    auto assets = std::make_shared<Assets>();
+    LoadTree(root_, *assets);
+    assets_ = std::move(assets);
+}
+
+AssetPtr StaticCache::Find(std::string_view path) const{
+    const std::shared_ptr<const Assets> assets = std::atomic_load_explicit(&assets_, std::memory_order_acquire);
+    if(auto it = assets->find(path); it != assets->end()){
+        return it->second;
+    }
+    return nullptr;
+}
+
+std::string StaticCache::GetKey(const fs::path& path) const{
+    return path.lexically_relative(root_).generic_string();
+}
+
+AssetPtr StaticCache::LoadAsset(const fs::path& path) const{
+    std::string content_type = get_content_type_(GetKey(path));
+    std::string cache_control = GetCacheControl(content_type);
+    const bool compress = IsCompressible(content_type);
+    return std::make_shared<const Asset>(Asset{std::move(content_type), std::move(cache_control),
+                                                compression::EncodedBody(ReadFile(path), compress)});
+}
+
+void StaticCache::LoadTree(const fs::path& dir, Assets& assets) const{
+    for(const fs::directory_entry& entry : fs::recursive_directory_iterator(dir)){
+        if(entry.is_regular_file()){
+            assets[GetKey(entry.path())] = LoadAsset(entry.path());
+        }
+    }
+}
+
+void StaticCache::Update(const fs::path& path){
+    std::lock_guard lock{update_mutex_};
+    auto assets = std::make_shared<Assets>(*std::atomic_load_explicit(&assets_, std::memory_order_acquire));
+
+    /* Убираем прежнее содержимое пути: сам файл или все файлы каталога */
+    const std::string key = GetKey(path);
+    const std::string dir_prefix = key + '/';
+    std::erase_if(*assets, [&key, &dir_prefix](const auto& item){
+        return item.first == key || item.first.starts_with(dir_prefix);
+    });
+
+    std::error_code ec;
+    if(fs::is_regular_file(path, ec)){
+        (*assets)[key] = LoadAsset(path);
+    } else if(fs::is_directory(path, ec)){
+        LoadTree(path, *assets);
+    }
+    std::atomic_store_explicit(&assets_, std::shared_ptr<const Assets>(std::move(assets)), std::memory_order_release);
+}
+
+void StaticCache::Reload(){
+    /* Новая таблица собирается с нуля, чтобы в ней не остались файлы, удалённые за время потери событий */
+    auto assets = std::make_shared<Assets>();
+    LoadTree(root_, *assets);
+    std::lock_guard lock{update_mutex_};
+    std::atomic_store_explicit(&assets_, std::shared_ptr<const Assets>(std::move(assets)), std::memory_order_release);
+}
+
+void StaticCache::Watch(net::any_io_executor executor){
+    const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0){
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    }
+    inotify_.emplace(executor, fd);
+    AddWatches(root_);
+    ReadEvents();
+}
+
+void StaticCache::AddWatches(const fs::path& dir){
+    /* inotify не следит за подкаталогами, поэтому наблюдение ставится на каждый каталог */
+    auto add_watch = [this](const fs::path& path){
+        const int wd = ::inotify_add_watch(inotify_->native_handle(), path.c_str(), WATCH_MASK);
+        if(wd >= 0){
+            watches_[wd] = path;
+        }
+    };
+    add_watch(dir);
+    std::error_code ec;
+    for(auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)){
+        if(it->is_directory(ec)){
+            add_watch(it->path());
+        }
+    }
+}
+
+void StaticCache::ReadEvents(){
+    inotify_->async_read_some(net::buffer(events_buffer_), [this](const boost::system::error_code& ec, size_t size){
+        if(ec){
+            if(ec != net::error::operation_aborted){
+                LOG_ERROR(ec.value(), ec.message(), "static files watch"s);
+            }
+            return;
+        }
+        HandleEvents(size);
+        ReadEvents();
+    });
+}
+
+void StaticCache::HandleEvents(size_t size){
+    for(size_t offset = 0; offset + sizeof(inotify_event) <= size;){
+        inotify_event event;
+        std::memcpy(&event, events_buffer_.data() + offset, sizeof(event));
+        const char* name = events_buffer_.data() + offset + sizeof(event);
+        offset += sizeof(event) + event.len;
+
+        try{
+            if(event.mask & IN_Q_OVERFLOW){
+                /* События потеряны: наблюдаем за новыми подкаталогами и перечитываем весь каталог */
+                AddWatches(root_);
+                Reload();
+                continue;
+            }
+            auto it = watches_.find(event.wd);
+            if(it == watches_.end()){
+                continue;
+            }
+            if(event.mask & IN_IGNORED){
+                watches_.erase(it);
+                continue;
+            }
+            if(event.len == 0){
+                continue;
+            }
+            const fs::path path = it->second / name;
+            /* Созданный файл читается, когда его закроют после записи */
+            if((event.mask & IN_CREATE) && !(event.mask & IN_ISDIR)){
+                continue;
+            }
+            if((event.mask & (IN_CREATE | IN_MOVED_TO)) && (event.mask & IN_ISDIR)){
+                AddWatches(path);
+            }
+            Update(path);
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "static files reload"s);
+        }
+    }
+}
+
+}  // namespace static_cache
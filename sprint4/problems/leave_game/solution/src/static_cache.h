@@ -0,0 +1,93 @@
+#pragma once
+#include "compression.h"
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace static_cache {
+
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+/* Файл каталога статики, загруженный в память вместе со всем, что нужно для ответа */
+struct Asset{
+    std::string content_type;
+    std::string cache_control;
+    /* Сжатые варианты готовятся только для текстовых типов */
+    compression::EncodedBody body;
+};
+
+using AssetPtr = std::shared_ptr<const Asset>;
+
+/*
+    Кэш каталога статики. Все файлы читаются при создании, для текстовых типов
+    заранее готовятся сжатые версии. Поиск не блокирует: читатели берут
+    текущий снимок таблицы, а перечитывание файла публикует новый снимок
+*/
+class StaticCache{
+public:
+    /* Тип содержимого по пути файла */
+    using ContentTypeResolver = std::function<std::string(std::string_view path)>;
+
+    StaticCache(fs::path root, ContentTypeResolver get_content_type);
+
+    StaticCache(const StaticCache&) = delete;
+    StaticCache& operator=(const StaticCache&) = delete;
+
+    /* path - путь относительно корня с разделителем '/', например "js/game.js" */
+    AssetPtr Find(std::string_view path) const;
+
+    /*
+        Начинает следить за каталогом через inotify: изменённые и новые файлы
+        перечитываются, удалённые - убираются из кэша. События обрабатываются в executor
+    */
+    void Watch(net::any_io_executor executor);
+
+private:
+    struct PathHasher{
+        using is_transparent = void;
+
+        size_t operator()(std::string_view path) const noexcept{
+            return std::hash<std::string_view>{}(path);
+        }
+    };
+
+    using Assets = std::unordered_map<std::string, AssetPtr, PathHasher, std::equal_to<>>;
+
+    std::string GetKey(const fs::path& path) const;
+    AssetPtr LoadAsset(const fs::path& path) const;
+    void LoadTree(const fs::path& dir, Assets& assets) const;
+
+    /* Перечитывает файл или каталог path, а если его больше нет - удаляет из кэша */
+    void Update(const fs::path& path);
+
+    /* Заново читает весь каталог, когда события inotify потеряны */
+    void Reload();
+
+    void AddWatches(const fs::path& dir);
+    void ReadEvents();
+    void HandleEvents(size_t size);
+
+    fs::path root_;
+    ContentTypeResolver get_content_type_;
+    /* Читается и заменяется через std::atomic_load_explicit/std::atomic_store_explicit, как снимок игры */
+    std::shared_ptr<const Assets> assets_;
+    /* Снимки публикуются по одному, чтобы одновременные обновления не затёрли друг друга */
+    std::mutex update_mutex_;
+
+    std::optional<net::posix::stream_descriptor> inotify_;
+    /* Каталог каждого наблюдения inotify */
+    std::unordered_map<int, fs::path> watches_;
+    alignas(8) std::array<char, 16 * 1024> events_buffer_;
+};
+
+}  // namespace static_cache
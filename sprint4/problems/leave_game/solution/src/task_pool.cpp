@@ -0,0 +1,106 @@
+#include "task_pool.h"
+#include <algorithm>
+#include <utility>
+
+namespace util {
+
+TaskPool::TaskPool(unsigned parallelism){
+    parallelism = std::max(1u, parallelism);
+    workers_.reserve(parallelism - 1);
+    for(unsigned i = 1; i < parallelism; ++i){
+        workers_.emplace_back([this]{
+            WorkerLoop();
+        });
+    }
+}
+
+TaskPool::~TaskPool(){
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    job_cond_var_.notify_all();
+    for(std::thread& worker : workers_){
+        worker.join();
+    }
+}
+
+unsigned TaskPool::GetParallelism() const{
+    return static_cast<unsigned>(workers_.size()) + 1;
+}
+
+void TaskPool::ParallelFor(size_t count, const Task& task){
+    /* Нет смысла будить потоки ради одной задачи */
+    if(workers_.empty() || count <= 1){
+        for(size_t idx = 0; idx < count; ++idx){
+            task(idx);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex_};
+        task_ = &task;
+        task_count_ = count;
+        next_task_.store(0, std::memory_order_relaxed);
+        busy_workers_ = workers_.size();
+        error_ = nullptr;
+        ++job_id_;
+    }
+    job_cond_var_.notify_all();
+
+    RunTasks(task, count);
+
+    std::unique_lock lock{mutex_};
+    done_cond_var_.wait(lock, [this]{
+        return busy_workers_ == 0;
+    });
+    task_ = nullptr;
+
+    if(error_){
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void TaskPool::WorkerLoop(){
+    uint64_t last_job_id = 0;
+    while(true){
+        const Task* task = nullptr;
+        size_t count = 0;
+        {
+            std::unique_lock lock{mutex_};
+            job_cond_var_.wait(lock, [this, last_job_id]{
+                return stop_ || job_id_ != last_job_id;
+            });
+            if(stop_){
+                return;
+            }
+            last_job_id = job_id_;
+            task = task_;
+            count = task_count_;
+        }
+
+        RunTasks(*task, count);
+
+        std::lock_guard lock{mutex_};
+        if(--busy_workers_ == 0){
+            done_cond_var_.notify_one();
+        }
+    }
+}
+
+void TaskPool::RunTasks(const Task& task, size_t count){
+    for(size_t idx = next_task_.fetch_add(1, std::memory_order_relaxed); idx < count; 
+            idx = next_task_.fetch_add(1, std::memory_order_relaxed)){
+        try{
+            task(idx);
+        } catch(...){
+            std::lock_guard lock{mutex_};
+            if(!error_){
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+}  // namespace util
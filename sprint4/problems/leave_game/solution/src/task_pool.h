@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+/*
+    Пул потоков для параллельного выполнения независимых задач (fork-join).
+
+    ParallelFor(count, task) вызывает task(i) для каждого i из [0, count)
+    и возвращает управление только после завершения всех вызовов,
+    то есть служит барьером. Вызывающий поток тоже выполняет задачи.
+    Задачи раздаются по одной через атомарный счётчик: освободившийся поток
+    сразу берёт следующую, поэтому тяжёлые задачи не задерживают остальные потоки.
+
+    ParallelFor нельзя вызывать одновременно из нескольких потоков.
+*/
+class TaskPool {
+public:
+    using Task = std::function<void(size_t idx)>;
+
+    /* parallelism - общее число потоков, включая вызывающий */
+    explicit TaskPool(unsigned parallelism);
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    ~TaskPool();
+
+    unsigned GetParallelism() const;
+
+    /* Если какая-то задача выбросила исключение, оно пробрасывается после барьера */
+    void ParallelFor(size_t count, const Task& task);
+
+private:
+    void WorkerLoop();
+
+    void RunTasks(const Task& task, size_t count);
+
+    std::mutex mutex_;
+    std::condition_variable job_cond_var_;
+    std::condition_variable done_cond_var_;
+    const Task* task_ = nullptr;
+    size_t task_count_ = 0;
+    uint64_t job_id_ = 0;
+    size_t busy_workers_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+    std::atomic<size_t> next_task_{0};
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace util
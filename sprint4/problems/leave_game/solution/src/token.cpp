@@ -0,0 +1,64 @@
+#include "token.h"
+#include <stdexcept>
+
+namespace model {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::string_view HEX_DIGITS = "0123456789abcdef"sv;
+
+/* Сервер выдаёт токены в нижнем регистре, поэтому другие записи не совпадут ни с одним токеном */
+std::optional<uint64_t> ParseHalf(std::string_view hex) noexcept {
+    uint64_t value = 0;
+    for(char c : hex){
+        unsigned digit;
+        if(c >= '0' && c <= '9'){
+            digit = c - '0';
+        } else if(c >= 'a' && c <= 'f'){
+            digit = c - 'a' + 10;
+        } else {
+            return std::nullopt;
+        }
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+void WriteHalf(uint64_t value, char* out) {
+    for(int i = 15; i >= 0; --i){
+        out[i] = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    }
+}
+
+}  // namespace
+
+std::optional<Token> Token::FromHex(std::string_view hex) noexcept {
+    if(hex.size() != HEX_SIZE){
+        return std::nullopt;
+    }
+    std::optional<uint64_t> high = ParseHalf(hex.substr(0, HEX_SIZE / 2));
+    std::optional<uint64_t> low = ParseHalf(hex.substr(HEX_SIZE / 2));
+    if(!high.has_value() || !low.has_value()){
+        return std::nullopt;
+    }
+    return Token(*high, *low);
+}
+
+Token Token::Parse(std::string_view hex) {
+    if(std::optional<Token> token = FromHex(hex)){
+        return *token;
+    }
+    throw std::invalid_argument("Invalid player token "s + std::string(hex));
+}
+
+std::string Token::ToHex() const {
+    std::string hex(HEX_SIZE, '0');
+    WriteHalf(high_, hex.data());
+    WriteHalf(low_, hex.data() + HEX_SIZE / 2);
+    return hex;
+}
+
+}  // namespace model
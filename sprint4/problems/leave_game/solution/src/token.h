@@ -0,0 +1,56 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace model {
+
+/*
+    Токен игрока - 128-битное случайное число.
+    В запросах, ответах и файлах состояния записывается
+    32 шестнадцатеричными цифрами в нижнем регистре
+*/
+class Token {
+public:
+    static constexpr size_t HEX_SIZE = 32;
+
+    constexpr Token() = default;
+
+    constexpr Token(uint64_t high, uint64_t low) noexcept
+        : high_(high), low_(low) {
+    }
+
+    /* Токен из шестнадцатеричной записи без выделения памяти. nullopt, если запись неверна */
+    static std::optional<Token> FromHex(std::string_view hex) noexcept;
+
+    /* То же, но для неверной записи выбрасывает std::invalid_argument */
+    static Token Parse(std::string_view hex);
+
+    std::string ToHex() const;
+
+    uint64_t GetHigh() const noexcept {
+        return high_;
+    }
+
+    uint64_t GetLow() const noexcept {
+        return low_;
+    }
+
+    auto operator<=>(const Token&) const = default;
+
+private:
+    uint64_t high_ = 0;
+    uint64_t low_ = 0;
+};
+
+/* Токены случайны, поэтому достаточно дёшево смешать обе половины */
+struct TokenHasher {
+    size_t operator()(const Token& token) const noexcept {
+        uint64_t hash = token.GetLow() ^ (token.GetHigh() * 0x9E3779B97F4A7C15ull);
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+}  // namespace model
@@ -0,0 +1,213 @@
+#include "tracing.h"
+#include <charconv>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tracing {
+
+using namespace std::literals;
+
+namespace {
+
+/* Число отрезков в буфере одного потока */
+constexpr size_t BUFFER_CAPACITY = 1 << 16;
+
+struct SpanRecord{
+    std::string_view name;
+    std::string_view category;
+    SpanArgs args;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+/*
+    Кольцевой буфер отрезков одного потока.
+    Мьютекс почти всегда свободен: его берёт только поток-владелец
+    и, изредка, выгрузка трассы
+*/
+class ThreadBuffer{
+public:
+    explicit ThreadBuffer(uint32_t thread_id)
+        : thread_id_(thread_id){
+    }
+
+    void Add(const SpanRecord& record){
+        std::lock_guard lock{mutex_};
+        if(records_.size() < BUFFER_CAPACITY){
+            records_.push_back(record);
+            return;
+        }
+        records_[next_] = record;
+        next_ = (next_ + 1) % BUFFER_CAPACITY;
+    }
+
+    void Clear(){
+        std::lock_guard lock{mutex_};
+        records_.clear();
+        next_ = 0;
+    }
+
+    /* Вызывает action для отрезков от старых к новым */
+    template <typename Action>
+    void ForEach(Action&& action) const{
+        std::lock_guard lock{mutex_};
+        for(size_t i = 0; i < records_.size(); ++i){
+            action(records_[(next_ + i) % records_.size()]);
+        }
+    }
+
+    uint32_t GetThreadId() const noexcept{
+        return thread_id_;
+    }
+
+private:
+    const uint32_t thread_id_;
+    mutable std::mutex mutex_;
+    std::vector<SpanRecord> records_;
+    /* Позиция самого старого отрезка, когда буфер заполнен */
+    size_t next_ = 0;
+};
+
+/* Буферы всех потоков, которые хоть раз записывали отрезки. Буферы переживают свои потоки */
+class Tracer{
+public:
+    std::shared_ptr<ThreadBuffer> Register(){
+        std::lock_guard lock{mutex_};
+        buffers_.push_back(std::make_shared<ThreadBuffer>(static_cast<uint32_t>(buffers_.size() + 1)));
+        return buffers_.back();
+    }
+
+    void Start(){
+        std::lock_guard lock{mutex_};
+        for(const auto& buffer : buffers_){
+            buffer->Clear();
+        }
+        origin_ = Clock::now();
+        detail::enabled.store(true, std::memory_order_relaxed);
+    }
+
+    std::string Dump() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    /* Момент начала записи, от него отсчитываются метки времени трассы */
+    Clock::time_point origin_ = Clock::now();
+};
+
+Tracer& GetTracer(){
+    static Tracer tracer;
+    return tracer;
+}
+
+ThreadBuffer& GetThreadBuffer(){
+    thread_local const std::shared_ptr<ThreadBuffer> buffer = GetTracer().Register();
+    return *buffer;
+}
+
+void AppendString(std::string& out, std::string_view str){
+    out += '"';
+    for(char c : str){
+        switch(c){
+            case '"':
+                out += "\\\""sv;
+                break;
+            case '\\':
+                out += "\\\\"sv;
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20){
+                    constexpr std::string_view HEX = "0123456789abcdef";
+                    out += "\\u00"sv;
+                    out += HEX[c >> 4];
+                    out += HEX[c & 0xF];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+template <typename Number>
+void AppendNumber(std::string& out, Number value){
+    char buffer[32];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ptr);
+}
+
+/* Метки времени Chrome Trace задаются в микросекундах */
+double ToMicroseconds(Clock::duration duration){
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void AppendEvent(std::string& out, const SpanRecord& record, uint32_t thread_id, Clock::time_point origin){
+    out += "{\"name\":"sv;
+    AppendString(out, record.name);
+    out += ",\"cat\":"sv;
+    AppendString(out, record.category);
+    out += ",\"ph\":\"X\",\"pid\":1,\"tid\":"sv;
+    AppendNumber(out, thread_id);
+    out += ",\"ts\":"sv;
+    AppendNumber(out, ToMicroseconds(record.start - origin));
+    out += ",\"dur\":"sv;
+    AppendNumber(out, ToMicroseconds(record.end - record.start));
+    out += ",\"args\":{"sv;
+    bool has_args = false;
+    if(!record.args.map_id.empty()){
+        out += "\"map\":"sv;
+        AppendString(out, record.args.map_id);
+        has_args = true;
+    }
+    if(record.args.session_id.has_value()){
+        out += has_args ? ",\"session\":"sv : "\"session\":"sv;
+        AppendNumber(out, *record.args.session_id);
+    }
+    out += "}}"sv;
+}
+
+std::string Tracer::Dump() const{
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["s;
+    bool is_first = true;
+    std::lock_guard lock{mutex_};
+    for(const auto& buffer : buffers_){
+        buffer->ForEach([&](const SpanRecord& record){
+            /* Отрезки, начавшиеся до Start, относятся к предыдущей записи */
+            if(record.start < origin_){
+                return;
+            }
+            if(!is_first){
+                out += ',';
+            }
+            is_first = false;
+            AppendEvent(out, record, buffer->GetThreadId(), origin_);
+        });
+    }
+    out += "]}"sv;
+    return out;
+}
+
+}  // namespace
+
+void Start(){
+    GetTracer().Start();
+}
+
+void Stop(){
+    detail::enabled.store(false, std::memory_order_relaxed);
+}
+
+std::string DumpChromeTrace(){
+    return GetTracer().Dump();
+}
+
+void Record(std::string_view name, std::string_view category, Clock::time_point start, Clock::time_point end,
+            const SpanArgs& args){
+    if(!IsEnabled()){
+        return;
+    }
+    GetThreadBuffer().Add(SpanRecord{name, category, args, start, end});
+}
+
+}  // namespace tracing
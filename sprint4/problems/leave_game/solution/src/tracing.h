@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace tracing {
+
+using Clock = std::chrono::steady_clock;
+
+/*
+    Необязательные атрибуты отрезка. Строки не копируются,
+    поэтому должны жить до выгрузки трассы: подходят литералы и идентификаторы карт
+*/
+struct SpanArgs{
+    std::string_view map_id;
+    std::optional<uint64_t> session_id;
+};
+
+namespace detail {
+
+inline std::atomic<bool> enabled{false};
+
+}  // namespace detail
+
+/*
+    Трасса включается по требованию. Пока она выключена, отрезок стоит одну атомарную загрузку.
+    Отрезки складываются в кольцевой буфер своего потока, при переполнении старые отрезки затираются
+*/
+inline bool IsEnabled() noexcept{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/* Очищает буферы и начинает запись отрезков */
+void Start();
+
+/* Прекращает запись. Записанные отрезки остаются в буферах до следующего Start */
+void Stop();
+
+/* Записанные отрезки в формате Chrome Trace Event (открывается в chrome://tracing и Perfetto) */
+std::string DumpChromeTrace();
+
+/* Записывает отрезок [start, end). name и category - строки со статическим временем жизни */
+void Record(std::string_view name, std::string_view category, Clock::time_point start, Clock::time_point end,
+            const SpanArgs& args = {});
+
+/* Отрезок трассы от создания объекта до его уничтожения */
+class Span{
+public:
+    explicit Span(std::string_view name, std::string_view category = "game", SpanArgs args = {})
+        : name_(name)
+        , category_(category)
+        , args_(args)
+        , enabled_(IsEnabled()){
+        if(enabled_){
+            start_ = Clock::now();
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span(){
+        if(enabled_){
+            Record(name_, category_, start_, Clock::now(), args_);
+        }
+    }
+
+private:
+    std::string_view name_;
+    std::string_view category_;
+    SpanArgs args_;
+    bool enabled_;
+    Clock::time_point start_;
+};
+
+}  // namespace tracing
@@ -0,0 +1,171 @@
+#include "walkable_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+namespace model {
+
+namespace {
+
+/* Желаемое число ячеек на один прямоугольник и верхняя граница размера сетки */
+constexpr double CELLS_PER_AREA = 4;
+constexpr double MAX_CELLS = 1 << 20;
+constexpr double MIN_CELL_SIZE = 1.0;
+
+/*
+    Сливает прямоугольники с одинаковым "поперечным" размером,
+    которые касаются или перекрываются вдоль "продольной" оси.
+    Get возвращает (поперечный min, поперечный max, продольный min, продольный max) по ссылкам.
+*/
+template <typename Getter>
+std::vector<WalkableIndex::Area> MergeAlong(std::vector<WalkableIndex::Area> areas, Getter get){
+    std::sort(areas.begin(), areas.end(), [get](const auto& lhs, const auto& rhs){
+        auto [l_cross_min, l_cross_max, l_min, l_max] = get(lhs);
+        auto [r_cross_min, r_cross_max, r_min, r_max] = get(rhs);
+        return std::tie(l_cross_min, l_cross_max, l_min) < std::tie(r_cross_min, r_cross_max, r_min);
+    });
+
+    std::vector<WalkableIndex::Area> result;
+    for(auto& area : areas){
+        if(!result.empty()){
+            auto [l_cross_min, l_cross_max, l_min, l_max] = get(result.back());
+            auto [r_cross_min, r_cross_max, r_min, r_max] = get(area);
+            if(l_cross_min == r_cross_min && l_cross_max == r_cross_max && r_min <= l_max){
+                l_max = std::max(l_max, r_max);
+                continue;
+            }
+        }
+        result.push_back(area);
+    }
+    return result;
+}
+
+} // namespace
+
+PairDouble WalkableIndex::Area::Clamp(const PairDouble& pos) const{
+    return {std::clamp(pos.x, min_x, max_x), std::clamp(pos.y, min_y, max_y)};
+}
+
+WalkableIndex::WalkableIndex(std::vector<Area> areas)
+    : areas_(MergeAreas(std::move(areas))){
+    if(areas_.empty()){
+        return;
+    }
+
+    double max_x = std::numeric_limits<double>::lowest();
+    double max_y = std::numeric_limits<double>::lowest();
+    origin_x_ = std::numeric_limits<double>::max();
+    origin_y_ = std::numeric_limits<double>::max();
+    for(const Area& area : areas_){
+        origin_x_ = std::min(origin_x_, area.min_x);
+        origin_y_ = std::min(origin_y_, area.min_y);
+        max_x = std::max(max_x, area.max_x);
+        max_y = std::max(max_y, area.max_y);
+    }
+
+    /* Размер ячейки подбираем так, чтобы на прямоугольник приходилось несколько ячеек */
+    const double area_size = (max_x - origin_x_) * (max_y - origin_y_);
+    const double cells = std::min(CELLS_PER_AREA * areas_.size(), MAX_CELLS);
+    cell_size_ = std::max(MIN_CELL_SIZE, std::sqrt(area_size / cells));
+    cells_x_ = CellX(max_x) + 1;
+    cells_y_ = CellY(max_y) + 1;
+
+    /* Двухпроходное построение: сначала считаем, сколько прямоугольников в каждой ячейке */
+    cell_offsets_.assign(cells_x_ * cells_y_ + 1, 0);
+    auto for_each_cell = [this](const Area& area, auto&& action){
+        for(int64_t y = CellY(area.min_y); y <= CellY(area.max_y); ++y){
+            for(int64_t x = CellX(area.min_x); x <= CellX(area.max_x); ++x){
+                action(y * cells_x_ + x);
+            }
+        }
+    };
+
+    for(const Area& area : areas_){
+        for_each_cell(area, [this](int64_t cell){
+            ++cell_offsets_[cell + 1];
+        });
+    }
+    for(size_t cell = 1; cell < cell_offsets_.size(); ++cell){
+        cell_offsets_[cell] += cell_offsets_[cell - 1];
+    }
+
+    cell_areas_.resize(cell_offsets_.back());
+    std::vector<uint32_t> filled(cell_offsets_.begin(), cell_offsets_.end() - 1);
+    for(uint32_t area_id = 0; area_id < areas_.size(); ++area_id){
+        for_each_cell(areas_[area_id], [this, &filled, area_id](int64_t cell){
+            cell_areas_[filled[cell]++] = area_id;
+        });
+    }
+}
+
+std::span<const uint32_t> WalkableIndex::FindCandidates(const PairDouble& pos) const{
+    const int64_t x = CellX(pos.x);
+    const int64_t y = CellY(pos.y);
+    if(x < 0 || y < 0 || x >= cells_x_ || y >= cells_y_){
+        return {};
+    }
+
+    const int64_t cell = y * cells_x_ + x;
+    return {cell_areas_.data() + cell_offsets_[cell], cell_areas_.data() + cell_offsets_[cell + 1]};
+}
+
+const std::vector<WalkableIndex::Area>& WalkableIndex::GetAreas() const{
+    return areas_;
+}
+
+WalkableIndex::MoveResult WalkableIndex::Move(const PairDouble& from, const PairDouble& to) const{
+    const double dx = to.x - from.x;
+    const double dy = to.y - from.y;
+
+    bool is_on_road = false;
+    PairDouble best_pos = from;
+    double best_progress = std::numeric_limits<double>::lowest();
+
+    for(uint32_t area_id : FindCandidates(from)){
+        const Area& area = areas_[area_id];
+        if(!area.Contains(from)){
+            continue;
+        }
+        is_on_road = true;
+
+        const PairDouble clamped = area.Clamp(to);
+        if(clamped == to){
+            return {to, false};
+        }
+
+        /* Выбираем дорогу, по которой можно продвинуться дальше всего */
+        const double progress = (clamped.x - from.x) * dx + (clamped.y - from.y) * dy;
+        if(progress > best_progress){
+            best_progress = progress;
+            best_pos = clamped;
+        }
+    }
+
+    if(!is_on_road){
+        return {to, false};
+    }
+    return {best_pos, true};
+}
+
+std::vector<WalkableIndex::Area> WalkableIndex::MergeAreas(std::vector<Area> areas){
+    /* Горизонтальные дороги: одинаковые границы по y, сливаем вдоль x */
+    areas = MergeAlong(std::move(areas), [](auto& area){
+        return std::tie(area.min_y, area.max_y, area.min_x, area.max_x);
+    });
+    /* Вертикальные дороги: одинаковые границы по x, сливаем вдоль y */
+    return MergeAlong(std::move(areas), [](auto& area){
+        return std::tie(area.min_x, area.max_x, area.min_y, area.max_y);
+    });
+}
+
+int64_t WalkableIndex::CellX(double x) const{
+    return static_cast<int64_t>(std::floor((x - origin_x_) / cell_size_));
+}
+
+int64_t WalkableIndex::CellY(double y) const{
+    return static_cast<int64_t>(std::floor((y - origin_y_) / cell_size_));
+}
+
+}  // namespace model
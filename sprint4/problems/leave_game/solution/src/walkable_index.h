@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "geom.h"
+
+namespace model {
+
+/*
+    Индекс проходимой области карты.
+
+    Проходимая область - объединение прямоугольников дорог
+    (отрезок дороги, расширенный на половину ширины дороги).
+    При построении соседние и перекрывающиеся дороги,
+    лежащие на одной прямой, сливаются в один прямоугольник.
+    Прямоугольники раскладываются по ячейкам равномерной сетки,
+    так что поиск по точке - это вычисление одной ячейки
+    и просмотр короткого списка прямоугольников без выделения памяти.
+*/
+class WalkableIndex {
+public:
+    struct Area {
+        double min_x = 0;
+        double min_y = 0;
+        double max_x = 0;
+        double max_y = 0;
+
+        bool Contains(const PairDouble& pos) const {
+            return min_x <= pos.x && pos.x <= max_x && min_y <= pos.y && pos.y <= max_y;
+        }
+
+        PairDouble Clamp(const PairDouble& pos) const;
+    };
+
+    struct MoveResult {
+        PairDouble pos;
+        /* Перемещение упёрлось в край дороги */
+        bool stopped = false;
+    };
+
+    WalkableIndex() = default;
+
+    explicit WalkableIndex(std::vector<Area> areas);
+
+    /* Индексы прямоугольников из ячейки, в которую попадает pos */
+    std::span<const uint32_t> FindCandidates(const PairDouble& pos) const;
+
+    const std::vector<Area>& GetAreas() const;
+
+    /*
+        Перемещение из from в to, не выходя за пределы дорог, на которых стоит from.
+        Если to недостижима, то возвращается самая дальняя в направлении движения точка.
+        Если from не лежит ни на одной дороге, то перемещение не ограничивается.
+    */
+    MoveResult Move(const PairDouble& from, const PairDouble& to) const;
+
+private:
+    static std::vector<Area> MergeAreas(std::vector<Area> areas);
+
+    int64_t CellX(double x) const;
+
+    int64_t CellY(double y) const;
+
+    std::vector<Area> areas_;
+    double origin_x_ = 0;
+    double origin_y_ = 0;
+    double cell_size_ = 1;
+    int64_t cells_x_ = 0;
+    int64_t cells_y_ = 0;
+    /* Ячейка i содержит прямоугольники cell_areas_[cell_offsets_[i] .. cell_offsets_[i + 1]) */
+    std::vector<uint32_t> cell_offsets_;
+    std::vector<uint32_t> cell_areas_;
+};
+
+}  // namespace model